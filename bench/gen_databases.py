@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Generate synthetic system databases for the benchmarks.
+
+Writes etc/passwd, group, shadow, gshadow, hosts, networks, protocols,
+services, ethers, aliases, netgroup and rpc with the given number of
+records each, in the formats of the
+files in /etc, so that the directory can be handed to getent --root,
+plus a keys/ directory holding the names to look up in each of them:
+
+    keys/<database>.last    the key of the last record, the worst case
+                            for anything scanning the file
+    keys/<database>.batch   up to 1000 keys spread evenly over the file
+
+Output is deterministic for a given record count and seed, so results
+stay comparable between commits. A stamp file records what was
+generated, letting a second run with the same arguments return at once.
+
+Usage: gen_databases.py [--records N] [--seed S] DIRECTORY
+"""
+
+import argparse
+import os
+import random
+import sys
+
+BATCH_KEYS = 1000
+STAMP = ".generated"
+
+# Database name in getent, file it is read from, and key of record i
+DATABASES = {
+    "password": ("passwd", lambda i: f"user{i}"),
+    "shadow": ("shadow", lambda i: f"user{i}"),
+    "group": ("group", lambda i: f"group{i}"),
+    "initgroups": ("passwd", lambda i: f"user{i}"),
+    "hosts": ("hosts", lambda i: f"host{i}.bench.example"),
+    "ahosts": ("hosts", lambda i: f"host{i}.bench.example"),
+    "ahostsv4": ("hosts", lambda i: f"host{i}.bench.example"),
+    "ahostsv6": ("hosts", lambda i: f"host{i}.bench.example"),
+    "networks": ("networks", lambda i: f"net{i}"),
+    "protocols": ("protocols", lambda i: f"proto{i}"),
+    "services": ("services", lambda i: f"svc{i}"),
+    "ethers": ("ethers", lambda i: f"ether{i}.bench.example"),
+    "aliases": ("aliases", lambda i: f"alias{i}"),
+    "gshadow": ("gshadow", lambda i: f"group{i}"),
+    "netgroup": ("netgroup", lambda i: f"netgroup{i}"),
+    "rpc": ("rpc", lambda i: f"rpc{i}"),
+}
+
+
+def address(i):
+    """A unique IPv4 address per record, starting at 10.0.0.1"""
+    i += 1
+    return f"10.{(i >> 16) & 0xFF}.{(i >> 8) & 0xFF}.{i & 0xFF}"
+
+
+def write_file(path, records, line):
+    with open(path, "w", encoding="utf-8") as f:
+        chunk = []
+        for i in range(records):
+            chunk.append(line(i))
+            if len(chunk) == 4096:
+                f.write("".join(chunk))
+                chunk = []
+        f.write("".join(chunk))
+
+
+def generate(directory, records, seed):
+    rng = random.Random(seed)
+    etc = os.path.join(directory, "etc")
+    os.makedirs(etc, exist_ok=True)
+    # Up to three members per group, reused for initgroups
+    members = [",".join(f"user{rng.randrange(records)}" for _ in range(rng.randrange(4)))
+               for _ in range(min(records, 65536))]
+
+    write_file(os.path.join(etc, "passwd"), records,
+               lambda i: f"user{i}:x:{10000 + i}:{10000 + i % 65536}:Bench User {i}:"
+                         f"/home/user{i}:/bin/sh\n")
+    write_file(os.path.join(etc, "shadow"), records,
+               lambda i: f"user{i}:$6$bench$x:19000:0:99999:7:::\n")
+    write_file(os.path.join(etc, "group"), records,
+               lambda i: f"group{i}:x:{10000 + i}:{members[i % len(members)]}\n")
+    write_file(os.path.join(etc, "gshadow"), records,
+               lambda i: f"group{i}:!::{members[i % len(members)]}\n")
+    write_file(os.path.join(etc, "hosts"), records,
+               lambda i: f"{address(i)}\thost{i}.bench.example host{i}\n")
+    write_file(os.path.join(etc, "networks"), records,
+               lambda i: f"net{i}\t{address(i)}\n")
+    write_file(os.path.join(etc, "protocols"), records,
+               lambda i: f"proto{i}\t{i % 256}\tPROTO{i}\n")
+    write_file(os.path.join(etc, "services"), records,
+               lambda i: f"svc{i}\t{1 + i % 65535}/{'tcp' if i % 2 == 0 else 'udp'}\n")
+    write_file(os.path.join(etc, "ethers"), records,
+               lambda i: "02:{:02x}:{:02x}:{:02x}:{:02x}:{:02x}\tether{}.bench.example\n".format(
+                   (i >> 32) & 0xFF, (i >> 24) & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF,
+                   i & 0xFF, i))
+    write_file(os.path.join(etc, "aliases"), records,
+               lambda i: f"alias{i}: user{i}, user{(i + 1) % records}\n")
+    write_file(os.path.join(etc, "netgroup"), records,
+               lambda i: f"netgroup{i} (host{i}.bench.example,user{i},bench.example)\n")
+    write_file(os.path.join(etc, "rpc"), records,
+               lambda i: f"rpc{i}\t{200000 + i}\tRPC{i}\n")
+
+    keys = os.path.join(directory, "keys")
+    os.makedirs(keys, exist_ok=True)
+    step = max(1, records // BATCH_KEYS)
+    for name, (_, key) in DATABASES.items():
+        with open(os.path.join(keys, f"{name}.last"), "w", encoding="utf-8") as f:
+            f.write(key(records - 1) + "\n")
+        with open(os.path.join(keys, f"{name}.batch"), "w", encoding="utf-8") as f:
+            f.write("".join(key(i) + "\n" for i in range(0, records, step)[:BATCH_KEYS]))
+
+
+def ensure_generated(directory, records, seed):
+    """Generate the files in directory, unless they already are"""
+    if records < 1:
+        sys.exit("--records must be positive")
+
+    stamp = os.path.join(directory, STAMP)
+    wanted = f"records={records} seed={seed} layout=root databases={','.join(DATABASES)}\n"
+    try:
+        with open(stamp, encoding="utf-8") as f:
+            if f.read() == wanted:
+                return
+    except OSError:
+        pass
+
+    os.makedirs(directory, exist_ok=True)
+    generate(directory, records, seed)
+    with open(stamp, "w", encoding="utf-8") as f:
+        f.write(wanted)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate synthetic databases")
+    parser.add_argument("--records", type=int, default=10000,
+                        help="records per database (default 10000)")
+    parser.add_argument("--seed", type=int, default=1, help="random seed (default 1)")
+    parser.add_argument("directory")
+    args = parser.parse_args()
+    ensure_generated(args.directory, args.records, args.seed)
+
+
+if __name__ == "__main__":
+    main()
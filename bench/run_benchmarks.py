@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""
+Time getent and getconf, writing the results as JSON.
+
+    run_benchmarks.py getent --getent BIN --data DIR [--records N]
+                             [--db-dir DIR] --output FILE DATABASE...
+    run_benchmarks.py getconf --getconf BIN --output FILE
+    run_benchmarks.py startup --getconf BIN --getent BIN [--multicall BIN]
+                              --output FILE
+    run_benchmarks.py compare OLD.json NEW.json
+
+For each database, getent is timed looking up the key of the last
+record, looking up a batch of keys with --file and enumerating the whole
+database. Databases getent reads natively are pointed at the synthetic
+files from gen_databases.py with --root. The others only have the libc
+backend, which reads the real /etc, so for them the files are put in
+place of /etc inside a private mount namespace (unshare -rm) instead; no
+privileges are needed, but where user namespaces are not available
+those databases are skipped. getconf is timed for a single variable, with and without
+GETCONF_CACHE, a batch of variables, -a and --export=json. startup times
+calls that do next to nothing, so that exec, dynamic linking and
+initialisation dominate, for getconf and getent as separate binaries and
+as the multicall binary.
+
+Every case runs once to warm up, then --repeat times. The JSON holds
+the min, median, mean and max wall clock time of each case, in seconds,
+and compare prints how each case moved between two result files.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_databases  # noqa: E402
+
+EXIT_SKIP = 77
+NAMESPACE_ENV = "BENCH_IN_NAMESPACE"
+GETENT_ENUMERATION_NOT_SUPPORTED = 3
+# Databases whose default services read files themselves, honouring --root
+ROOTED_DATABASES = {"password", "group", "initgroups", "hosts", "ahosts", "ahostsv4",
+                    "ahostsv6"}
+GETCONF_BATCH = ["PAGESIZE", "_NPROCESSORS_ONLN", "_PHYS_PAGES", "CS_PATH", "ARG_MAX",
+                 "OPEN_MAX", "CHILD_MAX", "LONG_BIT", "NAME_MAX", "PATH_MAX",
+                 "LEVEL1_DCACHE_LINESIZE", "LEVEL2_CACHE_SIZE", "HOST_NAME_MAX",
+                 "LOGIN_NAME_MAX", "NGROUPS_MAX"]
+
+
+def time_command(argv, repeat, env=None, ok=(0,)):
+    """Run argv once to warm up and repeat times more, returning the timings"""
+    times = []
+    for run in range(repeat + 1):
+        start = time.perf_counter()
+        proc = subprocess.run(argv, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, env=env,
+                              check=False)
+        elapsed = time.perf_counter() - start
+        if proc.returncode not in ok:
+            return {"status": proc.returncode,
+                    "error": proc.stderr.decode(errors="replace").strip()}
+        if run > 0:
+            times.append(elapsed)
+    return {
+        "runs": repeat,
+        "min": min(times),
+        "median": statistics.median(times),
+        "mean": statistics.fmean(times),
+        "max": max(times),
+    }
+
+
+def source_revision():
+    here = os.path.dirname(os.path.abspath(__file__))
+    try:
+        proc = subprocess.run(["git", "-C", here, "rev-parse", "HEAD"], capture_output=True,
+                              text=True, check=False)
+    except OSError:
+        return None
+    return proc.stdout.strip() or None
+
+
+def write_results(path, suite, results, **extra):
+    report = {
+        "suite": suite,
+        "revision": source_revision(),
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+        **extra,
+        "results": results,
+    }
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, "w", encoding="utf-8") as f:
+        json.dump(report, f, indent=2)
+        f.write("\n")
+    for name, result in results.items():
+        if "median" in result:
+            print(f"{name:40} {result['median'] * 1000:10.2f} ms")
+        else:
+            print(f"{name:40} {result.get('error') or 'status ' + str(result['status'])}")
+
+
+def overlay(target, overrides):
+    """
+    Mount a copy of directory target over it, with the entries of
+    overrides replaced: by a symlink to the given file, or by an empty
+    directory for None. Everything else still points at the original.
+    """
+    work = tempfile.mkdtemp(prefix="bench-overlay-")
+    orig = os.path.join(work, "orig")
+    new = os.path.join(work, "new")
+    os.mkdir(orig)
+    os.mkdir(new)
+    subprocess.run(["mount", "--bind", target, orig], check=True)
+    for name in os.listdir(orig):
+        os.symlink(os.path.join(orig, name), os.path.join(new, name))
+    for name, source in overrides.items():
+        path = os.path.join(new, name)
+        if os.path.lexists(path):
+            os.unlink(path)
+        if source is None:
+            os.mkdir(path)
+        else:
+            os.symlink(os.path.abspath(source), path)
+    subprocess.run(["mount", "--bind", new, target], check=True)
+
+
+def enter_namespace():
+    """Re-run this script as root of a private user and mount namespace"""
+    unshare = shutil.which("unshare")
+    if unshare is None or subprocess.run([unshare, "-rm", "true"], capture_output=True,
+                                         check=False).returncode != 0:
+        print("user namespaces are not available, skipping", file=sys.stderr)
+        sys.exit(EXIT_SKIP)
+    env = dict(os.environ, **{NAMESPACE_ENV: "1"})
+    os.execve(unshare, [unshare, "-rm", sys.executable, os.path.abspath(__file__)] + sys.argv[1:],
+              env)
+
+
+def replace_etc(args):
+    """Put the generated files in place of /etc, for the libc backend"""
+    if os.environ.get(NAMESPACE_ENV) != "1":
+        enter_namespace()
+
+    etc = os.path.join(args.data, "etc")
+    files = {name: os.path.join(etc, name) for name, _ in gen_databases.DATABASES.values()}
+    files["nsswitch.conf"] = os.path.join(etc, "nsswitch.conf")
+    with open(files["nsswitch.conf"], "w", encoding="utf-8") as f:
+        for name in ("passwd", "group", "shadow", "gshadow", "hosts", "networks", "protocols",
+                     "services", "ethers", "aliases", "netgroup", "rpc"):
+            f.write(f"{name}: files\n")
+    overlay("/etc", files)
+    # Give getent a writable GETENT_DB_DIR, so that indexes outlive the warm up
+    if args.db_dir and os.path.isdir(os.path.dirname(args.db_dir)):
+        overlay(os.path.dirname(args.db_dir), {os.path.basename(args.db_dir): None})
+
+
+def run_getent(args):
+    gen_databases.ensure_generated(args.data, args.records, args.seed)
+
+    getent = [os.path.abspath(args.getent)] + (["-s", args.service] if args.service else [])
+    if args.service is None and ROOTED_DATABASES.issuperset(args.databases):
+        # Indexes built under the root outlive the warm up
+        if args.db_dir:
+            os.makedirs(os.path.join(args.data, args.db_dir.lstrip("/")), exist_ok=True)
+        getent.append("--root=" + os.path.abspath(args.data))
+    else:
+        replace_etc(args)
+    keys = os.path.join(args.data, "keys")
+    results = {}
+    for db in args.databases:
+        with open(os.path.join(keys, f"{db}.last"), encoding="utf-8") as f:
+            last = f.read().strip()
+        results[f"{db}/lookup"] = time_command(getent + [db, last], args.repeat)
+        results[f"{db}/batch"] = time_command(
+            getent + ["-f", os.path.join(keys, f"{db}.batch"), db], args.repeat)
+        result = time_command(getent + [db], args.repeat,
+                              ok=(0, GETENT_ENUMERATION_NOT_SUPPORTED))
+        if result.get("status") != GETENT_ENUMERATION_NOT_SUPPORTED:
+            results[f"{db}/enumerate"] = result
+    write_results(args.output, "getent", results, records=args.records, repeat=args.repeat,
+                  service=args.service)
+    return 1 if any("status" in r for r in results.values()) else 0
+
+
+def run_getconf(args):
+    results = {}
+    env = dict(os.environ)
+    env.pop("GETCONF_CACHE", None)
+    results["lookup/sysconf"] = time_command([args.getconf, "PAGESIZE"], args.repeat, env)
+    results["lookup/confstr"] = time_command([args.getconf, "CS_PATH"], args.repeat, env)
+    results["lookup/sysfs"] = time_command([args.getconf, "LEVEL1_DCACHE_LINESIZE"],
+                                           args.repeat, env)
+    results["batch"] = time_command([args.getconf] + GETCONF_BATCH, args.repeat, env)
+    results["all"] = time_command([args.getconf, "-a"], args.repeat, env)
+    results["export-json"] = time_command([args.getconf, "--export=json"], args.repeat, env)
+    with tempfile.TemporaryDirectory(prefix="bench-getconf-") as tmp:
+        cached = dict(env, GETCONF_CACHE=os.path.join(tmp, "getconf.cache"))
+        results["lookup/confstr-cached"] = time_command([args.getconf, "CS_PATH"], args.repeat,
+                                                        cached)
+    write_results(args.output, "getconf", results, repeat=args.repeat)
+    return 1 if any("status" in r for r in results.values()) else 0
+
+
+def run_startup(args):
+    results = {}
+    env = dict(os.environ)
+    env.pop("GETCONF_CACHE", None)
+    calls = {"getconf": ["PAGESIZE"], "getent": ["--version"]}
+    with tempfile.TemporaryDirectory(prefix="bench-startup-") as tmp:
+        binaries = {"separate": {"getconf": args.getconf, "getent": args.getent}}
+        if args.multicall:
+            # Run under the tool's name, as the installed links are
+            binaries["multicall"] = {}
+            for tool in calls:
+                link = os.path.join(tmp, tool)
+                os.symlink(os.path.abspath(args.multicall), link)
+                binaries["multicall"][tool] = link
+        for tool, argv in calls.items():
+            for kind, paths in binaries.items():
+                results[f"{tool}/{kind}"] = time_command([paths[tool]] + argv, args.repeat, env)
+    write_results(args.output, "startup", results, repeat=args.repeat)
+    return 1 if any("status" in r for r in results.values()) else 0
+
+
+def run_compare(args):
+    with open(args.old, encoding="utf-8") as f:
+        old = json.load(f)
+    with open(args.new, encoding="utf-8") as f:
+        new = json.load(f)
+    print(f"{'case':40} {'old ms':>10} {'new ms':>10} {'change':>8}")
+    for name, result in new["results"].items():
+        before = old["results"].get(name, {})
+        if "median" not in result or "median" not in before:
+            continue
+        change = (result["median"] - before["median"]) / before["median"] * 100
+        print(f"{name:40} {before['median'] * 1000:10.2f} {result['median'] * 1000:10.2f} "
+              f"{change:+7.1f}%")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark getent and getconf")
+    sub = parser.add_subparsers(dest="suite", required=True)
+
+    getent = sub.add_parser("getent", help="time getent over synthetic databases")
+    getent.add_argument("--getent", required=True, help="getent binary")
+    getent.add_argument("--data", required=True, help="directory for the generated files")
+    getent.add_argument("--records", type=int, default=10000, help="records per database")
+    getent.add_argument("--seed", type=int, default=1, help="seed for the generated files")
+    getent.add_argument("--db-dir", help="GETENT_DB_DIR getent was built with")
+    getent.add_argument("--service", help="service configuration passed to getent -s")
+    getent.add_argument("--repeat", type=int, default=5, help="timed runs per case")
+    getent.add_argument("--output", required=True, help="JSON file to write")
+    getent.add_argument("databases", nargs="+", choices=sorted(gen_databases.DATABASES))
+    getent.set_defaults(run=run_getent)
+
+    getconf = sub.add_parser("getconf", help="time getconf")
+    getconf.add_argument("--getconf", required=True, help="getconf binary")
+    getconf.add_argument("--repeat", type=int, default=20, help="timed runs per case")
+    getconf.add_argument("--output", required=True, help="JSON file to write")
+    getconf.set_defaults(run=run_getconf)
+
+    startup = sub.add_parser("startup", help="time getconf and getent startup")
+    startup.add_argument("--getconf", required=True, help="getconf binary")
+    startup.add_argument("--getent", required=True, help="getent binary")
+    startup.add_argument("--multicall", help="multicall binary, to time against the others")
+    startup.add_argument("--repeat", type=int, default=200, help="timed runs per case")
+    startup.add_argument("--output", required=True, help="JSON file to write")
+    startup.set_defaults(run=run_startup)
+
+    compare = sub.add_parser("compare", help="compare two result files")
+    compare.add_argument("old")
+    compare.add_argument("new")
+    compare.set_defaults(run=run_compare)
+
+    args = parser.parse_args()
+    sys.exit(args.run(args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Compile the variable names of getconf.inc into a minimal perfect hash.
+
+Every name is hashed once to pick a bucket, and again with the seed of
+that bucket to pick its slot. Seeds are searched for here, biggest
+buckets first, until every name owns a slot of its own. Looking a name up
+in getconf then costs two hashes and a single strcmp.
+
+Usage: gen_getconf_hash.py getconf.inc getconf-hash.h
+
+The build fails if a name is listed twice, as only one of them could ever
+be looked up.
+"""
+
+import re
+import sys
+
+ENTRY = re.compile(r'^\s*GET_[A-Z_]+\(\s*"([^"]+)"')
+KEYS_PER_BUCKET = 4
+SEED_MAX = 0xFFFF
+
+# The C version of name_hash() below; keep both in step
+C_HASH = """static inline uint32_t getconf_hash(const char *name, uint32_t seed)
+{
+        uint32_t h = 2166136261U ^ (seed * 0x9E3779B1U);
+
+        while (*name != '\\0') {
+                h ^= (unsigned char)*name++;
+                h *= 16777619U;
+        }
+        return h ^ (h >> 15);
+}"""
+
+
+def name_hash(name, seed):
+    h = (2166136261 ^ (seed * 0x9E3779B1)) & 0xFFFFFFFF
+    for c in name.encode():
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h ^ (h >> 15)
+
+
+def read_names(path):
+    names = []
+    seen = {}
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            match = ENTRY.match(line)
+            if match is None:
+                continue
+            name = match.group(1)
+            if name in seen:
+                sys.exit(f"{path}:{lineno}: duplicate variable {name}, "
+                         f"first listed at line {seen[name]}")
+            seen[name] = lineno
+            names.append(name)
+    if not names:
+        sys.exit(f"{path}: no variables found")
+    return names
+
+
+def build(names):
+    bucket_cnt = (len(names) + KEYS_PER_BUCKET - 1) // KEYS_PER_BUCKET
+    buckets = [[] for _ in range(bucket_cnt)]
+    for index, name in enumerate(names):
+        buckets[name_hash(name, 0) % bucket_cnt].append(index)
+
+    seeds = [0] * bucket_cnt
+    slots = [None] * len(names)
+    order = sorted(range(bucket_cnt), key=lambda b: len(buckets[b]), reverse=True)
+    for b in order:
+        if not buckets[b]:
+            continue
+        for seed in range(1, SEED_MAX + 1):
+            picked = {name_hash(names[i], seed) % len(names) for i in buckets[b]}
+            if len(picked) == len(buckets[b]) and all(slots[s] is None for s in picked):
+                break
+        else:
+            sys.exit("no perfect hash found, raise SEED_MAX")
+        seeds[b] = seed
+        for i in buckets[b]:
+            slots[name_hash(names[i], seed) % len(names)] = i
+    return seeds, slots
+
+
+def c_array(values, per_line=12):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("        " + ", ".join(str(v) for v in values[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(f"Usage: {sys.argv[0]} getconf.inc getconf-hash.h")
+    names = read_names(sys.argv[1])
+    seeds, slots = build(names)
+
+    with open(sys.argv[2], "w", encoding="utf-8") as out:
+        out.write(f"""/* Generated by gen_getconf_hash.py from getconf.inc, do not edit */
+
+#ifndef GETCONF_HASH_H
+#define GETCONF_HASH_H
+
+#include <stdint.h>
+
+#define GETCONF_HASH_BUCKETS {len(seeds)}
+#define GETCONF_HASH_SLOTS {len(slots)}
+
+{C_HASH}
+
+/**
+ * Seed to hash names of each bucket with
+ */
+static const uint16_t getconf_hash_seeds[GETCONF_HASH_BUCKETS] = {{
+{c_array(seeds)}
+}};
+
+/**
+ * Position in getconf.inc of the variable owning each slot
+ */
+static const uint16_t getconf_hash_slots[GETCONF_HASH_SLOTS] = {{
+{c_array(slots)}
+}};
+
+#endif
+""")
+
+
+if __name__ == "__main__":
+    main()
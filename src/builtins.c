@@ -0,0 +1,159 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <config.h>
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "builtins.h"
+#include "common.h"
+#include "shell.h"
+
+/**
+ * getconf and getent as bash loadable builtins (-Dbash_builtins=enabled),
+ * for scripts that call them in loops and would rather not fork and exec
+ * every time:
+ *
+ *     enable -f libc-support.so getconf getent
+ *
+ * Each builtin runs the main() of its tool inside the shell, so output and
+ * exit status are those of the executables. Only bash's headers can be
+ * included here, as its config.h shadows ours, so what the builtins need
+ * from the tools is declared below.
+ */
+extern int getconf_main(int argc, char **argv);
+extern int getent_main(int argc, char **argv);
+extern void out_flush(void);
+extern bool locale_loaded;
+extern bool getconf_locale_loaded;
+extern _Thread_local jmp_buf *err_return;
+
+typedef int (*tool_main_t)(int argc, char **argv);
+
+/**
+ * Run @tool_main, turning the exit of a failed command into its status
+ */
+static int run_guarded(tool_main_t tool_main, int argc, char **argv)
+{
+        jmp_buf failed;
+        int res = EXECUTION_SUCCESS;
+
+        if (setjmp(failed) != 0) {
+                err_return = NULL;
+                return EXECUTION_FAILURE;
+        }
+        err_return = &failed;
+        res = tool_main(argc, argv);
+        err_return = NULL;
+        return res;
+}
+
+/**
+ * Run @tool_main with the words of @list as its arguments
+ */
+static int run_tool(tool_main_t tool_main, WORD_LIST *list)
+{
+        char **argv = NULL;
+        int argc = 0;
+        int res = EXECUTION_SUCCESS;
+
+        /* The shell keeps the locale it was asked for, never the environment's */
+        locale_loaded = true;
+        getconf_locale_loaded = true;
+        /* Anything the shell printed goes first, and keys come from the current stdin */
+        fflush(stdout);
+        __fpurge(stdin);
+        clearerr(stdin);
+        optind = 0;
+
+        argv = make_builtin_argv(list, &argc);
+        res = run_guarded(tool_main, argc, argv);
+        out_flush();
+        fflush(stdout);
+        free(argv);
+        return res;
+}
+
+static int getconf_builtin(WORD_LIST *list)
+{
+        return run_tool(getconf_main, list);
+}
+
+static int getent_builtin(WORD_LIST *list)
+{
+        return run_tool(getent_main, list);
+}
+
+static char *getconf_doc[] = {
+        "Get configuration values.",
+        "",
+        "Runs getconf in the shell, see getconf --help.",
+        NULL,
+};
+
+static char *getent_doc[] = {
+        "Get entries from administrative databases.",
+        "",
+        "Runs getent in the shell, see getent --help.",
+        NULL,
+};
+
+struct builtin getconf_struct = {
+        .name = "getconf",
+        .function = getconf_builtin,
+        .flags = BUILTIN_ENABLED,
+        .long_doc = getconf_doc,
+        .short_doc = "getconf [-v specification] variable_name [pathname]",
+        .handle = NULL,
+};
+
+struct builtin getent_struct = {
+        .name = "getent",
+        .function = getent_builtin,
+        .flags = BUILTIN_ENABLED,
+        .long_doc = getent_doc,
+        .short_doc = "getent [-ci] [-j jobs] [-s config] database [key ...]",
+        .handle = NULL,
+};
+
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
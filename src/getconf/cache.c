@@ -0,0 +1,252 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "config.h"
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+const char *getconf_cache_path(char *buf, size_t len)
+{
+        const char *setting = getenv(GETCONF_CACHE_ENV);
+        const char *dir = NULL;
+
+        if (setting == NULL || *setting == '\0' || strcmp(setting, "0") == 0)
+                return NULL;
+        if (*setting == '/') {
+                snprintf(buf, len, "%s", setting);
+                return buf;
+        }
+        dir = getenv("XDG_RUNTIME_DIR");
+        if (dir == NULL || *dir != '/')
+                dir = "/run";
+        snprintf(buf, len, "%s/%s", dir, GETCONF_CACHE_FILE);
+        return buf;
+}
+
+/**
+ * Read the id of the current boot into @buf, without its newline
+ */
+static bool read_boot_id(char buf[GETCONF_CACHE_BOOT_ID_LEN])
+{
+        ssize_t r = 0;
+        int fd = open(BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+                return false;
+        memset(buf, 0, GETCONF_CACHE_BOOT_ID_LEN);
+        r = read(fd, buf, GETCONF_CACHE_BOOT_ID_LEN - 1);
+        close(fd);
+        if (r <= 0)
+                return false;
+        buf[strcspn(buf, "\n")] = '\0';
+        return buf[0] != '\0';
+}
+
+/**
+ * Fill in the header identifying this boot, getconf and variable table
+ */
+static bool fill_header(getconf_cache_header_t *hdr, uint32_t fingerprint, uint32_t value_cnt)
+{
+        memset(hdr, 0, sizeof(getconf_cache_header_t));
+        hdr->magic = GETCONF_CACHE_MAGIC;
+        hdr->version = GETCONF_CACHE_VERSION;
+        hdr->fingerprint = fingerprint;
+        hdr->value_cnt = value_cnt;
+        snprintf(hdr->package_version, sizeof(hdr->package_version), "%s", PACKAGE_VERSION);
+        return read_boot_id(hdr->boot_id);
+}
+
+/**
+ * Check that every offset lands on a flags byte and NUL terminated text
+ */
+static bool valid_offsets(const getconf_cache_t *cache)
+{
+        for (uint32_t i = 0; i < cache->value_cnt; i++) {
+                uint32_t off = cache->offsets[i];
+
+                if (off == GETCONF_CACHE_NONE)
+                        continue;
+                if (off >= cache->size - 1 ||
+                    memchr(cache->map + off + 1, '\0', cache->size - off - 1) == NULL)
+                        return false;
+        }
+        return true;
+}
+
+bool getconf_cache_open(getconf_cache_t *cache, const char *path, uint32_t fingerprint,
+                        uint32_t value_cnt)
+{
+        getconf_cache_header_t expect;
+        const getconf_cache_header_t *hdr = NULL;
+        struct stat st;
+        void *map = NULL;
+        int fd = -1;
+
+        memset(cache, 0, sizeof(getconf_cache_t));
+        if (!fill_header(&expect, fingerprint, value_cnt))
+                return false;
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+            (size_t)st.st_size < sizeof(getconf_cache_header_t) + value_cnt * sizeof(uint32_t)) {
+                close(fd);
+                return false;
+        }
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return false;
+
+        cache->map = map;
+        cache->size = (size_t)st.st_size;
+        cache->offsets = (const uint32_t *)(cache->map + sizeof(getconf_cache_header_t));
+        cache->value_cnt = value_cnt;
+
+        hdr = map;
+        expect.size = (uint64_t)st.st_size;
+        if (memcmp(hdr, &expect, sizeof(getconf_cache_header_t)) != 0 || !valid_offsets(cache)) {
+                getconf_cache_close(cache);
+                return false;
+        }
+        return true;
+}
+
+void getconf_cache_close(getconf_cache_t *cache)
+{
+        if (cache->map != NULL)
+                munmap((void *)cache->map, cache->size);
+        memset(cache, 0, sizeof(getconf_cache_t));
+}
+
+void getconf_cache_get(const getconf_cache_t *cache, uint32_t index, getconf_cache_value_t *value)
+{
+        uint32_t off = index < cache->value_cnt ? cache->offsets[index] : GETCONF_CACHE_NONE;
+
+        memset(value, 0, sizeof(getconf_cache_value_t));
+        if (off == GETCONF_CACHE_NONE)
+                return;
+        value->held = true;
+        value->numeric = (cache->map[off] & GETCONF_CACHE_NUMERIC) != 0;
+        if ((cache->map[off] & GETCONF_CACHE_UNSET) == 0)
+                value->text = (const char *)cache->map + off + 1;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+        const char *p = data;
+
+        while (len > 0) {
+                ssize_t r = write(fd, p, len);
+
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return false;
+                p += r;
+                len -= (size_t)r;
+        }
+        return true;
+}
+
+void getconf_cache_save(const char *path, uint32_t fingerprint,
+                        const getconf_cache_value_t *values, uint32_t value_cnt)
+{
+        getconf_cache_header_t *hdr = NULL;
+        uint32_t *offsets = NULL;
+        unsigned char *buf = NULL;
+        size_t size = sizeof(getconf_cache_header_t) + value_cnt * sizeof(uint32_t);
+        size_t pos = size;
+        char tmp[PATH_MAX];
+        bool ok = false;
+        int fd = -1;
+
+        for (uint32_t i = 0; i < value_cnt; i++) {
+                if (values[i].held)
+                        size += 2 + (values[i].text != NULL ? strlen(values[i].text) : 0);
+        }
+        buf = calloc(1, size);
+        if (buf == NULL)
+                return;
+        hdr = (getconf_cache_header_t *)buf;
+        if (!fill_header(hdr, fingerprint, value_cnt)) {
+                free(buf);
+                return;
+        }
+        hdr->size = size;
+
+        offsets = (uint32_t *)(buf + sizeof(getconf_cache_header_t));
+        for (uint32_t i = 0; i < value_cnt; i++) {
+                const getconf_cache_value_t *v = &values[i];
+                size_t len = v->text != NULL ? strlen(v->text) : 0;
+
+                if (!v->held) {
+                        offsets[i] = GETCONF_CACHE_NONE;
+                        continue;
+                }
+                offsets[i] = (uint32_t)pos;
+                buf[pos] = (unsigned char)((v->numeric ? GETCONF_CACHE_NUMERIC : 0) |
+                                           (v->text == NULL ? GETCONF_CACHE_UNSET : 0));
+                memcpy(buf + pos + 1, v->text != NULL ? v->text : "", len + 1);
+                pos += len + 2;
+        }
+
+        snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+        fd = mkstemp(tmp);
+        if (fd >= 0) {
+                (void)fchmod(fd, 0644);
+                ok = write_all(fd, buf, size);
+                if (close(fd) != 0)
+                        ok = false;
+                if (!ok || rename(tmp, path) != 0)
+                        unlink(tmp);
+        }
+        free(buf);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
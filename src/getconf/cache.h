@@ -0,0 +1,94 @@
+#ifndef GETCONF_CACHE_H
+#define GETCONF_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Boot-scoped snapshot of getconf values.
+ *
+ * sysconf() and confstr() values that cannot change until the next boot
+ * are saved once and answered from the mapping afterwards. The file is
+ * tied to the kernel boot id, the package version and a fingerprint of
+ * the variable table, and is rebuilt whenever any of those differ.
+ *
+ * Caching is opt-in: set GETCONF_CACHE to 1 to keep the file in
+ * $XDG_RUNTIME_DIR (or /run when unset), or to an absolute path to keep
+ * it there instead.
+ *
+ * The header is followed by one uint32_t offset per variable, in table
+ * order, then the values. Each value is a flags byte followed by the NUL
+ * terminated text. Variables not held have GETCONF_CACHE_NONE offsets.
+ */
+#define GETCONF_CACHE_MAGIC 0x43434547U /* GECC */
+#define GETCONF_CACHE_VERSION 1
+#define GETCONF_CACHE_ENV "GETCONF_CACHE"
+#define GETCONF_CACHE_FILE "getconf.cache"
+#define GETCONF_CACHE_NONE UINT32_MAX
+#define GETCONF_CACHE_BOOT_ID_LEN 40
+#define GETCONF_CACHE_VERSION_LEN 32
+
+enum {
+        GETCONF_CACHE_NUMERIC = 1 << 0, /**< Value is a number */
+        GETCONF_CACHE_UNSET = 1 << 1,   /**< confstr() has no value */
+};
+
+typedef struct getconf_cache_header {
+        uint32_t magic;                                  /**< GETCONF_CACHE_MAGIC */
+        uint32_t version;                                /**< GETCONF_CACHE_VERSION */
+        char boot_id[GETCONF_CACHE_BOOT_ID_LEN];         /**< Boot the values are from */
+        char package_version[GETCONF_CACHE_VERSION_LEN]; /**< getconf that wrote them */
+        uint32_t fingerprint;                            /**< Of the variable table */
+        uint32_t value_cnt;                              /**< Number of offsets */
+        uint64_t size;                                   /**< Size of the whole file */
+} getconf_cache_header_t;
+
+/**
+ * A mapped cache file
+ */
+typedef struct getconf_cache {
+        const unsigned char *map;
+        size_t size;
+        const uint32_t *offsets;
+        uint32_t value_cnt;
+} getconf_cache_t;
+
+/**
+ * A value to save, or read back
+ */
+typedef struct getconf_cache_value {
+        bool held;        /**< Whether the cache holds this variable */
+        bool numeric;     /**< Value is a number */
+        const char *text; /**< Value, NULL if confstr() has none */
+} getconf_cache_value_t;
+
+/**
+ * Return the path of the cache file in @buf, or NULL if caching is off
+ */
+extern const char *getconf_cache_path(char *buf, size_t len);
+
+/**
+ * Map the cache at @path. Returns false if it is missing, from another
+ * boot or getconf, or written for a different variable table.
+ */
+extern bool getconf_cache_open(getconf_cache_t *cache, const char *path, uint32_t fingerprint,
+                               uint32_t value_cnt);
+
+extern void getconf_cache_close(getconf_cache_t *cache);
+
+/**
+ * Read back the value of variable @index, setting @value->held to false
+ * when the cache does not hold it
+ */
+extern void getconf_cache_get(const getconf_cache_t *cache, uint32_t index,
+                              getconf_cache_value_t *value);
+
+/**
+ * Save @value_cnt values to @path for the current boot. Failing to is not
+ * an error, the values are simply looked up again next time.
+ */
+extern void getconf_cache_save(const char *path, uint32_t fingerprint,
+                               const getconf_cache_value_t *values, uint32_t value_cnt);
+
+#endif
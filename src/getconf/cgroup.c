@@ -0,0 +1,343 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cgroup.h"
+#include "root.h"
+
+#define SELF_CGROUP "/proc/self/cgroup"
+
+static const char *cgroup_root(void)
+{
+        static char rooted[PATH_MAX];
+        const char *root = getenv(GETCONF_CGROUP_ROOT_ENV);
+
+        if (root != NULL && *root != '\0')
+                return root;
+        return getconf_root_path(GETCONF_CGROUP_ROOT, rooted, sizeof(rooted));
+}
+
+/**
+ * Read the first line of @dir/@file into @buf, without its newline
+ */
+static bool read_line(const char *dir, const char *file, char *buf, size_t len)
+{
+        char path[PATH_MAX];
+        FILE *f = NULL;
+        bool ok = false;
+        int n = snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+        /* A cut off path names some other file */
+        if (n < 0 || (size_t)n >= sizeof(path))
+                return false;
+        f = fopen(path, "re");
+        if (f == NULL)
+                return false;
+        ok = fgets(buf, (int)len, f) != NULL;
+        fclose(f);
+        if (ok)
+                buf[strcspn(buf, "\n")] = '\0';
+        return ok;
+}
+
+/**
+ * Find the cgroup of this process in the hierarchy of @controller, or in
+ * the unified hierarchy when @controller is NULL
+ */
+static bool self_cgroup(const char *controller, char *buf, size_t len)
+{
+        char line[PATH_MAX + 128];
+        char rooted[PATH_MAX];
+        bool found = false;
+        FILE *f = fopen(getconf_root_path(SELF_CGROUP, rooted, sizeof(rooted)), "re");
+
+        if (f == NULL)
+                return false;
+        while (!found && fgets(line, sizeof(line), f) != NULL) {
+                char *controllers = strchr(line, ':');
+                char *path = controllers != NULL ? strchr(controllers + 1, ':') : NULL;
+                char *saveptr = NULL;
+
+                if (path == NULL)
+                        continue;
+                *controllers++ = '\0';
+                *path++ = '\0';
+                path[strcspn(path, "\n")] = '\0';
+                if (controller == NULL) {
+                        found = strcmp(line, "0") == 0 && *controllers == '\0';
+                } else {
+                        for (char *c = strtok_r(controllers, ",", &saveptr); c != NULL && !found;
+                             c = strtok_r(NULL, ",", &saveptr))
+                                found = strcmp(c, controller) == 0;
+                }
+                if (found)
+                        snprintf(buf, len, "%s", path);
+        }
+        fclose(f);
+        return found;
+}
+
+/**
+ * Put the directory of our cgroup for @controller in @dir, and the length
+ * of its hierarchy's root in @base_len. When our cgroup cannot be seen
+ * there, as inside a container with a cgroup namespace of its own, the
+ * root of the hierarchy stands in for it.
+ */
+static bool cgroup_dir(const char *controller, char *dir, size_t len, size_t *base_len)
+{
+        const char *root = cgroup_root();
+        char path[PATH_MAX];
+        char probe[PATH_MAX];
+        struct stat st;
+        bool unified = false;
+
+        snprintf(probe, sizeof(probe), "%s/cgroup.controllers", root);
+        unified = access(probe, F_OK) == 0;
+        if (unified)
+                snprintf(dir, len, "%s", root);
+        else
+                snprintf(dir, len, "%s/%s", root, controller);
+        *base_len = strlen(dir);
+
+        if (self_cgroup(unified ? NULL : controller, path, sizeof(path))) {
+                size_t end = strlen(path);
+
+                while (end > 0 && path[end - 1] == '/')
+                        path[--end] = '\0';
+                snprintf(probe, sizeof(probe), "%s%s", dir, path);
+                if (stat(probe, &st) == 0 && S_ISDIR(st.st_mode))
+                        snprintf(dir, len, "%s", probe);
+        }
+        return unified;
+}
+
+/**
+ * Read a limit of the cgroup at @dir, returning -1 when it sets none
+ */
+typedef long (*limit_reader_t)(const char *dir, bool unified);
+
+/**
+ * Return the tightest limit read by @reader from our cgroup of @controller
+ * and its ancestors, or -1 when none of them sets one
+ */
+static long tightest_limit(const char *controller, limit_reader_t reader)
+{
+        char dir[PATH_MAX];
+        size_t base_len = 0;
+        bool unified = cgroup_dir(controller, dir, sizeof(dir), &base_len);
+        long best = -1;
+
+        for (;;) {
+                long limit = reader(dir, unified);
+                char *slash = NULL;
+
+                if (limit >= 0 && (best < 0 || limit < best))
+                        best = limit;
+                if (strlen(dir) <= base_len)
+                        break;
+                slash = strrchr(dir, '/');
+                if (slash == NULL || (size_t)(slash - dir) < base_len)
+                        break;
+                *slash = '\0';
+        }
+        return best;
+}
+
+/**
+ * CPUs worth of time the cpu.max quota (cfs_quota_us in v1) allows,
+ * rounded up
+ */
+static long cpu_quota(const char *dir, bool unified)
+{
+        unsigned long long quota = 0;
+        unsigned long long period = 0;
+        char buf[64];
+
+        if (unified) {
+                /* "max 100000" when unlimited, failing the scan */
+                if (!read_line(dir, "cpu.max", buf, sizeof(buf)) ||
+                    sscanf(buf, "%llu %llu", &quota, &period) != 2)
+                        return -1;
+        } else {
+                long long v1_quota = -1;
+
+                if (!read_line(dir, "cpu.cfs_quota_us", buf, sizeof(buf)) ||
+                    sscanf(buf, "%lld", &v1_quota) != 1 || v1_quota <= 0)
+                        return -1;
+                if (!read_line(dir, "cpu.cfs_period_us", buf, sizeof(buf)) ||
+                    sscanf(buf, "%llu", &period) != 1)
+                        return -1;
+                quota = (unsigned long long)v1_quota;
+        }
+        if (period == 0)
+                return -1;
+        return (long)((quota + period - 1) / period);
+}
+
+/**
+ * Bytes memory.max (limit_in_bytes in v1) allows
+ */
+static long memory_limit(const char *dir, bool unified)
+{
+        unsigned long long limit = 0;
+        char buf[64];
+
+        /* "max" when unlimited, failing the scan */
+        if (!read_line(dir, unified ? "memory.max" : "memory.limit_in_bytes", buf, sizeof(buf)) ||
+            sscanf(buf, "%llu", &limit) != 1)
+                return -1;
+        return limit > LONG_MAX ? LONG_MAX : (long)limit;
+}
+
+/**
+ * Count the CPUs of a list such as "0-3,8,10-11", returning -1 if empty
+ * or malformed
+ */
+static long count_cpu_list(const char *list)
+{
+        long cnt = 0;
+
+        while (*list != '\0') {
+                char *end = NULL;
+                unsigned long first = strtoul(list, &end, 10);
+                unsigned long last = first;
+
+                if (end == list)
+                        return -1;
+                if (*end == '-') {
+                        list = end + 1;
+                        last = strtoul(list, &end, 10);
+                        if (end == list || last < first)
+                                return -1;
+                }
+                cnt += (long)(last - first + 1);
+                if (*end == ',')
+                        end++;
+                else if (*end != '\0')
+                        return -1;
+                list = end;
+        }
+        return cnt > 0 ? cnt : -1;
+}
+
+/**
+ * CPUs the cpuset of our cgroup lets us run on, already narrowed down by
+ * its ancestors
+ */
+static long cpuset_cpus(void)
+{
+        char dir[PATH_MAX];
+        char buf[4096];
+        size_t base_len = 0;
+        bool unified = cgroup_dir("cpuset", dir, sizeof(dir), &base_len);
+
+        if (!read_line(dir, unified ? "cpuset.cpus.effective" : "cpuset.effective_cpus", buf,
+                       sizeof(buf)))
+                return -1;
+        return count_cpu_list(buf);
+}
+
+/**
+ * CPUs in our affinity mask, growing the mask for machines with more
+ * CPUs than the default cpu_set_t holds
+ */
+static long affinity_cpus(void)
+{
+        for (int max = CPU_SETSIZE; max <= (1 << 20); max *= 2) {
+                cpu_set_t *set = CPU_ALLOC((size_t)max);
+                size_t size = CPU_ALLOC_SIZE((size_t)max);
+                long cnt = -1;
+
+                if (set == NULL)
+                        return -1;
+                if (sched_getaffinity(0, size, set) == 0)
+                        cnt = CPU_COUNT_S(size, set);
+                CPU_FREE(set);
+                if (cnt >= 0)
+                        return cnt;
+        }
+        return -1;
+}
+
+static long effective_nprocessors(void)
+{
+        long cpus = affinity_cpus();
+        long limit = -1;
+
+        if (cpus <= 0)
+                cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        limit = cpuset_cpus();
+        if (limit > 0 && limit < cpus)
+                cpus = limit;
+        limit = tightest_limit("cpu", cpu_quota);
+        if (limit > 0 && limit < cpus)
+                cpus = limit;
+        return cpus > 0 ? cpus : 1;
+}
+
+static long effective_phys_pages(void)
+{
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long page_size = sysconf(_SC_PAGESIZE);
+        long limit = tightest_limit("memory", memory_limit);
+
+        if (limit >= 0 && page_size > 0 && (pages < 0 || limit / page_size < pages))
+                pages = limit / page_size;
+        return pages;
+}
+
+long getconf_cgroup_value(int key)
+{
+        switch (key) {
+        case GETCONF_CGROUP_NPROCESSORS:
+                return effective_nprocessors();
+        case GETCONF_CGROUP_PHYS_PAGES:
+                return effective_phys_pages();
+        default:
+                return -1;
+        }
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,32 @@
+#ifndef GETCONF_CGROUP_H
+#define GETCONF_CGROUP_H
+
+/**
+ * CPU and memory actually available to this process.
+ *
+ * sysconf() reports what the machine has, but inside a container the
+ * process may only run on some of the CPUs (its affinity mask and cpuset)
+ * for a fraction of their time (the cpu.max quota), and within a memory
+ * limit. These values apply all of those, taking the tightest limit of
+ * the process's cgroup and all of its ancestors.
+ *
+ * Both the unified (v2) hierarchy and the per-controller (v1) ones are
+ * understood. The hierarchy is looked for at GETCONF_CGROUP_ROOT when
+ * set, /sys/fs/cgroup under the getconf root otherwise, so that a fake
+ * tree can stand in for it. The getconf root also supplies
+ * /proc/self/cgroup.
+ */
+#define GETCONF_CGROUP_ROOT_ENV "GETCONF_CGROUP_ROOT"
+#define GETCONF_CGROUP_ROOT "/sys/fs/cgroup"
+
+enum {
+        GETCONF_CGROUP_NPROCESSORS = 0, /**< CPUs we may keep busy */
+        GETCONF_CGROUP_PHYS_PAGES = 1,  /**< Pages of memory we may use */
+};
+
+/**
+ * Return the value for @key, one of the GETCONF_CGROUP_* keys, or -1
+ */
+extern long getconf_cgroup_value(int key);
+
+#endif
@@ -34,7 +34,13 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "cache.h"
+#include "cgroup.h"
 #include "config.h"
+#include "getconf-hash.h"
+#include "root.h"
+#include "survey.h"
+#include "sysfs.h"
 
 /**
  * How we'll find a given variable by name.
@@ -44,6 +50,8 @@ typedef enum {
         LOOKUP_PATHCONF = 1, /**< Lookup in pathconf() */
         LOOKUP_CONFSTR = 2,  /**< Lookup in confstr() */
         LOOKUP_DEFINE = 3,   /**< Already defined, print it. */
+        LOOKUP_CGROUP = 4,   /**< Computed from affinity and cgroup limits */
+        LOOKUP_SYSFS = 5,    /**< Read from sysfs */
 } LookupMethod;
 
 /**
@@ -63,6 +71,7 @@ typedef struct SystemConfigVariable {
                 short skey;     /**< Short key */
         };
         bool unsign;         /**< Signed/unsigned */
+        bool volatile_value; /**< May change within a boot, never cached */
         LookupMethod method; /**< Where to retrieve variable */
 } SystemConfigVariable;
 
@@ -74,6 +83,16 @@ typedef struct SystemConfigVariable {
                 .name = N, .skey = K, .method = LOOKUP_SYSCONF, .unsign = false                    \
         }
 
+/**
+ * The variable is callable via sysconf() interface, and depends on the
+ * process limits or the current state of the system
+ */
+#define GET_VOLATILE_SYSCONF_VARIABLE(N, K)                                                        \
+        {                                                                                          \
+                .name = N, .skey = K, .method = LOOKUP_SYSCONF, .unsign = false,                   \
+                .volatile_value = true                                                             \
+        }
+
 /**
  * The variable is compiler-defined, and is a signed number
  */
@@ -106,6 +125,24 @@ typedef struct SystemConfigVariable {
                 .name = N, .lkey = K, .method = LOOKUP_PATHCONF, .unsign = false                   \
         }
 
+/**
+ * The variable is what the cgroup of this process leaves of a sysconf()
+ * value, see cgroup.h
+ */
+#define GET_CGROUP_VARIABLE(N, K)                                                                  \
+        {                                                                                          \
+                .name = N, .skey = K, .method = LOOKUP_CGROUP, .unsign = false,                    \
+                .volatile_value = true                                                             \
+        }
+
+/**
+ * The variable is read from sysfs, see sysfs.h
+ */
+#define GET_SYSFS_VARIABLE(N, K)                                                                   \
+        {                                                                                          \
+                .name = N, .skey = K, .method = LOOKUP_SYSFS, .unsign = false                      \
+        }
+
 /**
  * All of our variables come from getconf.inc to make it easier to
  * maintain
@@ -120,28 +157,65 @@ static SystemConfigVariable system_config_vars[] = {
 #define ARRAY_SIZE(v) sizeof(v) / sizeof(v[0])
 
 /**
- * Print a single variable and its corresponding value
+ * Snapshot of this boot's values, when GETCONF_CACHE asks for one
  */
-static inline void print_one(const SystemConfigVariable *v, const char *filename)
+static getconf_cache_t value_cache;
+
+/**
+ * Only sysconf() and confstr() values are worth keeping, and only those
+ * which hold for the whole boot
+ */
+static inline bool is_cacheable(const SystemConfigVariable *v)
+{
+        return (v->method == LOOKUP_SYSCONF || v->method == LOOKUP_CONFSTR) && !v->volatile_value;
+}
+
+/**
+ * Format the value of a single variable into a newly allocated string.
+ * Returns NULL if confstr() has no value for it. Numbers are flagged in
+ * @numeric so that exports can leave them unquoted.
+ */
+static char *format_value(const SystemConfigVariable *v, const char *filename, bool *numeric)
 {
+        char *buffer = NULL;
+        int ret = -1;
+
+        if (value_cache.map != NULL && is_cacheable(v)) {
+                getconf_cache_value_t cached;
+
+                getconf_cache_get(&value_cache, (uint32_t)(v - system_config_vars), &cached);
+                if (cached.held) {
+                        *numeric = cached.numeric;
+                        if (!cached.text) {
+                                return NULL;
+                        }
+                        buffer = strdup(cached.text);
+                        if (!buffer) {
+                                abort();
+                        }
+                        return buffer;
+                }
+        }
+
+        *numeric = true;
         switch (v->method) {
         case LOOKUP_SYSCONF:
-                fprintf(stdout, "%ld\n", sysconf(v->skey));
+                ret = asprintf(&buffer, "%ld", sysconf(v->skey));
                 break;
         case LOOKUP_DEFINE:
                 if (v->unsign) {
-                        fprintf(stdout, "%llu\n", (unsigned long long)v->lkey);
+                        ret = asprintf(&buffer, "%llu", (unsigned long long)v->lkey);
                 } else {
-                        fprintf(stdout, "%lld\n", v->lkey);
+                        ret = asprintf(&buffer, "%lld", v->lkey);
                 }
                 break;
         case LOOKUP_CONFSTR: {
-                char *buffer = NULL;
                 size_t sz = 0;
 
+                *numeric = false;
                 sz = confstr((int)v->lkey, buffer, 0);
                 if (sz <= 0) {
-                        return;
+                        return NULL;
                 }
                 /* Ensure we can allocate */
                 buffer = calloc(sz, sizeof(char));
@@ -153,16 +227,44 @@ static inline void print_one(const SystemConfigVariable *v, const char *filename
                         free(buffer);
                         abort();
                 }
-                fprintf(stdout, "%s\n", buffer);
-                free(buffer);
-                break;
+                return buffer;
         }
+        case LOOKUP_CGROUP:
+                ret = asprintf(&buffer, "%ld", getconf_cgroup_value(v->skey));
+                break;
+        case LOOKUP_SYSFS:
+                buffer = getconf_sysfs_value(v->skey, numeric);
+                return buffer;
         case LOOKUP_PATHCONF:
-                fprintf(stdout, "%ld\n", pathconf(filename == NULL ? "." : filename, v->skey));
+                ret = asprintf(&buffer,
+                               "%ld",
+                               pathconf(filename == NULL ? "." : filename, v->skey));
                 break;
         default:
-                fprintf(stdout, "\n");
+                *numeric = false;
+                buffer = strdup("");
+                ret = buffer != NULL ? 0 : -1;
+                break;
+        }
+        if (ret < 0) {
+                abort();
+        }
+        return buffer;
+}
+
+/**
+ * Print a single variable and its corresponding value
+ */
+static inline void print_one(const SystemConfigVariable *v, const char *filename)
+{
+        bool numeric = false;
+        char *value = format_value(v, filename, &numeric);
+
+        if (!value) {
+                return;
         }
+        fprintf(stdout, "%s\n", value);
+        free(value);
 }
 
 /**
@@ -186,21 +288,452 @@ static void print_all(const char *filename)
         }
 }
 
+/**
+ * Identify the variable table, so that a cache written by a getconf with
+ * a different getconf.inc is never trusted
+ */
+static uint32_t table_fingerprint(void)
+{
+        uint32_t fingerprint = 2166136261U;
+
+        for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
+                const SystemConfigVariable *v = &system_config_vars[i];
+
+                fingerprint ^= getconf_hash(v->name, (uint32_t)v->method);
+                fingerprint = (fingerprint ^ (uint32_t)v->lkey) * 16777619U;
+        }
+        return fingerprint;
+}
+
+/**
+ * Map the cache of this boot's values, writing it first if it is missing
+ * or stale. Without GETCONF_CACHE set every value is looked up afresh.
+ */
+static void load_cache(void)
+{
+        getconf_cache_value_t values[ARRAY_SIZE(system_config_vars)];
+        char *texts[ARRAY_SIZE(system_config_vars)];
+        uint32_t fingerprint = 0;
+        char path[PATH_MAX];
+
+        /* Left mapped by an earlier run in this process, under the bash builtins */
+        getconf_cache_close(&value_cache);
+        if (!getconf_cache_path(path, sizeof(path))) {
+                return;
+        }
+        fingerprint = table_fingerprint();
+        if (getconf_cache_open(&value_cache, path, fingerprint, ARRAY_SIZE(system_config_vars))) {
+                return;
+        }
+
+        memset(values, 0, sizeof(values));
+        memset(texts, 0, sizeof(texts));
+        for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
+                const SystemConfigVariable *v = &system_config_vars[i];
+
+                if (!is_cacheable(v)) {
+                        continue;
+                }
+                texts[i] = format_value(v, NULL, &values[i].numeric);
+                values[i].text = texts[i];
+                values[i].held = true;
+        }
+        getconf_cache_save(path, fingerprint, values, ARRAY_SIZE(system_config_vars));
+        for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
+                free(texts[i]);
+        }
+        (void)getconf_cache_open(&value_cache, path, fingerprint, ARRAY_SIZE(system_config_vars));
+}
+
+/**
+ * getconf-hash.h is generated from getconf.inc, and must agree with it
+ */
+_Static_assert(GETCONF_HASH_SLOTS == ARRAY_SIZE(system_config_vars),
+               "getconf-hash.h is out of date with getconf.inc");
+
 /**
  * Return the SystemConfigVariable for the given variable name.
  * Returns NULL ("undefined") if it cannot be found
+ *
+ * Names are resolved through the minimal perfect hash built from
+ * getconf.inc, leaving a single name to compare.
  */
 static const SystemConfigVariable *find_variable(const char *name)
 {
-        for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
-                const SystemConfigVariable *var = &system_config_vars[i];
-                if (var && var->name && name && strcmp(name, var->name) == 0) {
-                        return var;
+        const SystemConfigVariable *var = NULL;
+        uint32_t seed = 0;
+        uint32_t slot = 0;
+
+        if (name == NULL)
+                return NULL;
+        seed = getconf_hash_seeds[getconf_hash(name, 0) % GETCONF_HASH_BUCKETS];
+        slot = getconf_hash(name, seed) % GETCONF_HASH_SLOTS;
+        var = &system_config_vars[getconf_hash_slots[slot]];
+        if (strcmp(name, var->name) != 0)
+                return NULL;
+        return var;
+}
+
+/**
+ * Formats understood by --export
+ */
+typedef enum {
+        EXPORT_NONE = 0,
+        EXPORT_SH,   /**< NAME=value lines for eval */
+        EXPORT_JSON, /**< A single JSON object */
+} ExportFormat;
+
+/**
+ * Characters that need no quoting in the value of a shell assignment
+ */
+#define SH_SAFE_CHARS                                                                              \
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_+-=,./:@%"
+
+/**
+ * Print @value as a shell word, single-quoting it when needed
+ */
+static void print_sh_value(const char *value)
+{
+        if (*value != '\0' && value[strspn(value, SH_SAFE_CHARS)] == '\0') {
+                fputs(value, stdout);
+                return;
+        }
+        fputc('\'', stdout);
+        for (const char *c = value; *c != '\0'; c++) {
+                if (*c == '\'') {
+                        fputs("'\\''", stdout);
+                } else {
+                        fputc(*c, stdout);
+                }
+        }
+        fputc('\'', stdout);
+}
+
+/**
+ * Print @value as a JSON string
+ */
+static void print_json_string(const char *value)
+{
+        fputc('"', stdout);
+        for (const unsigned char *c = (const unsigned char *)value; *c != '\0'; c++) {
+                switch (*c) {
+                case '"':
+                        fputs("\\\"", stdout);
+                        break;
+                case '\\':
+                        fputs("\\\\", stdout);
+                        break;
+                case '\n':
+                        fputs("\\n", stdout);
+                        break;
+                case '\t':
+                        fputs("\\t", stdout);
+                        break;
+                default:
+                        if (*c < 0x20) {
+                                fprintf(stdout, "\\u%04x", *c);
+                        } else {
+                                fputc(*c, stdout);
+                        }
+                        break;
+                }
+        }
+        fputc('"', stdout);
+}
+
+/**
+ * Print one variable in the given export format. @first tells JSON
+ * output whether a separator is due.
+ */
+static void export_one(const SystemConfigVariable *v, const char *filename, ExportFormat format,
+                       bool first)
+{
+        bool numeric = false;
+        char *value = format_value(v, filename, &numeric);
+
+        if (format == EXPORT_JSON) {
+                fputs(first ? "\n  " : ",\n  ", stdout);
+                print_json_string(v->name);
+                fputs(": ", stdout);
+                if (!value) {
+                        fputs("null", stdout);
+                } else if (numeric) {
+                        fputs(value, stdout);
+                } else {
+                        print_json_string(value);
+                }
+        } else {
+                /* Nothing to assign, leave the variable unset */
+                if (value) {
+                        fprintf(stdout, "%s=", v->name);
+                        print_sh_value(value);
+                        fputc('\n', stdout);
                 }
         }
+        free(value);
+}
+
+/**
+ * Take the last argument as the pathname for pathconf() variables when
+ * it is not itself a variable name and does exist, so that a mistyped
+ * name is still reported as such.
+ */
+static const char *pop_pathname(int *argc, char **argv)
+{
+        if (*argc > 0 && !find_variable(argv[*argc - 1]) && access(argv[*argc - 1], F_OK) == 0) {
+                *argc -= 1;
+                return argv[*argc];
+        }
         return NULL;
 }
 
+/**
+ * Export the named variables, or all of them when none are named.
+ * Unknown names are reported and make the export fail, while the
+ * others are still printed.
+ */
+static int export_variables(int argc, char **argv, ExportFormat format)
+{
+        const char *filename = pop_pathname(&argc, argv);
+        int ret = EXIT_SUCCESS;
+        bool first = true;
+
+        if (format == EXPORT_JSON) {
+                fputc('{', stdout);
+        }
+        if (argc == 0) {
+                for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
+                        export_one(&system_config_vars[i], filename, format, first);
+                        first = false;
+                }
+        }
+        for (int i = 0; i < argc; i++) {
+                const SystemConfigVariable *variable = find_variable(argv[i]);
+
+                if (!variable) {
+                        fprintf(stderr, "getconf: %s: undefined variable\n", argv[i]);
+                        ret = EXIT_FAILURE;
+                        continue;
+                }
+                export_one(variable, filename, format, first);
+                first = false;
+        }
+        if (format == EXPORT_JSON) {
+                fputs(first ? "}\n" : "\n}\n", stdout);
+        }
+        return ret;
+}
+
+/**
+ * Print the value of each named variable on a line of its own, in the
+ * order given, so that callers can read them back positionally.
+ */
+static int print_batch(int argc, char **argv)
+{
+        const char *filename = pop_pathname(&argc, argv);
+
+        for (int i = 0; i < argc; i++) {
+                const SystemConfigVariable *variable = find_variable(argv[i]);
+                bool numeric = false;
+                char *value = NULL;
+
+                if (!variable) {
+                        fputs("undefined\n", stdout);
+                        continue;
+                }
+                value = format_value(variable, filename, &numeric);
+                fprintf(stdout, "%s\n", value ? value : "");
+                free(value);
+        }
+        return EXIT_SUCCESS;
+}
+
+/**
+ * Set once the locale is loaded, by locale_init() or by a host process
+ * that owns it, such as a shell running the bash builtins
+ */
+bool getconf_locale_loaded = false;
+
+/**
+ * Load the locale of the environment. Only the error text of the survey
+ * depends on it, so this waits until a failure is about to be printed
+ * rather than slowing every start down.
+ */
+static void locale_init(void)
+{
+        if (!getconf_locale_loaded) {
+                setlocale(LC_ALL, "");
+                getconf_locale_loaded = true;
+        }
+}
+
+/**
+ * Print the outcome of one surveyed path as a member of a JSON object
+ */
+static void print_survey_json(const char *path, const survey_result_t *res,
+                              const SystemConfigVariable *const *columns, size_t col_cnt)
+{
+        fputs("  ", stdout);
+        print_json_string(path);
+        fputs(": {", stdout);
+        switch (res->state) {
+        case SURVEY_DONE:
+                for (size_t i = 0; i < col_cnt; i++) {
+                        fputs(i == 0 ? "" : ", ", stdout);
+                        print_json_string(columns[i]->name);
+                        fprintf(stdout, ": %ld", res->values[i]);
+                }
+                break;
+        case SURVEY_FAILED:
+                fputs("\"error\": ", stdout);
+                locale_init();
+                print_json_string(strerror(res->err));
+                break;
+        case SURVEY_TIMEOUT:
+                fputs("\"error\": \"timed out\"", stdout);
+                break;
+        }
+        fputc('}', stdout);
+}
+
+/**
+ * Print the survey as a table, a row per path and a column per variable
+ */
+static void print_survey_table(char *const *paths, size_t path_cnt, const survey_result_t *results,
+                               const SystemConfigVariable *const *columns, size_t col_cnt)
+{
+        int widths[ARRAY_SIZE(system_config_vars)];
+        int path_width = (int)strlen("PATH");
+
+        for (size_t p = 0; p < path_cnt; p++) {
+                if ((int)strlen(paths[p]) > path_width) {
+                        path_width = (int)strlen(paths[p]);
+                }
+        }
+        for (size_t i = 0; i < col_cnt; i++) {
+                widths[i] = (int)strlen(columns[i]->name);
+                for (size_t p = 0; p < path_cnt; p++) {
+                        int len = snprintf(NULL, 0, "%ld", results[p].values[i]);
+
+                        if (results[p].state == SURVEY_DONE && len > widths[i]) {
+                                widths[i] = len;
+                        }
+                }
+        }
+
+        /* No padding after the last column */
+        widths[col_cnt - 1] = 0;
+
+        fprintf(stdout, "%-*s", path_width, "PATH");
+        for (size_t i = 0; i < col_cnt; i++) {
+                fprintf(stdout, "  %-*s", widths[i], columns[i]->name);
+        }
+        fputc('\n', stdout);
+        for (size_t p = 0; p < path_cnt; p++) {
+                fprintf(stdout, "%-*s", path_width, paths[p]);
+                switch (results[p].state) {
+                case SURVEY_DONE:
+                        for (size_t i = 0; i < col_cnt; i++) {
+                                fprintf(stdout, "  %-*ld", widths[i], results[p].values[i]);
+                        }
+                        break;
+                case SURVEY_FAILED:
+                        locale_init();
+                        fprintf(stdout, "  %s", strerror(results[p].err));
+                        break;
+                case SURVEY_TIMEOUT:
+                        fputs("  timed out", stdout);
+                        break;
+                }
+                fputc('\n', stdout);
+        }
+}
+
+/**
+ * Query pathconf() variables across many paths in parallel. Arguments
+ * naming pathconf() variables pick the columns, all of them by default;
+ * the others are paths, every mount point when none are given. Fails if
+ * any path could not be queried in time.
+ */
+static int run_survey(int argc, char **argv, ExportFormat format, int timeout_ms)
+{
+        const SystemConfigVariable *columns[ARRAY_SIZE(system_config_vars)];
+        int keys[ARRAY_SIZE(system_config_vars)];
+        survey_result_t *results = NULL;
+        char **mounts = NULL;
+        char **paths = NULL;
+        size_t col_cnt = 0;
+        size_t path_cnt = 0;
+        int ret = EXIT_SUCCESS;
+
+        if (format == EXPORT_SH) {
+                fputs("getconf: --survey can only be exported as json\n", stderr);
+                return EXIT_FAILURE;
+        }
+        paths = calloc((size_t)argc + 1, sizeof(char *));
+        if (!paths) {
+                abort();
+        }
+        for (int i = 0; i < argc; i++) {
+                const SystemConfigVariable *variable = find_variable(argv[i]);
+
+                if (!variable) {
+                        paths[path_cnt++] = argv[i];
+                } else if (variable->method == LOOKUP_PATHCONF) {
+                        columns[col_cnt++] = variable;
+                } else {
+                        fprintf(stderr, "getconf: %s: not a pathconf variable\n", argv[i]);
+                        free(paths);
+                        return EXIT_FAILURE;
+                }
+        }
+        if (col_cnt == 0) {
+                for (uint16_t i = 0; i < ARRAY_SIZE(system_config_vars); i++) {
+                        if (system_config_vars[i].method == LOOKUP_PATHCONF) {
+                                columns[col_cnt++] = &system_config_vars[i];
+                        }
+                }
+        }
+        if (path_cnt == 0) {
+                free(paths);
+                paths = mounts = survey_mount_points(&path_cnt);
+                if (!mounts) {
+                        fputs("getconf: cannot read the mount points\n", stderr);
+                        return EXIT_FAILURE;
+                }
+        }
+        for (size_t i = 0; i < col_cnt; i++) {
+                keys[i] = columns[i]->skey;
+        }
+
+        if (!survey_run(paths, path_cnt, keys, col_cnt, timeout_ms, &results)) {
+                abort();
+        }
+        if (format == EXPORT_JSON) {
+                fputc('{', stdout);
+                for (size_t p = 0; p < path_cnt; p++) {
+                        fputs(p == 0 ? "\n" : ",\n", stdout);
+                        print_survey_json(paths[p], &results[p], columns, col_cnt);
+                }
+                fputs(path_cnt == 0 ? "}\n" : "\n}\n", stdout);
+        } else {
+                print_survey_table(paths, path_cnt, results, columns, col_cnt);
+        }
+        for (size_t p = 0; p < path_cnt; p++) {
+                if (results[p].state != SURVEY_DONE) {
+                        ret = EXIT_FAILURE;
+                }
+        }
+
+        survey_free(results, path_cnt);
+        if (mounts) {
+                survey_free_paths(mounts, path_cnt);
+        } else {
+                free(paths);
+        }
+        return ret;
+}
+
 /**
  * Program arguments.
  */
@@ -214,6 +747,9 @@ static struct option prog_opts[] = {
         },
         { "help", no_argument, 0, 'h' },
         { "all", no_argument, 0, 'a' },
+        { "export", optional_argument, 0, 'e' },
+        { "survey", optional_argument, 0, 's' },
+        { "root", required_argument, 0, 'R' },
         { NULL, 0, 0, 0 },
 };
 
@@ -223,7 +759,12 @@ static struct option prog_opts[] = {
 static void printUsage(const char *progname)
 {
         fprintf(stdout, "Usage: %s [-v specification] variable_name [pathname]\n", progname);
+        fprintf(stdout, "       %s variable_name... [pathname]\n", progname);
+        fprintf(stdout, "       %s --export[=sh|json] [variable_name...] [pathname]\n", progname);
         fprintf(stdout, "       %s -a [pathname]\n", progname);
+        fprintf(stdout,
+                "       %s --survey[=seconds] [variable_name...] [pathname...]\n",
+                progname);
 }
 
 /**
@@ -239,6 +780,20 @@ static void printHelp(const char *progname)
               stdout);
         fputs("    -V, --version                        Display program version and quit\n",
               stdout);
+        fputs("        --export[=sh|json]               Print variables as shell assignments\n",
+              stdout);
+        fputs("                                         or a JSON object, all if none named\n",
+              stdout);
+        fputs("        --survey[=seconds]               Query pathconf variables of many paths\n",
+              stdout);
+        fputs("                                         (all mount points if none given) in\n",
+              stdout);
+        fputs("                                         parallel, each within a timeout (5s)\n",
+              stdout);
+        fputs("        --root=DIR                       Read sysfs and procfs under DIR, not /\n",
+              stdout);
+        fputs("                                         (also set by $" GETCONF_ROOT_ENV ")\n",
+              stdout);
 }
 
 /**
@@ -255,7 +810,11 @@ static void printVersion(void)
 /**
  * Main entry point into the program
  */
+#ifdef MULTICALL
+int getconf_main(int argc, char **argv)
+#else
 int main(int argc, char **argv)
+#endif
 {
         int opt = 0;
         __attribute__((unused)) const char *specification = NULL;
@@ -264,8 +823,10 @@ int main(int argc, char **argv)
         /* Stash before winding */
         const char *progname = argv[0];
         bool listing = false;
-
-        setlocale(LC_ALL, "");
+        ExportFormat export_format = EXPORT_NONE;
+        bool surveying = false;
+        int survey_timeout_ms = SURVEY_TIMEOUT_MS;
+        const char *root = getenv(GETCONF_ROOT_ENV);
 
         while (process_loop) {
                 int option_index = 0;
@@ -285,6 +846,35 @@ int main(int argc, char **argv)
                 case 'a':
                         listing = true;
                         break;
+                case 'e':
+                        if (!optarg || strcmp(optarg, "sh") == 0) {
+                                export_format = EXPORT_SH;
+                        } else if (strcmp(optarg, "json") == 0) {
+                                export_format = EXPORT_JSON;
+                        } else {
+                                fprintf(stderr, "Unknown export format: %s\n", optarg);
+                                printUsage(progname);
+                                return EXIT_FAILURE;
+                        }
+                        break;
+                case 's':
+                        surveying = true;
+                        if (optarg) {
+                                char *end = NULL;
+                                double seconds = strtod(optarg, &end);
+
+                                if (end == optarg || *end != '\0' || !(seconds > 0) ||
+                                    seconds > INT_MAX / 1000) {
+                                        fprintf(stderr, "Invalid timeout: %s\n", optarg);
+                                        printUsage(progname);
+                                        return EXIT_FAILURE;
+                                }
+                                survey_timeout_ms = (int)(seconds * 1000);
+                        }
+                        break;
+                case 'R':
+                        root = optarg;
+                        break;
                 case -1:
                         process_loop = false;
                         break;
@@ -303,6 +893,28 @@ int main(int argc, char **argv)
         argc -= optind;
         argv += optind;
 
+        if (!getconf_root_set(root)) {
+                fputs("Out of memory\n", stderr);
+                return EXIT_FAILURE;
+        }
+
+        if (surveying) {
+                return run_survey(argc, argv, export_format, survey_timeout_ms);
+        }
+
+        load_cache();
+
+        /**
+         * Exporting covers the whole -a listing unless variables are named
+         */
+        if (export_format != EXPORT_NONE) {
+                if (listing && argc > 1) {
+                        printUsage(progname);
+                        return EXIT_FAILURE;
+                }
+                return export_variables(argc, argv, export_format);
+        }
+
         /**
          * When listing, we accept only 1 argument, for pathconf() usage
          */
@@ -321,7 +933,8 @@ int main(int argc, char **argv)
 
         /**
          * Process according to the number of arguments. A filepath means
-         * we'll only deal with PATHCONF variables.
+         * we'll only deal with PATHCONF variables. Any other list of names
+         * is a batch, printing one value per line.
          */
         switch (argc) {
         /* sysconf/defines/confstr */
@@ -335,6 +948,9 @@ int main(int argc, char **argv)
                 break;
         /* pathconf only */
         case 2:
+                if (find_variable(argv[1])) {
+                        return print_batch(argc, argv);
+                }
                 variable = find_variable(argv[0]);
                 if (!variable) {
                         return EXIT_SUCCESS;
@@ -346,9 +962,11 @@ int main(int argc, char **argv)
                 }
                 print_one(variable, argv[1]);
                 break;
-        default:
+        case 0:
                 printUsage(progname);
                 break;
+        default:
+                return print_batch(argc, argv);
         }
 
         return 0;
@@ -0,0 +1,68 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "root.h"
+
+static char *root_dir = NULL;
+
+bool getconf_root_set(const char *dir)
+{
+        size_t len = dir != NULL ? strlen(dir) : 0;
+
+        while (len > 0 && dir[len - 1] == '/')
+                len--;
+        free(root_dir);
+        root_dir = NULL;
+        if (len == 0)
+                return true;
+        root_dir = strndup(dir, len);
+        return root_dir != NULL;
+}
+
+const char *getconf_root_path(const char *path, char *buf, size_t len)
+{
+        if (root_dir == NULL)
+                return path;
+        snprintf(buf, len, "%s%s", root_dir, path);
+        return buf;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
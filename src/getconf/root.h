@@ -0,0 +1,26 @@
+#ifndef GETCONF_ROOT_H
+#define GETCONF_ROOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Directory standing in for / when reading sysfs and procfs, set with
+ * --root or LIBC_SUPPORT_ROOT. sysconf(), confstr() and pathconf() answer
+ * for the running system regardless.
+ */
+#define GETCONF_ROOT_ENV "LIBC_SUPPORT_ROOT"
+
+/**
+ * Use @dir as the root. An empty or NULL @dir, or "/", means the real
+ * root. Returns false if out of memory.
+ */
+extern bool getconf_root_set(const char *dir);
+
+/**
+ * Return the absolute system @path as seen under the root, using @buf
+ * when it has to be rewritten
+ */
+extern const char *getconf_root_path(const char *path, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "survey.h"
+
+#define MOUNTINFO "/proc/self/mountinfo"
+
+/**
+ * A child querying one path
+ */
+typedef struct survey_job {
+        size_t path;        /**< Index of the path and its result */
+        pid_t pid;
+        int fd;             /**< Read end of the child's pipe */
+        long *buf;          /**< errno, then one value per key */
+        size_t got;         /**< Bytes of buf read so far */
+        long long deadline; /**< CLOCK_MONOTONIC milliseconds */
+} survey_job_t;
+
+static long long now_ms(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Query @path in the child and write back errno and the values. Keys the
+ * filesystem does not know fail with EINVAL, which is not a failure of
+ * the path itself.
+ */
+static void __attribute__((noreturn))
+survey_child(int fd, const char *path, const int *keys, size_t key_cnt, long *buf)
+{
+        size_t len = (key_cnt + 1) * sizeof(long);
+        const char *p = (const char *)buf;
+
+        memset(buf, 0, len);
+        for (size_t i = 0; i < key_cnt; i++) {
+                errno = 0;
+                buf[i + 1] = pathconf(path, keys[i]);
+                if (buf[i + 1] == -1 && errno != 0 && errno != EINVAL) {
+                        buf[0] = errno;
+                        break;
+                }
+        }
+        while (len > 0) {
+                ssize_t r = write(fd, p, len);
+
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        _exit(EXIT_FAILURE);
+                p += r;
+                len -= (size_t)r;
+        }
+        _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Fork the child for @path, or fail its result right away
+ */
+static bool start_job(survey_job_t *job, char *const *paths, size_t path, const int *keys,
+                      size_t key_cnt, int timeout_ms, survey_result_t *results)
+{
+        int fds[2];
+
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+                results[path].state = SURVEY_FAILED;
+                results[path].err = errno;
+                return false;
+        }
+        job->pid = fork();
+        if (job->pid < 0) {
+                results[path].state = SURVEY_FAILED;
+                results[path].err = errno;
+                close(fds[0]);
+                close(fds[1]);
+                return false;
+        }
+        if (job->pid == 0) {
+                close(fds[0]);
+                survey_child(fds[1], paths[path], keys, key_cnt, job->buf);
+        }
+        close(fds[1]);
+        job->path = path;
+        job->fd = fds[0];
+        job->got = 0;
+        job->deadline = now_ms() + timeout_ms;
+        return true;
+}
+
+/**
+ * Collect what the child of @job sent, once it has closed its pipe
+ */
+static void finish_job(survey_job_t *job, size_t key_cnt, survey_result_t *results)
+{
+        survey_result_t *res = &results[job->path];
+
+        close(job->fd);
+        (void)waitpid(job->pid, NULL, 0);
+        if (job->got != (key_cnt + 1) * sizeof(long)) {
+                res->state = SURVEY_FAILED;
+                res->err = EIO;
+                return;
+        }
+        res->err = (int)job->buf[0];
+        res->state = res->err != 0 ? SURVEY_FAILED : SURVEY_DONE;
+        memcpy(res->values, job->buf + 1, key_cnt * sizeof(long));
+}
+
+/**
+ * Give up on the child of @job. A child stuck in the kernel on a hung
+ * mount may not die at once, so it is not waited for; whatever is left
+ * of it is reaped when getconf exits.
+ */
+static void abandon_job(survey_job_t *job, survey_result_t *results)
+{
+        kill(job->pid, SIGKILL);
+        close(job->fd);
+        (void)waitpid(job->pid, NULL, WNOHANG);
+        results[job->path].state = SURVEY_TIMEOUT;
+}
+
+void survey_free(survey_result_t *results, size_t path_cnt)
+{
+        if (results == NULL)
+                return;
+        for (size_t i = 0; i < path_cnt; i++)
+                free(results[i].values);
+        free(results);
+}
+
+bool survey_run(char *const *paths, size_t path_cnt, const int *keys, size_t key_cnt,
+                int timeout_ms, survey_result_t **results)
+{
+        survey_job_t jobs[SURVEY_JOBS_MAX];
+        struct pollfd pfds[SURVEY_JOBS_MAX];
+        survey_result_t *res = calloc(path_cnt, sizeof(survey_result_t));
+        long *bufs = calloc(SURVEY_JOBS_MAX * (key_cnt + 1), sizeof(long));
+        size_t running = 0;
+        size_t next = 0;
+
+        if (res == NULL || bufs == NULL) {
+                free(res);
+                free(bufs);
+                return false;
+        }
+        for (size_t i = 0; i < path_cnt; i++) {
+                res[i].values = calloc(key_cnt, sizeof(long));
+                if (res[i].values == NULL) {
+                        survey_free(res, path_cnt);
+                        free(bufs);
+                        return false;
+                }
+        }
+        /* Output is only written once every child is done */
+        fflush(stdout);
+
+        while (next < path_cnt || running > 0) {
+                long long now = 0;
+                long long wait_ms = -1;
+
+                while (running < SURVEY_JOBS_MAX && next < path_cnt) {
+                        survey_job_t *job = &jobs[running];
+
+                        job->buf = bufs + running * (key_cnt + 1);
+                        if (start_job(job, paths, next, keys, key_cnt, timeout_ms, res))
+                                running++;
+                        next++;
+                }
+                if (running == 0)
+                        break;
+
+                now = now_ms();
+                for (size_t i = 0; i < running; i++) {
+                        long long left = jobs[i].deadline > now ? jobs[i].deadline - now : 0;
+
+                        pfds[i].fd = jobs[i].fd;
+                        pfds[i].events = POLLIN;
+                        pfds[i].revents = 0;
+                        if (wait_ms < 0 || left < wait_ms)
+                                wait_ms = left;
+                }
+                if (poll(pfds, (nfds_t)running, (int)wait_ms) < 0 && errno != EINTR)
+                        break;
+
+                /* Backwards, so that finished jobs can be swapped with the last */
+                now = now_ms();
+                for (size_t i = running; i-- > 0;) {
+                        survey_job_t *job = &jobs[i];
+                        size_t want = (key_cnt + 1) * sizeof(long);
+                        bool finished = false;
+
+                        if (pfds[i].revents != 0) {
+                                ssize_t r = read(job->fd, (char *)job->buf + job->got,
+                                                 want - job->got);
+
+                                if (r > 0)
+                                        job->got += (size_t)r;
+                                else if (r == 0 || errno != EINTR)
+                                        finished = true;
+                        }
+                        if (finished) {
+                                finish_job(job, key_cnt, res);
+                        } else if (now >= job->deadline) {
+                                abandon_job(job, res);
+                        } else {
+                                continue;
+                        }
+                        if (i != running - 1) {
+                                long *buf = job->buf;
+
+                                *job = jobs[running - 1];
+                                memcpy(buf, job->buf, want);
+                                job->buf = buf;
+                        }
+                        running--;
+                }
+        }
+
+        /* Only reached early if poll() itself failed */
+        for (size_t i = 0; i < running; i++)
+                abandon_job(&jobs[i], res);
+        free(bufs);
+        *results = res;
+        return true;
+}
+
+/**
+ * Undo the octal escapes mountinfo uses for spaces and such, in place
+ */
+static void unescape(char *s)
+{
+        char *out = s;
+
+        while (*s != '\0') {
+                if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' && s[2] >= '0' && s[2] <= '7' &&
+                    s[3] >= '0' && s[3] <= '7') {
+                        *out++ = (char)((s[1] - '0') << 6 | (s[2] - '0') << 3 | (s[3] - '0'));
+                        s += 4;
+                } else {
+                        *out++ = *s++;
+                }
+        }
+        *out = '\0';
+}
+
+void survey_free_paths(char **paths, size_t cnt)
+{
+        if (paths == NULL)
+                return;
+        for (size_t i = 0; i < cnt; i++)
+                free(paths[i]);
+        free(paths);
+}
+
+char **survey_mount_points(size_t *cnt)
+{
+        char **paths = NULL;
+        size_t size = 0;
+        char *line = NULL;
+        size_t line_len = 0;
+        FILE *f = fopen(MOUNTINFO, "re");
+
+        *cnt = 0;
+        if (f == NULL)
+                return NULL;
+        while (getline(&line, &line_len, f) > 0) {
+                char *saveptr = NULL;
+                char *field = strtok_r(line, " ", &saveptr);
+                bool seen = false;
+
+                /* id, parent id, major:minor, root, then the mount point */
+                for (int i = 0; i < 4 && field != NULL; i++)
+                        field = strtok_r(NULL, " ", &saveptr);
+                if (field == NULL)
+                        continue;
+                unescape(field);
+                for (size_t i = 0; i < *cnt && !seen; i++)
+                        seen = strcmp(paths[i], field) == 0;
+                if (seen)
+                        continue;
+                if (*cnt == size) {
+                        char **grown = NULL;
+
+                        size = size != 0 ? size * 2 : 64;
+                        grown = realloc(paths, size * sizeof(char *));
+                        if (grown == NULL)
+                                abort();
+                        paths = grown;
+                }
+                paths[*cnt] = strdup(field);
+                if (paths[*cnt] == NULL)
+                        abort();
+                *cnt += 1;
+        }
+        free(line);
+        fclose(f);
+        return paths;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,52 @@
+#ifndef GETCONF_SURVEY_H
+#define GETCONF_SURVEY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * pathconf() over many paths at once.
+ *
+ * Every path is queried by a child process of its own, up to
+ * SURVEY_JOBS_MAX at a time, which reports back through a pipe. A path
+ * that does not answer within the timeout, such as one on a hung network
+ * mount, has its child killed and is reported as timed out, so that one
+ * bad mount never stalls the others.
+ */
+#define SURVEY_JOBS_MAX 32
+#define SURVEY_TIMEOUT_MS 5000
+
+typedef enum {
+        SURVEY_DONE = 0,    /**< All values were read */
+        SURVEY_FAILED = 1,  /**< pathconf() failed, see err */
+        SURVEY_TIMEOUT = 2, /**< No answer within the timeout */
+} survey_state_t;
+
+/**
+ * What was learned about one path
+ */
+typedef struct survey_result {
+        survey_state_t state;
+        int err;      /**< errno when SURVEY_FAILED */
+        long *values; /**< One per key, as pathconf() returned them */
+} survey_result_t;
+
+/**
+ * Query the @key_cnt pathconf() @keys of each of the @path_cnt @paths,
+ * allowing each path @timeout_ms. Returns false if the results cannot be
+ * allocated; free them with survey_free().
+ */
+extern bool survey_run(char *const *paths, size_t path_cnt, const int *keys, size_t key_cnt,
+                       int timeout_ms, survey_result_t **results);
+
+extern void survey_free(survey_result_t *results, size_t path_cnt);
+
+/**
+ * Return the mount points of /proc/self/mountinfo, in mount order and
+ * without repeats, setting @cnt. Returns NULL if it cannot be read.
+ */
+extern char **survey_mount_points(size_t *cnt);
+
+extern void survey_free_paths(char **paths, size_t cnt);
+
+#endif
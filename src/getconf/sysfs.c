@@ -0,0 +1,263 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "root.h"
+#include "sysfs.h"
+
+#define CACHE_DIR "devices/system/cpu/cpu0/cache"
+#define NODE_DIR "devices/system/node"
+#define HUGEPAGES_DIR "kernel/mm/hugepages"
+#define THP_ENABLED "kernel/mm/transparent_hugepage/enabled"
+#define HUGEPAGE_SIZES_MAX 16
+
+/**
+ * Put the path of @rel under the sysfs root in @buf
+ */
+static const char *sysfs_path(char *buf, size_t len, const char *rel)
+{
+        const char *root = getenv(GETCONF_SYSFS_ROOT_ENV);
+        char rooted[PATH_MAX];
+
+        if (root == NULL || *root == '\0')
+                root = getconf_root_path(GETCONF_SYSFS_ROOT, rooted, sizeof(rooted));
+        snprintf(buf, len, "%s/%s", root, rel);
+        return buf;
+}
+
+/**
+ * Read the first line of @path into @buf, without its newline
+ */
+static bool read_line(const char *path, char *buf, size_t len)
+{
+        FILE *f = fopen(path, "re");
+        bool ok = false;
+
+        if (f == NULL)
+                return false;
+        ok = fgets(buf, (int)len, f) != NULL;
+        fclose(f);
+        if (ok)
+                buf[strcspn(buf, "\n")] = '\0';
+        return ok;
+}
+
+/**
+ * Parse a size such as "32K" or "8M" into bytes, returning -1 if malformed
+ */
+static long parse_size(const char *text)
+{
+        char *end = NULL;
+        long value = strtol(text, &end, 10);
+
+        if (end == text || value < 0)
+                return -1;
+        switch (*end) {
+        case 'K':
+                return value << 10;
+        case 'M':
+                return value << 20;
+        case 'G':
+                return value << 30;
+        case '\0':
+                return value;
+        default:
+                return -1;
+        }
+}
+
+/**
+ * Read @file of the @index-th cache of cpu0 into @buf
+ */
+static bool read_cache_file(int index, const char *file, char *buf, size_t len)
+{
+        char rel[128];
+        char path[PATH_MAX];
+
+        snprintf(rel, sizeof(rel), CACHE_DIR "/index%d/%s", index, file);
+        return read_line(sysfs_path(path, sizeof(path), rel), buf, len);
+}
+
+/**
+ * Look up an attribute of the cache of @level and @kind. Level 1 has
+ * separate instruction and data caches, higher ones usually a unified
+ * cache that answers for data. Caches sysfs does not describe are 0, as
+ * they are with glibc.
+ */
+static long cache_attribute(int level, int kind, int attr)
+{
+        static const char *const attr_files[] = {
+                [GETCONF_SYSFS_SIZE] = "size",
+                [GETCONF_SYSFS_ASSOC] = "ways_of_associativity",
+                [GETCONF_SYSFS_LINESIZE] = "coherency_line_size",
+        };
+        char buf[64];
+
+        if (attr < 0 || attr > GETCONF_SYSFS_LINESIZE)
+                return -1;
+        for (int index = 0; read_cache_file(index, "level", buf, sizeof(buf)); index++) {
+                bool instruction = false;
+
+                if (atoi(buf) != level || !read_cache_file(index, "type", buf, sizeof(buf)))
+                        continue;
+                instruction = strcmp(buf, "Instruction") == 0;
+                if (instruction != (kind == GETCONF_SYSFS_ICACHE))
+                        continue;
+                if (!read_cache_file(index, attr_files[attr], buf, sizeof(buf)))
+                        return 0;
+                return attr == GETCONF_SYSFS_SIZE ? parse_size(buf) : atol(buf);
+        }
+        return 0;
+}
+
+/**
+ * Count the nodeN directories, a machine without any being a single node
+ */
+static long numa_nodes(void)
+{
+        char path[PATH_MAX];
+        struct dirent *ent = NULL;
+        long cnt = 0;
+        DIR *dir = opendir(sysfs_path(path, sizeof(path), NODE_DIR));
+
+        if (dir == NULL)
+                return 1;
+        while ((ent = readdir(dir)) != NULL) {
+                if (strncmp(ent->d_name, "node", 4) == 0 && ent->d_name[4] >= '0' &&
+                    ent->d_name[4] <= '9')
+                        cnt++;
+        }
+        closedir(dir);
+        return cnt > 0 ? cnt : 1;
+}
+
+static int compare_sizes(const void *a, const void *b)
+{
+        unsigned long x = *(const unsigned long *)a;
+        unsigned long y = *(const unsigned long *)b;
+
+        return (x > y) - (x < y);
+}
+
+/**
+ * List the huge page sizes from the hugepages-<size>kB directories
+ */
+static char *hugepage_sizes(void)
+{
+        unsigned long sizes[HUGEPAGE_SIZES_MAX];
+        char path[PATH_MAX];
+        struct dirent *ent = NULL;
+        size_t cnt = 0;
+        char *list = NULL;
+        size_t len = 0;
+        FILE *out = NULL;
+        DIR *dir = opendir(sysfs_path(path, sizeof(path), HUGEPAGES_DIR));
+
+        if (dir == NULL)
+                return NULL;
+        while ((ent = readdir(dir)) != NULL && cnt < HUGEPAGE_SIZES_MAX) {
+                unsigned long kb = 0;
+                char unit[4];
+
+                if (sscanf(ent->d_name, "hugepages-%lu%3s", &kb, unit) == 2 &&
+                    strcmp(unit, "kB") == 0)
+                        sizes[cnt++] = kb << 10;
+        }
+        closedir(dir);
+        if (cnt == 0)
+                return NULL;
+        qsort(sizes, cnt, sizeof(sizes[0]), compare_sizes);
+
+        out = open_memstream(&list, &len);
+        if (out == NULL)
+                abort();
+        for (size_t i = 0; i < cnt; i++)
+                fprintf(out, i == 0 ? "%lu" : " %lu", sizes[i]);
+        if (fclose(out) != 0)
+                abort();
+        return list;
+}
+
+/**
+ * Pick the selected mode out of "always [madvise] never"
+ */
+static char *thp_mode(void)
+{
+        char path[PATH_MAX];
+        char buf[256];
+        char *start = NULL;
+        char *end = NULL;
+
+        if (!read_line(sysfs_path(path, sizeof(path), THP_ENABLED), buf, sizeof(buf)))
+                return NULL;
+        start = strchr(buf, '[');
+        end = start != NULL ? strchr(start, ']') : NULL;
+        if (end == NULL)
+                return NULL;
+        return strndup(start + 1, (size_t)(end - start - 1));
+}
+
+char *getconf_sysfs_value(int key, bool *numeric)
+{
+        char *buffer = NULL;
+        long value = 0;
+
+        *numeric = false;
+        switch (key) {
+        case GETCONF_SYSFS_HUGEPAGE_SIZES:
+                return hugepage_sizes();
+        case GETCONF_SYSFS_THP_MODE:
+                return thp_mode();
+        case GETCONF_SYSFS_NUMA_NODES:
+                value = numa_nodes();
+                break;
+        default:
+                value = cache_attribute(key >> 8, (key >> 4) & 0xf, key & 0xf);
+                break;
+        }
+        *numeric = true;
+        if (asprintf(&buffer, "%ld", value) < 0)
+                abort();
+        return buffer;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
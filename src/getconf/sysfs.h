@@ -0,0 +1,47 @@
+#ifndef GETCONF_SYSFS_H
+#define GETCONF_SYSFS_H
+
+#include <stdbool.h>
+
+/**
+ * Memory topology read from sysfs: the geometry of each cache level, as
+ * glibc offers through its _SC_LEVEL*_CACHE_* extensions, the number of
+ * NUMA nodes, the huge page sizes and the transparent hugepage mode.
+ *
+ * Caches are those of cpu0. sysfs is looked for at GETCONF_SYSFS_ROOT when
+ * set, /sys under the getconf root otherwise, so that a fake tree can
+ * stand in for it.
+ */
+#define GETCONF_SYSFS_ROOT_ENV "GETCONF_SYSFS_ROOT"
+#define GETCONF_SYSFS_ROOT "/sys"
+
+enum {
+        GETCONF_SYSFS_ICACHE = 0, /**< Instruction cache */
+        GETCONF_SYSFS_DCACHE = 1, /**< Data or unified cache */
+};
+
+enum {
+        GETCONF_SYSFS_SIZE = 0,     /**< Size in bytes */
+        GETCONF_SYSFS_ASSOC = 1,    /**< Ways of associativity */
+        GETCONF_SYSFS_LINESIZE = 2, /**< Coherency line size in bytes */
+};
+
+/**
+ * Key of an attribute of the cache of the given level and kind
+ */
+#define GETCONF_SYSFS_CACHE(level, kind, attr) (((level) << 8) | ((kind) << 4) | (attr))
+
+enum {
+        GETCONF_SYSFS_NUMA_NODES = 0x1000,     /**< Number of NUMA nodes */
+        GETCONF_SYSFS_HUGEPAGE_SIZES = 0x1001, /**< Huge page sizes in bytes, ascending */
+        GETCONF_SYSFS_THP_MODE = 0x1002,       /**< Transparent hugepage mode */
+};
+
+/**
+ * Return the value for @key, a GETCONF_SYSFS_CACHE() or one of the other
+ * GETCONF_SYSFS_* keys, as a newly allocated string. Returns NULL if sysfs
+ * has no such value. Numbers are flagged in @numeric.
+ */
+extern char *getconf_sysfs_value(int key, bool *numeric);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "getent.h"
+#include "probes.h"
+#include "stats.h"
+
+#if HAVE_USDT
+const char *probe_database = NULL;
+#endif
+
+int chain_get(const getent_chain_t *chain, const char **keys, int key_cnt)
+{
+        getent_chain_t next;
+        int res = RES_OK;
+
+        if (chain == NULL || chain->cnt == 0)
+                return RES_KEY_NOT_FOUND;
+
+        next.database = chain->database;
+        next.backends = chain->backends + 1;
+        next.cnt = chain->cnt - 1;
+        stats.backend = chain->backends[0]->name;
+        GETENT_PROBE_DISPATCH(chain);
+        GETENT_PROBE_LOOKUP_START(chain, keys, key_cnt);
+        res = chain->backends[0]->get(keys, key_cnt, &next);
+        GETENT_PROBE_LOOKUP_DONE(chain, keys, key_cnt, res);
+        return res;
+}
+
+int chain_enum(const getent_chain_t *chain)
+{
+        for (size_t i = 0; i < chain->cnt; i++) {
+                if (chain->backends[i]->enum_all != NULL) {
+                        stats.backend = chain->backends[i]->name;
+                        GETENT_PROBE_DISPATCH(chain);
+                        return chain->backends[i]->enum_all();
+                }
+        }
+        return no_enum(chain->database);
+}
+
+const getent_backend_t *database_backend(const getconf_database_config_t *db, const char *name)
+{
+        for (const getent_backend_t *const *b = db->backends; *b != NULL; b++)
+                if (strcmp((*b)->name, name) == 0)
+                        return *b;
+        return NULL;
+}
+
+void chain_build(const getconf_database_config_t *db, const char *spec,
+                 const getent_backend_t **backends, size_t max, getent_chain_t *chain)
+{
+        const char *name = spec;
+
+        chain->database = db->name;
+        chain->backends = backends;
+        chain->cnt = 0;
+
+        while (*name != '\0') {
+                size_t len = strcspn(name, ", ");
+                const getent_backend_t *const *b = db->backends;
+
+                for (; *b != NULL; b++)
+                        if (strlen((*b)->name) == len && strncmp((*b)->name, name, len) == 0)
+                                break;
+                if (len > 0 && *b == NULL)
+                        err("Service %.*s is not available for %s\n", (int)len, name, db->name);
+                if (len > 0 && chain->cnt == max)
+                        err("Too many services for %s\n", db->name);
+                if (len > 0)
+                        backends[chain->cnt++] = *b;
+
+                name += len;
+                name += strspn(name, ", ");
+        }
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,182 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "output.h"
+#include "stats.h"
+
+/**
+ * Connection to getentd, opened on first use. -1 once we know the daemon
+ * is not there.
+ */
+static int cache_fd = -2;
+
+bool cache_read_full(int fd, void *buf, size_t len)
+{
+        char *p = buf;
+
+        while (len > 0) {
+                ssize_t r = read(fd, p, len);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return false;
+                p += r;
+                len -= (size_t)r;
+        }
+        return true;
+}
+
+bool cache_write_full(int fd, const void *buf, size_t len)
+{
+        const char *p = buf;
+
+        while (len > 0) {
+                ssize_t r = send(fd, p, len, MSG_NOSIGNAL);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return false;
+                p += r;
+                len -= (size_t)r;
+        }
+        return true;
+}
+
+int cache_connect(const char *path)
+{
+        struct sockaddr_un addr;
+        int fd = -1;
+
+        if (path == NULL)
+                path = getenv(GETENTD_SOCKET_ENV);
+        if (path == NULL || *path == '\0')
+                path = GETENTD_SOCKET;
+        if (strlen(path) >= sizeof(addr.sun_path))
+                return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return -1;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+bool cache_get(int fd, const char *db, const char *key, int *status)
+{
+        getentd_request_t req = {
+                .magic = GETENTD_MAGIC,
+                .db_len = (uint16_t)strlen(db),
+                .key_len = (uint16_t)strlen(key),
+        };
+        getentd_response_t resp;
+        char buf[4096];
+
+        if (strlen(key) > UINT16_MAX)
+                return false;
+        if (!cache_write_full(fd, &req, sizeof(req)) || !cache_write_full(fd, db, req.db_len) ||
+            !cache_write_full(fd, key, req.key_len))
+                return false;
+        if (!cache_read_full(fd, &resp, sizeof(resp)) || resp.status == GETENTD_UNCACHED)
+                return false;
+        stats_read(1, sizeof(resp) + resp.len);
+
+        /* Output may be larger than what we hold, pass it on as it comes */
+        while (resp.len > 0) {
+                size_t chunk = resp.len < sizeof(buf) ? resp.len : sizeof(buf);
+
+                if (!cache_read_full(fd, buf, chunk))
+                        err("Lost connection to getentd\n");
+                out_write(buf, chunk);
+                resp.len -= (uint32_t)chunk;
+        }
+        *status = resp.status;
+        return true;
+}
+
+
+/**
+ * Ask getentd first. Keys it cannot answer, and every key once the daemon
+ * turns out to be missing, go to the next backends.
+ */
+static int get_cache(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        int res = RES_OK;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (cache_fd == -2)
+                cache_fd = cache_connect(NULL);
+
+        for (int i = 0; i < key_cnt; i++) {
+                int status = RES_OK;
+
+                if (cache_fd >= 0 && cache_get(cache_fd, next->database, keys[i], &status)) {
+                        if (status != RES_OK)
+                                res = status;
+                        continue;
+                }
+
+                /* The daemon went away or does not keep this database */
+                if (cache_fd >= 0)
+                        close(cache_fd);
+                cache_fd = -1;
+                return chain_get(next, keys + i, key_cnt - i);
+        }
+        return res;
+}
+
+const getent_backend_t cache_backend = {
+        .name = "cache", .get = get_cache, .enum_all = NULL, .system_only = true
+};
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
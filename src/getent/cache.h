@@ -0,0 +1,68 @@
+#ifndef GETENT_CACHE_H
+#define GETENT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "getent.h"
+
+#ifndef GETENTD_SOCKET
+#define GETENTD_SOCKET "/run/getentd.socket"
+#endif
+
+/**
+ * Environment variable overriding the socket path used by the client
+ */
+#define GETENTD_SOCKET_ENV "GETENTD_SOCKET"
+
+/**
+ * Protocol spoken over the getentd socket. A client sends any number of
+ * requests over one connection and reads the response to each before
+ * sending the next one:
+ *
+ *      request:  getentd_request_t, database name, key
+ *      response: getentd_response_t, output exactly as getent prints it
+ *
+ * Strings are not NUL terminated, all integers are in host byte order as
+ * the socket never leaves the machine.
+ */
+#define GETENTD_MAGIC 0x47454431U /* GED1 */
+
+typedef struct getentd_request {
+        uint32_t magic;   /**< GETENTD_MAGIC */
+        uint16_t db_len;  /**< Length of the database name */
+        uint16_t key_len; /**< Length of the key */
+} getentd_request_t;
+
+/**
+ * The daemon does not cache the requested database, look it up directly.
+ * Databases are cached when they list the cache backend.
+ */
+#define GETENTD_UNCACHED (-1)
+
+typedef struct getentd_response {
+        int32_t status; /**< RES_* result of the lookup, or GETENTD_UNCACHED */
+        uint32_t len;   /**< Length of the output that follows */
+} getentd_response_t;
+
+/**
+ * Connect to the daemon listening on @path, or the default socket when
+ * NULL. Returns -1 when no daemon is around.
+ */
+extern int cache_connect(const char *path);
+
+/**
+ * Ask the daemon behind @fd for @key in @db. On success the output is
+ * written to stdout, the lookup result is stored in @status and true is
+ * returned. False means the caller must look the key up itself.
+ */
+extern bool cache_get(int fd, const char *db, const char *key, int *status);
+
+/**
+ * Read or write exactly @len bytes, retrying on short transfers
+ */
+extern bool cache_read_full(int fd, void *buf, size_t len);
+extern bool cache_write_full(int fd, const void *buf, size_t len);
+
+#endif
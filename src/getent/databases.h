@@ -4,8 +4,8 @@
 #include "getent.h"
 
 #define DB(X)                                                                                      \
-        extern int get_##X(const char **keys, int key_cnt);                                        \
-        extern int enum_##X##_all(void);
+        extern const getent_backend_t *const X##_backends[];                                       \
+        extern const char X##_defaults[];
 #include "getent.inc"
 #undef DB
 
@@ -25,7 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
-#include <stdio.h>
+#include "output.h"
+#include "probes.h"
 
 #if HAVE_ALIASES
 #include <aliases.h>
@@ -37,17 +38,23 @@ static void print_aliasent_info(struct aliasent *ent)
         size_t i;
         int cnt = 0;
 
-        cnt += printf("%s: ", ent->alias_name);
-        print_align_to(cnt, alias_align_to);
+        GETENT_PROBE_RECORD_STR(ent->alias_name);
+        cnt += out_str(ent->alias_name);
+        cnt += out_write(": ", 2);
+        out_pad(cnt, alias_align_to);
         for (i = 0; i < ent->alias_members_len; i++) {
-                printf(" %s", ent->alias_members[i]);
+                out_char(' ');
+                out_str(ent->alias_members[i]);
         }
-        printf("\n");
+        out_char('\n');
 }
 
 GET_SIMPLE(aliases, getaliasbyname, aliasent)
 ENUM_ALL(aliases, aliasent, , aliasent)
 
+LIBC_BACKEND(aliases);
+DATABASE_BACKENDS(aliases, "libc", &aliases_libc_backend);
+
 #endif
 
 /*
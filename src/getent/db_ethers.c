@@ -25,12 +25,14 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <netdb.h>
 #include <netinet/ether.h>
 #include <string.h>
 
-int get_ethers(const char **keys, int key_cnt)
+int get_ethers(const char **keys, int key_cnt, __attribute__((unused)) const getent_chain_t *next)
 {
         struct ether_addr *addr = NULL;
         struct ether_addr addr_dst;
@@ -46,20 +48,24 @@ int get_ethers(const char **keys, int key_cnt)
                         char *addr_str = ether_ntoa(addr);
                         if (addr_str == NULL)
                                 return RES_KEY_NOT_FOUND;
-                        printf("%s ", addr_str);
+                        out_str(addr_str);
+                        out_char(' ');
                 } else {
                         memset(&addr_dst, 0, sizeof(struct ether_addr));
                         res = ether_hostton(*keys, &addr_dst);
 
                         if (res != 0)
                                 return RES_KEY_NOT_FOUND;
-                        printf("%s ", ether_ntoa(&addr_dst));
+                        out_str(ether_ntoa(&addr_dst));
+                        out_char(' ');
                         addr = &addr_dst;
                 }
                 res = ether_ntohost(hostname, addr);
                 if (res != 0)
                         return RES_KEY_NOT_FOUND;
-                printf("%s\n", hostname);
+                GETENT_PROBE_RECORD_STR(hostname);
+                out_str(hostname);
+                out_char('\n');
         }
 
         return RES_OK;
@@ -67,6 +73,9 @@ int get_ethers(const char **keys, int key_cnt)
 
 NO_ENUM_ALL_FOR(ethers)
 
+LIBC_BACKEND(ethers);
+DATABASE_BACKENDS(ethers, "libc", &ethers_libc_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
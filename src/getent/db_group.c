@@ -24,27 +24,152 @@
 
 #define _GNU_SOURCE
 
+#include "dbfile.h"
+#include "files.h"
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <grp.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void print_group_info(struct group *grp)
 {
         char **memb = NULL;
         int first = 1;
 
-        printf("%s:%s:%u:", grp->gr_name, grp->gr_passwd, grp->gr_gid);
+        GETENT_PROBE_RECORD_STR(grp->gr_name);
+        out_str(grp->gr_name);
+        out_char(':');
+        out_str(grp->gr_passwd);
+        out_char(':');
+        out_uint(grp->gr_gid);
+        out_char(':');
         for (memb = grp->gr_mem; *memb != NULL; memb++) {
-                printf("%s%s", first == 0 ? "," : "", *memb);
+                if (first == 0)
+                        out_char(',');
+                out_str(*memb);
                 first = 0;
         }
-        printf("\n");
+        out_char('\n');
+}
+
+static void print_group_view(const group_view_t *grp)
+{
+        const char *memb = grp->members.data;
+        const char *end = memb + grp->members.len;
+        int first = 1;
+
+        GETENT_PROBE_RECORD(grp->name.data, grp->name.len);
+        out_write(grp->name.data, (size_t)grp->name.len);
+        out_char(':');
+        out_write(grp->passwd.data, (size_t)grp->passwd.len);
+        out_char(':');
+        out_uint(grp->gid);
+        out_char(':');
+        while (memb < end) {
+                const char *sep = memchr(memb, grp->member_sep, (size_t)(end - memb));
+                int len = (int)((sep != NULL ? sep : end) - memb);
+
+                if (len > 0) {
+                        if (first == 0)
+                                out_char(',');
+                        out_write(memb, (size_t)len);
+                        first = 0;
+                }
+                memb += len + 1;
+        }
+        out_char('\n');
+}
+
+static void emit_group_record(const char *record, size_t len)
+{
+        group_view_t grp;
+
+        if (files_parse_group(record, len, &grp))
+                print_group_view(&grp);
+}
+
+static const files_database_t group_files = {
+        .path = "/etc/group",
+        .fields = 4,
+        .id_field = 2,
+        .emit = emit_group_record,
+};
+
+static int get_group_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return files_get(&group_files, keys, key_cnt, next);
+}
+
+static int enum_group_files_all(void)
+{
+        return files_enum(&group_files);
 }
 
 GET_NUMERIC_CAST(group, getgrnam, getgrgid, group, gid_t)
 ENUM_ALL(group, grent, , group)
 
+static void print_group_record(const dbrecord_t *rec)
+{
+        group_view_t grp;
+
+        dbfile_group_view(rec, &grp);
+        print_group_view(&grp);
+}
+
+static int get_group_db(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        dbfile_t db;
+        dbrecord_t rec;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (!dbfile_open_database(&db, "group"))
+                return chain_get(next, keys, key_cnt);
+
+        for (; key_cnt-- > 0; keys++) {
+                bool found = false;
+
+                if (is_numeric(*keys) == 1)
+                        found = dbfile_find_id(&db, strtoul(*keys, NULL, 10), &rec);
+                else
+                        found = dbfile_find_name(&db, *keys, &rec);
+                if (found)
+                        print_group_record(&rec);
+                else
+                        chain_get(next, keys, 1);
+        }
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+static int enum_group_db_all(void)
+{
+        dbfile_t db;
+        dbrecord_t rec = { .next = NULL };
+
+        if (!dbfile_open_database(&db, "group"))
+                return RES_KEY_NOT_FOUND;
+        while (dbfile_next(&db, &rec))
+                print_group_record(&rec);
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+BACKEND(group, files);
+LIBC_BACKEND(group);
+BACKEND(group, db);
+DATABASE_BACKENDS(group,
+                  "files,libc",
+                  &group_files_backend,
+                  &group_libc_backend,
+                  &group_db_backend,
+                  &cache_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
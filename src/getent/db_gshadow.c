@@ -25,6 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #if HAVE_GSHADOW
 #include <gshadow.h>
@@ -34,22 +36,33 @@ static void print_sgrp_info(struct sgrp *pwd)
         char **memb = NULL;
         int first = 1;
 
-        printf("%s:%s:", pwd->sg_namp, pwd->sg_passwd);
+        GETENT_PROBE_RECORD_STR(pwd->sg_namp);
+        out_str(pwd->sg_namp);
+        out_char(':');
+        out_str(pwd->sg_passwd);
+        out_char(':');
         for (first = 1, memb = pwd->sg_adm; *memb != NULL; memb++) {
-                printf("%s%s", first == 0 ? "," : "", *memb);
+                if (first == 0)
+                        out_char(',');
+                out_str(*memb);
                 first = 0;
         }
-        printf(":");
+        out_char(':');
         for (first = 1, memb = pwd->sg_mem; *memb != NULL; memb++) {
-                printf("%s%s", first == 0 ? "," : "", *memb);
+                if (first == 0)
+                        out_char(',');
+                out_str(*memb);
                 first = 0;
         }
-        printf("\n");
+        out_char('\n');
 }
 
 GET_SIMPLE(gshadow, getsgnam, sgrp)
 ENUM_ALL(gshadow, sgent, , sgrp)
 
+LIBC_BACKEND(gshadow);
+DATABASE_BACKENDS(gshadow, "libc", &gshadow_libc_backend);
+
 #endif
 
 /*
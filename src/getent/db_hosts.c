@@ -25,13 +25,20 @@
 #define _GNU_SOURCE
 
 #include <arpa/inet.h>
+#include <limits.h>
 #include <netdb.h>
-#include <stdio.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "dns.h"
 #include "getent.h"
+#include "hostsfile.h"
+#include "output.h"
+#include "probes.h"
 
 enum { HOSTS_HOST,
        HOSTS_AHOST,
@@ -49,65 +56,216 @@ static const char *socktypes[] = {
 static const size_t socktype_size = sizeof(socktypes) / sizeof(const char *);
 static const int addr_align_to = 16;
 
+#define HOSTS_FILE "/etc/hosts"
+
+unsigned int resolve_jobs = 1;
+int host_names = HOST_NAMES_PTR;
+
+typedef struct name_entry {
+        dns_addr_t addr;
+        bool used;
+        char *name; /**< NULL while the lookup is still running */
+} name_entry_t;
+
+/**
+ * Names found for addresses with --names=cached, kept for the whole run
+ * and shared by the resolver threads
+ */
+static struct {
+        name_entry_t *entries;
+        size_t size; /**< Power of two */
+        size_t cnt;
+        pthread_mutex_t lock;
+        pthread_cond_t ready;
+} names = { .lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER };
+
+/**
+ * Name of an entry whose name could not be stored
+ */
+static char name_lost[] = "";
+
+static size_t name_hash(const dns_addr_t *addr)
+{
+        size_t hash = 2166136261U ^ (size_t)addr->family;
+
+        for (size_t i = 0; i < sizeof(addr->addr); i++)
+                hash = (hash ^ addr->addr[i]) * 16777619U;
+        return hash;
+}
+
+static name_entry_t *name_probe(name_entry_t *entries, size_t size, const dns_addr_t *addr)
+{
+        size_t slot = name_hash(addr) & (size - 1);
+
+        while (entries[slot].used && (entries[slot].addr.family != addr->family ||
+                                      memcmp(entries[slot].addr.addr, addr->addr, 16) != 0))
+                slot = (slot + 1) & (size - 1);
+        return &entries[slot];
+}
+
+/**
+ * Find the entry for @addr, or the free slot it belongs in. Called with
+ * the lock held. Returns NULL when the table is full and cannot grow.
+ *
+ * The resolver threads get here, and err() would exit the shell running
+ * the bash builtins from one of them, with the lock held at that. Being
+ * out of memory costs the cache instead: lookups go on without it.
+ */
+static name_entry_t *name_find(const dns_addr_t *addr)
+{
+        if ((names.cnt + 1) * 2 > names.size) {
+                size_t size = names.size == 0 ? 64 : names.size * 2;
+                name_entry_t *entries = calloc(size, sizeof(name_entry_t));
+
+                if (entries == NULL && names.cnt + 1 >= names.size)
+                        return NULL;
+                if (entries == NULL)
+                        return name_probe(names.entries, names.size, addr);
+                for (size_t i = 0; i < names.size; i++)
+                        if (names.entries[i].used)
+                                *name_probe(entries, size, &names.entries[i].addr) =
+                                    names.entries[i];
+                free(names.entries);
+                names.entries = entries;
+                names.size = size;
+        }
+        return name_probe(names.entries, names.size, addr);
+}
+
+/**
+ * Claim @addr for a lookup. Returns false if it is known or being looked
+ * up already.
+ */
+static bool name_claim(const dns_addr_t *addr)
+{
+        name_entry_t *entry = NULL;
+        bool claimed = true;
+
+        pthread_mutex_lock(&names.lock);
+        entry = name_find(addr);
+        if (entry != NULL && entry->used) {
+                claimed = false;
+        } else if (entry != NULL) {
+                entry->used = true;
+                entry->addr = *addr;
+                entry->name = NULL;
+                names.cnt++;
+        }
+        pthread_mutex_unlock(&names.lock);
+        return claimed;
+}
+
+static void name_set(const dns_addr_t *addr, const char *name)
+{
+        name_entry_t *entry = NULL;
+
+        pthread_mutex_lock(&names.lock);
+        entry = name_find(addr);
+        if (entry != NULL && entry->used && entry->name == NULL) {
+                entry->name = strdup(name);
+                if (entry->name == NULL)
+                        entry->name = name_lost;
+        }
+        pthread_cond_broadcast(&names.ready);
+        pthread_mutex_unlock(&names.lock);
+}
+
+/**
+ * Copy the name of @addr to @host, waiting for a lookup still running
+ * elsewhere. Returns false if nobody claimed it, or its name was lost.
+ */
+static bool name_get(const dns_addr_t *addr, char *host, size_t len)
+{
+        name_entry_t *entry = NULL;
+        bool found = false;
+
+        pthread_mutex_lock(&names.lock);
+        for (;;) {
+                entry = name_find(addr);
+                if (entry == NULL || !entry->used || entry->name != NULL)
+                        break;
+                pthread_cond_wait(&names.ready, &names.lock);
+        }
+        if (entry != NULL && entry->used && entry->name != name_lost) {
+                snprintf(host, len, "%s", entry->name);
+                found = true;
+        }
+        pthread_mutex_unlock(&names.lock);
+        return found;
+}
+
+static void sockaddr_key(const struct sockaddr *sa, dns_addr_t *addr)
+{
+        memset(addr, 0, sizeof(dns_addr_t));
+        addr->family = sa->sa_family;
+        if (sa->sa_family == AF_INET)
+                memcpy(addr->addr, &((const struct sockaddr_in *)sa)->sin_addr, 4);
+        else if (sa->sa_family == AF_INET6)
+                memcpy(addr->addr, &((const struct sockaddr_in6 *)sa)->sin6_addr, 16);
+}
+
 void print_hostent_info(struct hostent *ent)
 {
         char **aliases = ent->h_aliases;
         char dst[DST_LEN];
         int cnt = 0;
 
+        GETENT_PROBE_RECORD_STR(ent->h_name);
         inet_ntop(ent->h_addrtype, ent->h_addr_list[0], (char *)dst, DST_LEN);
-        cnt = printf("%s", dst);
-        print_align_to(cnt, addr_align_to);
-        printf(" %s", ent->h_name);
+        cnt = out_str(dst);
+        out_pad(cnt, addr_align_to);
+        out_char(' ');
+        out_str(ent->h_name);
         while (aliases != NULL && *aliases != NULL) {
-                printf(" %s", *aliases);
+                out_char(' ');
+                out_str(*aliases);
                 aliases++;
         }
-        printf("\n");
+        out_char('\n');
 }
 
-static void print_sockaddr(struct sockaddr *addr, int family, int sock_type, int print_host)
+/**
+ * Outcome of resolving one key. Resolution and printing are kept apart so
+ * that keys can be resolved concurrently and still be printed in order.
+ */
+typedef struct host_result {
+        struct addrinfo *info; /**< Addresses found, NULL on failure */
+        char host[NI_MAXHOST]; /**< Name of the first address */
+        bool done;             /**< Set once the worker is through with it */
+} host_result_t;
+
+static void print_sockaddr(struct sockaddr *addr, int family, int sock_type, const char *host)
 {
-        char dst[DST_LEN];
-        char host[NI_MAXHOST];
+        char dst[DST_LEN] = { 0 };
         int cnt = 0;
 
+        GETENT_PROBE_RECORD_STR(host);
         if (family == AF_INET) {
                 struct sockaddr_in *sin = (struct sockaddr_in *)addr;
-                cnt +=
-                    printf("%s ",
-                           inet_ntop(AF_INET, (const void *)&sin->sin_addr, (char *)dst, DST_LEN));
+                inet_ntop(AF_INET, (const void *)&sin->sin_addr, (char *)dst, DST_LEN);
         } else {
                 struct sockaddr_in6 *sin = (struct sockaddr_in6 *)addr;
-                cnt += printf("%s ",
-                              inet_ntop(AF_INET6,
-                                        (const void *)&sin->sin6_addr,
-                                        (char *)dst,
-                                        DST_LEN));
+                inet_ntop(AF_INET6, (const void *)&sin->sin6_addr, (char *)dst, DST_LEN);
         }
-        print_align_to(cnt, addr_align_to);
+        cnt += out_str(dst);
+        cnt += out_char(' ');
+        out_pad(cnt, addr_align_to);
         if (sock_type > 0 && (size_t)sock_type < socktype_size)
-                printf("%s", socktypes[sock_type]);
-        if (print_host == 0) {
-                printf("\n");
+                out_str(socktypes[sock_type]);
+        if (host == NULL) {
+                out_char('\n');
                 return;
         }
-        (void)getnameinfo(addr,
-                          family == AF_INET ? sizeof(struct sockaddr_in)
-                                            : sizeof(struct sockaddr_in6),
-                          host,
-                          NI_MAXHOST,
-                          NULL,
-                          0,
-                          0);
-        host[NI_MAXHOST - 1] = 0;
-        printf(" %s\n", host);
+        out_char(' ');
+        out_str(host);
+        out_char('\n');
 }
 
-static void print_single_host_info(const char *key, int host_type)
+static void resolve_host(const char *key, int host_type, host_result_t *result)
 {
-        struct addrinfo *info = NULL;
         struct addrinfo hints;
+        struct addrinfo *info = NULL;
+        dns_addr_t addr;
         int res = 0;
 
         memset(&hints, 0, sizeof(struct addrinfo));
@@ -117,54 +275,553 @@ static void print_single_host_info(const char *key, int host_type)
         } else if (host_type == HOSTS_AHOST_V4) {
                 hints.ai_family = AF_INET;
         }
+        if (host_names == HOST_NAMES_CANON)
+                hints.ai_flags |= AI_CANONNAME;
+        result->info = NULL;
+        result->host[0] = '\0';
         res = getaddrinfo(key, NULL, &hints, &info);
         if (res != 0 || info == NULL)
                 return;
+        result->info = info;
+
+        if (host_names == HOST_NAMES_CANON) {
+                snprintf(result->host,
+                         NI_MAXHOST,
+                         "%s",
+                         info->ai_canonname != NULL ? info->ai_canonname : key);
+                return;
+        }
+
+        sockaddr_key(info->ai_addr, &addr);
+        if (host_names == HOST_NAMES_CACHED && !name_claim(&addr) &&
+            name_get(&addr, result->host, NI_MAXHOST))
+                return;
+        (void)getnameinfo(info->ai_addr, info->ai_addrlen, result->host, NI_MAXHOST, NULL, 0, 0);
+        result->host[NI_MAXHOST - 1] = 0;
+        if (host_names == HOST_NAMES_CACHED)
+                name_set(&addr, result->host);
+}
+
+static bool print_host_result(host_result_t *result, int host_type)
+{
+        struct addrinfo *info = result->info;
+
+        if (info == NULL)
+                return false;
 
         if (host_type == HOSTS_AHOST || host_type == HOSTS_AHOST_V4 ||
             host_type == HOSTS_AHOST_V6) {
                 struct addrinfo *tmp = NULL;
-                int print_host = 1;
+                const char *host = result->host;
 
                 for (tmp = info; tmp != NULL; tmp = tmp->ai_next) {
-                        print_sockaddr(tmp->ai_addr, tmp->ai_family, tmp->ai_socktype, print_host);
-                        print_host = 0;
+                        print_sockaddr(tmp->ai_addr, tmp->ai_family, tmp->ai_socktype, host);
+                        host = NULL;
                 }
         } else
-                print_sockaddr(info->ai_addr, info->ai_family, 0, 1);
+                print_sockaddr(info->ai_addr, info->ai_family, 0, result->host);
 
         freeaddrinfo(info);
+        result->info = NULL;
+        return true;
+}
+
+/**
+ * Keys shared between the resolver threads. Workers claim the next key in
+ * line, the main thread prints results as soon as the one it waits for is
+ * done.
+ */
+typedef struct host_pool {
+        const char **keys;
+        int key_cnt;
+        int host_type;
+        host_result_t *results;
+        int next_key; /**< Next key to be claimed by a worker */
+        pthread_mutex_t lock;
+        pthread_cond_t done;
+} host_pool_t;
+
+static void *host_worker(void *arg)
+{
+        host_pool_t *pool = arg;
+
+        for (;;) {
+                int i = 0;
+
+                pthread_mutex_lock(&pool->lock);
+                i = pool->next_key++;
+                pthread_mutex_unlock(&pool->lock);
+                if (i >= pool->key_cnt)
+                        break;
+
+                resolve_host(pool->keys[i], pool->host_type, &pool->results[i]);
+
+                pthread_mutex_lock(&pool->lock);
+                pool->results[i].done = true;
+                pthread_cond_broadcast(&pool->done);
+                pthread_mutex_unlock(&pool->lock);
+        }
+        return NULL;
 }
 
-static int _get_hosts(const char **keys, int key_cnt, int host_type)
+static int get_hosts_concurrent(const char **keys, int key_cnt, const getent_chain_t *next,
+                                int host_type)
 {
+        host_pool_t pool = {
+                .keys = keys,
+                .key_cnt = key_cnt,
+                .host_type = host_type,
+                .next_key = 0,
+        };
+        unsigned int worker_cnt = resolve_jobs < (unsigned int)key_cnt ? resolve_jobs
+                                                                          : (unsigned int)key_cnt;
+        pthread_t *workers = NULL;
+        unsigned int started = 0;
+
+        pool.results = calloc((size_t)key_cnt, sizeof(host_result_t));
+        workers = calloc(worker_cnt, sizeof(pthread_t));
+        if (pool.results == NULL || workers == NULL)
+                err("Out of memory\n");
+        pthread_mutex_init(&pool.lock, NULL);
+        pthread_cond_init(&pool.done, NULL);
+
+        for (; started < worker_cnt; started++)
+                if (pthread_create(&workers[started], NULL, host_worker, &pool) != 0)
+                        break;
+        /* Without any worker, resolve everything here */
+        if (started == 0)
+                host_worker(&pool);
+
+        for (int i = 0; i < key_cnt; i++) {
+                pthread_mutex_lock(&pool.lock);
+                while (!pool.results[i].done)
+                        pthread_cond_wait(&pool.done, &pool.lock);
+                pthread_mutex_unlock(&pool.lock);
+
+                if (!print_host_result(&pool.results[i], host_type))
+                        chain_get(next, &keys[i], 1);
+        }
+
+        for (unsigned int i = 0; i < started; i++)
+                pthread_join(workers[i], NULL);
+        pthread_cond_destroy(&pool.done);
+        pthread_mutex_destroy(&pool.lock);
+        free(workers);
+        free(pool.results);
+
+        return RES_OK;
+}
+
+static int _get_hosts(const char **keys, int key_cnt, const getent_chain_t *next, int host_type)
+{
+        host_result_t result;
+
         if (keys == NULL)
                 return RES_KEY_NOT_FOUND;
+        if (resolve_jobs > 1 && key_cnt > 1)
+                return get_hosts_concurrent(keys, key_cnt, next, host_type);
 
-        for (; key_cnt-- > 0; keys++)
-                print_single_host_info(*keys, host_type);
+        for (; key_cnt-- > 0; keys++) {
+                resolve_host(*keys, host_type, &result);
+                if (!print_host_result(&result, host_type))
+                        chain_get(next, keys, 1);
+        }
 
         return RES_OK;
 }
 
-int get_hosts(const char **keys, int key_cnt)
+/**
+ * Turn an answer of the stub resolver into what getaddrinfo would have
+ * handed us. IPv4 addresses are mapped when @map_v4 is set.
+ */
+static socklen_t dns_sockaddr(const dns_addr_t *addr, bool map_v4, struct sockaddr_storage *ss)
 {
-        return _get_hosts(keys, key_cnt, HOSTS_HOST);
+        memset(ss, 0, sizeof(struct sockaddr_storage));
+        if (addr->family == AF_INET && !map_v4) {
+                struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+
+                sin->sin_family = AF_INET;
+                memcpy(&sin->sin_addr, addr->addr, 4);
+                return sizeof(struct sockaddr_in);
+        }
+
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+
+        sin6->sin6_family = AF_INET6;
+        if (addr->family == AF_INET) {
+                sin6->sin6_addr.s6_addr[10] = 0xff;
+                sin6->sin6_addr.s6_addr[11] = 0xff;
+                memcpy(&sin6->sin6_addr.s6_addr[12], addr->addr, 4);
+        } else
+                memcpy(&sin6->sin6_addr, addr->addr, 16);
+        return sizeof(struct sockaddr_in6);
 }
 
-int get_ahosts(const char **keys, int key_cnt)
+/**
+ * Print a name resolved by the stub resolver, IPv6 addresses first as
+ * getaddrinfo orders them on a dual stack host. Every address is listed
+ * once per socket type, as getaddrinfo does without hints.
+ */
+static void print_dns_result(const dns_result_t *result, int host_type)
 {
-        return _get_hosts(keys, key_cnt, HOSTS_AHOST);
+        static const int families[] = { AF_INET6, AF_INET };
+        static const int sock_types[] = { SOCK_STREAM, SOCK_DGRAM, SOCK_RAW };
+        const char *host = result->canon;
+        bool map_v4 = host_type == HOSTS_AHOST_V6;
+
+        for (size_t i = 0; map_v4 && i < result->addr_cnt; i++)
+                if (result->addrs[i].family == AF_INET6)
+                        map_v4 = false;
+
+        for (size_t f = 0; f < sizeof(families) / sizeof(families[0]); f++) {
+                for (size_t i = 0; i < result->addr_cnt; i++) {
+                        struct sockaddr_storage ss;
+
+                        if (result->addrs[i].family != families[f])
+                                continue;
+                        if (host_type == HOSTS_AHOST_V6 && families[f] == AF_INET && !map_v4)
+                                continue;
+                        dns_sockaddr(&result->addrs[i], map_v4, &ss);
+
+                        if (host_type == HOSTS_HOST) {
+                                print_sockaddr((struct sockaddr *)&ss, ss.ss_family, 0, host);
+                                return;
+                        }
+                        for (size_t t = 0; t < sizeof(sock_types) / sizeof(sock_types[0]); t++) {
+                                print_sockaddr((struct sockaddr *)&ss,
+                                               ss.ss_family,
+                                               sock_types[t],
+                                               host);
+                                host = NULL;
+                        }
+                }
+        }
 }
 
-int get_ahostsv4(const char **keys, int key_cnt)
+/**
+ * The address print_dns_result lists first
+ */
+static const dns_addr_t *first_dns_address(const dns_result_t *result)
 {
-        return _get_hosts(keys, key_cnt, HOSTS_AHOST_V4);
+        for (size_t i = 0; i < result->addr_cnt; i++)
+                if (result->addrs[i].family == AF_INET6)
+                        return &result->addrs[i];
+        return result->addr_cnt > 0 ? &result->addrs[0] : NULL;
 }
 
-int get_ahostsv6(const char **keys, int key_cnt)
+/**
+ * Name @results after the PTR record of their first address. All PTR
+ * queries of a lookup go out together, and no address is asked for twice
+ * in a run. Addresses without a PTR record are named by their numeric form,
+ * like getnameinfo does.
+ */
+static void dns_reverse_names(const dns_conf_t *conf, dns_result_t *results, int cnt)
 {
-        return _get_hosts(keys, key_cnt, HOSTS_AHOST_V6);
+        char(*reverse)[DNS_NAME_MAX + 1] = calloc((size_t)cnt, DNS_NAME_MAX + 1);
+        const char **reverse_keys = calloc((size_t)cnt, sizeof(char *));
+        const dns_addr_t **addrs = calloc((size_t)cnt, sizeof(dns_addr_t *));
+        dns_result_t *ptrs = calloc((size_t)cnt, sizeof(dns_result_t));
+        int ptr_cnt = 0;
+
+        if (reverse == NULL || reverse_keys == NULL || addrs == NULL || ptrs == NULL)
+                err("Out of memory\n");
+
+        for (int i = 0; i < cnt; i++) {
+                const dns_addr_t *addr = results[i].found ? first_dns_address(&results[i]) : NULL;
+
+                if (addr == NULL || !name_claim(addr))
+                        continue;
+                dns_reverse_name(addr, reverse[ptr_cnt]);
+                reverse_keys[ptr_cnt] = reverse[ptr_cnt];
+                addrs[ptr_cnt++] = addr;
+        }
+        if (ptr_cnt > 0)
+                dns_resolve(conf, reverse_keys, ptr_cnt, DNS_WANT_PTR, ptrs);
+
+        for (int i = 0; i < ptr_cnt; i++) {
+                char numeric[INET6_ADDRSTRLEN];
+
+                if (ptrs[i].found) {
+                        name_set(addrs[i], ptrs[i].canon);
+                        continue;
+                }
+                inet_ntop(addrs[i]->family, addrs[i]->addr, numeric, sizeof(numeric));
+                name_set(addrs[i], numeric);
+        }
+        for (int i = 0; i < cnt; i++) {
+                const dns_addr_t *addr = results[i].found ? first_dns_address(&results[i]) : NULL;
+
+                if (addr != NULL)
+                        name_get(addr, results[i].canon, sizeof(results[i].canon));
+        }
+
+        dns_results_free(ptrs, ptr_cnt);
+        free(ptrs);
+        free(addrs);
+        free(reverse_keys);
+        free(reverse);
+}
+
+/**
+ * Resolve all keys at once with the built-in stub resolver
+ */
+static int _get_hosts_dns(const char **keys, int key_cnt, const getent_chain_t *next,
+                          int host_type)
+{
+        char resolv_conf[PATH_MAX];
+        dns_conf_t conf;
+        dns_result_t *results = NULL;
+        int want = DNS_WANT_A | DNS_WANT_AAAA;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (host_type == HOSTS_AHOST_V4)
+                want = DNS_WANT_A;
+
+        results = calloc((size_t)key_cnt, sizeof(dns_result_t));
+        if (results == NULL)
+                err("Out of memory\n");
+        dns_load_conf(root_path(DNS_RESOLV_CONF, resolv_conf, sizeof(resolv_conf)), &conf);
+        dns_resolve(&conf, keys, key_cnt, want, results);
+        if (host_names != HOST_NAMES_CANON)
+                dns_reverse_names(&conf, results, key_cnt);
+
+        for (int i = 0; i < key_cnt; i++) {
+                if (results[i].found)
+                        print_dns_result(&results[i], host_type);
+                else
+                        chain_get(next, &keys[i], 1);
+        }
+
+        dns_results_free(results, key_cnt);
+        free(results);
+        return RES_OK;
+}
+
+/**
+ * Print a line of the hosts file the way print_hostent_info prints what
+ * gethostent returns for it
+ */
+static void print_hosts_entry(const hosts_entry_t *ent)
+{
+        char dst[DST_LEN];
+        int cnt = 0;
+
+        GETENT_PROBE_RECORD(ent->names[0].data, ent->names[0].len);
+        inet_ntop(ent->addr.family, ent->addr.addr, dst, DST_LEN);
+        cnt = out_str(dst);
+        out_pad(cnt, addr_align_to);
+        for (int i = 0; i < ent->name_cnt; i++) {
+                out_char(' ');
+                out_write(ent->names[i].data, (size_t)ent->names[i].len);
+        }
+        out_char('\n');
+}
+
+static void set_canon(dns_result_t *result, const strview_t *name)
+{
+        size_t len = (size_t)name->len < DNS_NAME_MAX ? (size_t)name->len : DNS_NAME_MAX;
+
+        memcpy(result->canon, name->data, len);
+        result->canon[len] = '\0';
+}
+
+static void add_address(dns_result_t *result, const dns_addr_t *addr)
+{
+        dns_addr_t *addrs = NULL;
+
+        for (size_t i = 0; i < result->addr_cnt; i++)
+                if (result->addrs[i].family == addr->family &&
+                    memcmp(result->addrs[i].addr, addr->addr, sizeof(addr->addr)) == 0)
+                        return;
+        addrs = realloc(result->addrs, (result->addr_cnt + 1) * sizeof(dns_addr_t));
+        if (addrs == NULL)
+                err("Out of memory\n");
+        result->addrs = addrs;
+        result->addrs[result->addr_cnt++] = *addr;
+}
+
+/**
+ * Look @key up in the hosts file, as an address when it is one and as a
+ * name otherwise. Names get the addresses of every line naming them, and
+ * are printed after the first line about their first address, as
+ * getnameinfo would find them there.
+ */
+static bool hosts_file_result(const hosts_file_t *hf, const char *key, int host_type,
+                              dns_result_t *result)
+{
+        hosts_entry_t ent;
+        dns_addr_t addr;
+        size_t probe = 0;
+
+        memset(&addr, 0, sizeof(dns_addr_t));
+        if (inet_pton(AF_INET, key, addr.addr) == 1)
+                addr.family = AF_INET;
+        else if (inet_pton(AF_INET6, key, addr.addr) == 1)
+                addr.family = AF_INET6;
+
+        if (addr.family != 0) {
+                if (host_type == HOSTS_AHOST_V4 && addr.family != AF_INET)
+                        return false;
+                if (!hosts_file_find_addr(hf, &addr, &ent))
+                        return false;
+                add_address(result, &addr);
+                if (host_names == HOST_NAMES_CANON)
+                        snprintf(result->canon, sizeof(result->canon), "%s", key);
+                else
+                        set_canon(result, &ent.names[0]);
+                result->found = true;
+                return true;
+        }
+
+        while (hosts_file_find_name(hf, key, &probe, &ent)) {
+                if (host_type == HOSTS_AHOST_V4 && ent.addr.family != AF_INET)
+                        continue;
+                if (result->addr_cnt == 0)
+                        set_canon(result, &ent.names[0]);
+                add_address(result, &ent.addr);
+        }
+        if (result->addr_cnt == 0)
+                return false;
+        if (host_names != HOST_NAMES_CANON &&
+            hosts_file_find_addr(hf, first_dns_address(result), &ent))
+                set_canon(result, &ent.names[0]);
+        result->found = true;
+        return true;
+}
+
+/**
+ * Resolve keys through the index of the hosts file. Keys it does not know
+ * go on to @next a run at a time, rather than one by one, so that -j still
+ * gets to resolve them side by side; runs end at keys found here, to print
+ * everything in the order of the keys.
+ */
+static int _get_hosts_files(const char **keys, int key_cnt, const getent_chain_t *next,
+                            int host_type)
+{
+        hosts_file_t hf;
+        int pending = 0;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (!hosts_file_open(&hf, HOSTS_FILE, true))
+                return chain_get(next, keys, key_cnt);
+
+        for (int i = 0; i < key_cnt; i++) {
+                dns_result_t result;
+
+                memset(&result, 0, sizeof(dns_result_t));
+                if (hosts_file_result(&hf, keys[i], host_type, &result)) {
+                        if (pending < i)
+                                chain_get(next, &keys[pending], i - pending);
+                        print_dns_result(&result, host_type);
+                        pending = i + 1;
+                }
+                dns_results_free(&result, 1);
+        }
+        if (pending < key_cnt)
+                chain_get(next, &keys[pending], key_cnt - pending);
+
+        hosts_file_close(&hf);
+        return RES_OK;
+}
+
+/**
+ * Stream the hosts file, without indexing it
+ */
+static int enum_hosts_file(void)
+{
+        hosts_file_t hf;
+        hosts_entry_t ent;
+        size_t pos = 0;
+
+        if (!hosts_file_open(&hf, HOSTS_FILE, false))
+                return RES_KEY_NOT_FOUND;
+        while (hosts_file_next(&hf, &pos, &ent))
+                print_hosts_entry(&ent);
+        hosts_file_close(&hf);
+
+        return RES_OK;
+}
+
+int get_hosts(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts(keys, key_cnt, next, HOSTS_HOST);
+}
+
+int get_ahosts(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts(keys, key_cnt, next, HOSTS_AHOST);
+}
+
+int get_ahostsv4(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts(keys, key_cnt, next, HOSTS_AHOST_V4);
+}
+
+int get_ahostsv6(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts(keys, key_cnt, next, HOSTS_AHOST_V6);
+}
+
+static int get_hosts_dns(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_dns(keys, key_cnt, next, HOSTS_HOST);
+}
+
+static int get_ahosts_dns(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_dns(keys, key_cnt, next, HOSTS_AHOST);
+}
+
+static int get_ahostsv4_dns(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_dns(keys, key_cnt, next, HOSTS_AHOST_V4);
+}
+
+static int get_ahostsv6_dns(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_dns(keys, key_cnt, next, HOSTS_AHOST_V6);
+}
+
+static int get_hosts_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_files(keys, key_cnt, next, HOSTS_HOST);
+}
+
+static int get_ahosts_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_files(keys, key_cnt, next, HOSTS_AHOST);
+}
+
+static int get_ahostsv4_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_files(keys, key_cnt, next, HOSTS_AHOST_V4);
+}
+
+static int get_ahostsv6_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return _get_hosts_files(keys, key_cnt, next, HOSTS_AHOST_V6);
+}
+
+static int enum_hosts_files_all(void)
+{
+        return enum_hosts_file();
+}
+
+static int enum_ahosts_files_all(void)
+{
+        return enum_hosts_file();
+}
+
+static int enum_ahostsv4_files_all(void)
+{
+        return enum_hosts_file();
+}
+
+static int enum_ahostsv6_files_all(void)
+{
+        return enum_hosts_file();
 }
 
 ENUM_ALL(ahostsv4, hostent, 1, hostent)
@@ -172,6 +829,43 @@ ENUM_ALL(ahostsv6, hostent, 1, hostent)
 ENUM_ALL(ahosts, hostent, 1, hostent)
 ENUM_ALL(hosts, hostent, 1, hostent)
 
+BACKEND(ahostsv4, files);
+BACKEND(ahostsv6, files);
+BACKEND(ahosts, files);
+BACKEND(hosts, files);
+LIBC_BACKEND(ahostsv4);
+LIBC_BACKEND(ahostsv6);
+LIBC_BACKEND(ahosts);
+LIBC_BACKEND(hosts);
+BACKEND_NO_ENUM(ahostsv4, dns);
+BACKEND_NO_ENUM(ahostsv6, dns);
+BACKEND_NO_ENUM(ahosts, dns);
+BACKEND_NO_ENUM(hosts, dns);
+DATABASE_BACKENDS(ahostsv4,
+                  "files,libc",
+                  &ahostsv4_files_backend,
+                  &ahostsv4_libc_backend,
+                  &ahostsv4_dns_backend,
+                  &cache_backend);
+DATABASE_BACKENDS(ahostsv6,
+                  "files,libc",
+                  &ahostsv6_files_backend,
+                  &ahostsv6_libc_backend,
+                  &ahostsv6_dns_backend,
+                  &cache_backend);
+DATABASE_BACKENDS(ahosts,
+                  "files,libc",
+                  &ahosts_files_backend,
+                  &ahosts_libc_backend,
+                  &ahosts_dns_backend,
+                  &cache_backend);
+DATABASE_BACKENDS(hosts,
+                  "files,libc",
+                  &hosts_files_backend,
+                  &hosts_libc_backend,
+                  &hosts_dns_backend,
+                  &cache_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
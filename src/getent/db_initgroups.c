@@ -24,46 +24,351 @@
 
 #define _GNU_SOURCE
 
+#include "files.h"
 #include "getent.h"
+#include "keyset.h"
+#include "output.h"
+#include "probes.h"
 
 #include <grp.h>
+#include <pwd.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 static const int initgroup_align_to = 23;
-static const size_t MAX_GROUP_CNT = 256;
 
-int get_initgroups(const char **keys, int key_cnt)
+/**
+ * Supplementary groups of a user, in the order their member lists were met
+ */
+typedef struct user_groups {
+        gid_t *gids;
+        size_t cnt;
+        size_t size;
+        bool known; /**< Seen in a member list or in the user database */
+} user_groups_t;
+
+/**
+ * Reverse index from member names to groups, for a set of users. It is
+ * filled by a single pass over the group database however many users are
+ * asked for, and holds any number of groups per user.
+ */
+typedef struct initgroups_index {
+        keyset_t set;
+        user_groups_t *users; /**< Per user, at the position of its first occurrence */
+} initgroups_index_t;
+
+/**
+ * Print @user and the groups in @gids, leaving out gid 0 and any gid
+ * listed twice
+ */
+static void print_groups(const char *user, const gid_t *gids, size_t gid_cnt)
+{
+        static uint64_t *seen = NULL; /**< gid + 1 per slot, 0 when free */
+        static size_t seen_size = 0;
+        size_t mask = 0;
+        int cnt = 0;
+
+        if (seen_size < gid_cnt * 2) {
+                free(seen);
+                for (seen_size = 64; seen_size < gid_cnt * 2;)
+                        seen_size *= 2;
+                seen = malloc(seen_size * sizeof(uint64_t));
+                if (seen == NULL)
+                        err("Out of memory\n");
+        }
+        mask = seen_size - 1;
+        memset(seen, 0, seen_size * sizeof(uint64_t));
+
+        GETENT_PROBE_RECORD_STR(user);
+        cnt += out_str(user);
+        cnt += out_char(' ');
+        out_pad(cnt, initgroup_align_to);
+        for (size_t i = 0; i < gid_cnt; i++) {
+                size_t slot = ((size_t)gids[i] * 2654435761U) & mask;
+
+                if (gids[i] == 0)
+                        continue;
+                while (seen[slot] != 0 && seen[slot] != (uint64_t)gids[i] + 1)
+                        slot = (slot + 1) & mask;
+                if (seen[slot] != 0)
+                        continue;
+                seen[slot] = (uint64_t)gids[i] + 1;
+                out_uint(gids[i]);
+                out_char(' ');
+        }
+        out_char('\n');
+}
+
+static void index_init(initgroups_index_t *idx, const char **users, int user_cnt)
+{
+        if (!keyset_init(&idx->set, users, user_cnt, false))
+                err("Out of memory\n");
+        idx->users = calloc((size_t)user_cnt, sizeof(user_groups_t));
+        if (idx->users == NULL)
+                err("Out of memory\n");
+}
+
+static void index_free(initgroups_index_t *idx)
+{
+        for (int i = 0; i < idx->set.key_cnt; i++)
+                free(idx->users[i].gids);
+        free(idx->users);
+        keyset_free(&idx->set);
+}
+
+static void add_member(initgroups_index_t *idx, const char *name, size_t len, gid_t gid)
+{
+        int key = keyset_find_name(&idx->set, name, len);
+        user_groups_t *user = NULL;
+
+        if (key < 0)
+                return;
+        user = &idx->users[key];
+        user->known = true;
+        if (user->cnt == user->size) {
+                size_t size = user->size == 0 ? 16 : user->size * 2;
+                gid_t *gids = realloc(user->gids, size * sizeof(gid_t));
+
+                if (gids == NULL)
+                        err("Out of memory\n");
+                user->gids = gids;
+                user->size = size;
+        }
+        user->gids[user->cnt++] = gid;
+}
+
+static void scan_group_file(initgroups_index_t *idx)
+{
+        files_map_t map;
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+
+        if (!files_map("/etc/group", &map))
+                return;
+        while (files_next(&map, &pos, &record, &len)) {
+                group_view_t grp;
+                const char *member = NULL;
+                const char *end = NULL;
+
+                if (!files_parse_group(record, len, &grp))
+                        continue;
+                member = grp.members.data;
+                end = member + grp.members.len;
+                while (member < end) {
+                        const char *comma = memchr(member, ',', (size_t)(end - member));
+                        const char *stop = comma != NULL ? comma : end;
+
+                        if (stop > member)
+                                add_member(idx, member, (size_t)(stop - member), grp.gid);
+                        member = stop + 1;
+                }
+        }
+        files_unmap(&map);
+}
+
+static void scan_group_libc(initgroups_index_t *idx)
+{
+        struct group *grp = NULL;
+
+        setgrent();
+        while ((grp = getgrent()) != NULL)
+                for (char **member = grp->gr_mem; member != NULL && *member != NULL; member++)
+                        add_member(idx, *member, strlen(*member), grp->gr_gid);
+        endgrent();
+}
+
+/**
+ * Print every user in @users with the groups found by @scan, in the order
+ * given
+ */
+static void print_users(const char **users, int user_cnt, void (*scan)(initgroups_index_t *))
+{
+        initgroups_index_t idx;
+
+        if (user_cnt == 0)
+                return;
+        index_init(&idx, users, user_cnt);
+        scan(&idx);
+        for (int i = 0; i < user_cnt; i++) {
+                const user_groups_t *user = &idx.users[i];
+
+                if (idx.set.first[i] == i)
+                        print_groups(users[i], user->gids, user->cnt);
+        }
+        index_free(&idx);
+}
+
+int get_initgroups(const char **keys, int key_cnt,
+                   __attribute__((unused)) const getent_chain_t *next)
 {
+        gid_t *groups = NULL;
+        int size = 64;
+
         if (keys == NULL)
                 return RES_KEY_NOT_FOUND;
 
+        groups = malloc((size_t)size * sizeof(gid_t));
+        if (groups == NULL)
+                err("Out of memory\n");
         for (; key_cnt-- > 0; keys++) {
-                gid_t *groups = calloc(MAX_GROUP_CNT, sizeof(gid_t));
-                int group_cnt = (int)MAX_GROUP_CNT;
-                int i = 0;
-                int cnt = 0;
+                int group_cnt = size;
+
+                /* On failure, group_cnt holds how many groups there are */
+                while (getgrouplist(*keys, 0, groups, &group_cnt) == -1) {
+                        size = group_cnt > size ? group_cnt : size * 2;
+                        groups = realloc(groups, (size_t)size * sizeof(gid_t));
+                        if (groups == NULL)
+                                err("Out of memory\n");
+                        group_cnt = size;
+                }
+                print_groups(*keys, groups, (size_t)group_cnt);
+        }
+        free(groups);
+
+        return RES_OK;
+}
+
+/**
+ * Every user from getpwent, with their groups from a single pass over
+ * getgrent
+ */
+int enum_initgroups_all(void)
+{
+        const char **users = NULL;
+        struct passwd *pwd = NULL;
+        int user_cnt = 0;
+        int size = 0;
+
+        setpwent();
+        while ((pwd = getpwent()) != NULL) {
+                if (user_cnt == size) {
+                        size = size == 0 ? 1024 : size * 2;
+                        users = realloc(users, (size_t)size * sizeof(char *));
+                        if (users == NULL)
+                                err("Out of memory\n");
+                }
+                users[user_cnt] = strdup(pwd->pw_name);
+                if (users[user_cnt++] == NULL)
+                        err("Out of memory\n");
+        }
+        endpwent();
+
+        print_users(users, user_cnt, scan_group_libc);
+        for (int i = 0; i < user_cnt; i++)
+                free((char *)users[i]);
+        free(users);
+
+        return RES_OK;
+}
+
+/**
+ * Answer @keys from a single pass over /etc/group. Users found in neither
+ * /etc/group nor /etc/passwd are handed to the @next backends.
+ */
+static int get_initgroups_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        initgroups_index_t idx;
+        int unknown = 0;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+
+        index_init(&idx, keys, key_cnt);
+        scan_group_file(&idx);
+        for (int i = 0; i < key_cnt; i++)
+                if (idx.set.first[i] == i && !idx.users[i].known)
+                        unknown++;
+
+        /* Users in no group are still answered here if they exist */
+        if (unknown > 0) {
+                files_map_t map;
+                const char *record = NULL;
+                size_t len = 0;
+                size_t pos = 0;
 
-                if (groups == NULL)
-                        err("Out of memory");
+                if (files_map("/etc/passwd", &map)) {
+                        while (unknown > 0 && files_next(&map, &pos, &record, &len)) {
+                                const char *colon = memchr(record, ':', len);
+                                int key = keyset_find_name(&idx.set,
+                                                           record,
+                                                           colon != NULL ? (size_t)(colon - record)
+                                                                         : len);
 
-                if (getgrouplist(*keys, 0, groups, &group_cnt) == -1) {
-                        free(groups);
-                        return RES_KEY_NOT_FOUND;
+                                if (key >= 0 && !idx.users[key].known) {
+                                        idx.users[key].known = true;
+                                        unknown--;
+                                }
+                        }
+                        files_unmap(&map);
                 }
-                cnt += printf("%s ", *keys);
-                print_align_to(cnt, initgroup_align_to);
-                for (i = 0; i < group_cnt; i++) {
-                        if (groups != NULL && groups[i] > 0)
-                                printf("%u ", groups[i]);
+        }
+
+        for (int i = 0; i < key_cnt; i++) {
+                const user_groups_t *user = &idx.users[idx.set.first[i]];
+
+                if (user->known)
+                        print_groups(keys[i], user->gids, user->cnt);
+                else
+                        chain_get(next, &keys[i], 1);
+        }
+        index_free(&idx);
+
+        return RES_OK;
+}
+
+/**
+ * Every user of /etc/passwd, in file order, with their groups from a
+ * single pass over /etc/group
+ */
+static int enum_initgroups_files_all(void)
+{
+        const char **users = NULL;
+        char *names = NULL;
+        files_map_t map;
+        const char *record = NULL;
+        size_t used = 0;
+        size_t len = 0;
+        size_t pos = 0;
+        int user_cnt = 0;
+        int size = 0;
+
+        if (!files_map("/etc/passwd", &map))
+                return RES_KEY_NOT_FOUND;
+
+        /* Names are no longer than the file they come from */
+        names = malloc(map.size + 1);
+        if (names == NULL)
+                err("Out of memory\n");
+        while (files_next(&map, &pos, &record, &len)) {
+                passwd_view_t pwd;
+
+                if (!files_parse_passwd(record, len, &pwd))
+                        continue;
+                if (user_cnt == size) {
+                        size = size == 0 ? 1024 : size * 2;
+                        users = realloc(users, (size_t)size * sizeof(char *));
+                        if (users == NULL)
+                                err("Out of memory\n");
                 }
-                printf("\n");
-                free(groups);
+                memcpy(names + used, pwd.name.data, (size_t)pwd.name.len);
+                names[used + (size_t)pwd.name.len] = '\0';
+                users[user_cnt++] = names + used;
+                used += (size_t)pwd.name.len + 1;
         }
+        files_unmap(&map);
+
+        print_users(users, user_cnt, scan_group_file);
+        free(users);
+        free(names);
 
         return RES_OK;
 }
 
-NO_ENUM_ALL_FOR(initgroups)
+BACKEND(initgroups, files);
+LIBC_BACKEND(initgroups);
+DATABASE_BACKENDS(initgroups, "files,libc", &initgroups_files_backend, &initgroups_libc_backend);
 
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
@@ -25,6 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <netdb.h>
 #include <stdlib.h>
@@ -36,10 +38,17 @@ static void print_getent(const char *host, const char *user, const char *domain)
 {
         if (host == NULL)
                 return;
-        printf("(%s,%s,%s)", host, user != NULL ? user : "", domain != NULL ? domain : "");
+        GETENT_PROBE_RECORD_STR(host);
+        out_char('(');
+        out_str(host);
+        out_char(',');
+        out_str(user != NULL ? user : "");
+        out_char(',');
+        out_str(domain != NULL ? domain : "");
+        out_char(')');
 }
 
-int get_netgroup(const char **keys, int key_cnt)
+int get_netgroup(const char **keys, int key_cnt, __attribute__((unused)) const getent_chain_t *next)
 {
         if (keys == NULL)
                 return RES_KEY_NOT_FOUND;
@@ -57,22 +66,26 @@ int get_netgroup(const char **keys, int key_cnt)
                         if (first == 1) {
                                 int cnt;
 
-                                cnt = printf("%s ", *keys);
-                                print_align_to(cnt, netgroup_align_to);
+                                cnt = out_str(*keys);
+                                cnt += out_char(' ');
+                                out_pad(cnt, netgroup_align_to);
                                 first = 0;
                         } else
-                                printf(" ");
+                                out_char(' ');
                         print_getent(host, user, domain);
                 } while (host != NULL);
                 if (first != 1)
-                        printf("\n");
+                        out_char('\n');
         } else if (key_cnt >= 4) {
                 int res = innetgr(keys[0], keys[1], keys[2], keys[3]);
-                int cnt = printf("%s ", *keys);
+                int cnt = out_str(*keys);
 
-                print_align_to(cnt, netgroup_align_to);
+                cnt += out_char(' ');
+                out_pad(cnt, netgroup_align_to);
                 print_getent(keys[1], keys[2], keys[3]);
-                printf(" = %d\n", res);
+                out_write(" = ", 3);
+                out_int(res);
+                out_char('\n');
         } else
                 return RES_KEY_NOT_FOUND;
 
@@ -81,6 +94,9 @@ int get_netgroup(const char **keys, int key_cnt)
 
 NO_ENUM_ALL_FOR(netgroup)
 
+LIBC_BACKEND(netgroup);
+DATABASE_BACKENDS(netgroup, "libc", &netgroup_libc_backend);
+
 #endif
 
 /*
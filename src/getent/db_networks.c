@@ -27,9 +27,10 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <stddef.h>
-#include <stdio.h>
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 static const int network_align_to = 23;
 
@@ -39,18 +40,21 @@ static void print_netent_info(struct netent *net)
         int cnt = 0;
         char **aliases = net->n_aliases;
 
-        cnt += printf("%s ", net->n_name);
-        print_align_to(cnt, network_align_to);
+        GETENT_PROBE_RECORD_STR(net->n_name);
+        cnt += out_str(net->n_name);
+        cnt += out_char(' ');
+        out_pad(cnt, network_align_to);
         addr.s_addr = htonl(net->n_net);
-        printf("%s", inet_ntoa(addr));
+        out_str(inet_ntoa(addr));
         while (aliases != NULL && *aliases != NULL) {
-                printf(" %s", *aliases);
+                out_char(' ');
+                out_str(*aliases);
                 aliases++;
         }
-        printf("\n");
+        out_char('\n');
 }
 
-int get_networks(const char **keys, int key_cnt)
+int get_networks(const char **keys, int key_cnt, __attribute__((unused)) const getent_chain_t *next)
 {
         if (keys == NULL)
                 return RES_KEY_NOT_FOUND;
@@ -79,6 +83,9 @@ int get_networks(const char **keys, int key_cnt)
 
 ENUM_ALL(networks, netent, 1, netent)
 
+LIBC_BACKEND(networks);
+DATABASE_BACKENDS(networks, "libc", &networks_libc_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
@@ -25,27 +25,128 @@
 #define _GNU_SOURCE
 
 #include <pwd.h>
-#include <stdio.h>
 
+#include "dbfile.h"
+#include "files.h"
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
+
+static void print_passwd_view(const passwd_view_t *pwd)
+{
+        GETENT_PROBE_RECORD(pwd->name.data, pwd->name.len);
+        out_write(pwd->name.data, (size_t)pwd->name.len);
+        out_char(':');
+        out_write(pwd->passwd.data, (size_t)pwd->passwd.len);
+        out_char(':');
+        out_uint(pwd->uid);
+        out_char(':');
+        out_uint(pwd->gid);
+        out_char(':');
+        out_write(pwd->gecos.data, (size_t)pwd->gecos.len);
+        out_char(':');
+        out_write(pwd->dir.data, (size_t)pwd->dir.len);
+        out_char(':');
+        out_write(pwd->shell.data, (size_t)pwd->shell.len);
+        out_char('\n');
+}
 
 static void print_passwd_info(struct passwd *pwd)
 {
-        printf("%s:%s:%u:%u:", pwd->pw_name, pwd->pw_passwd, pwd->pw_uid, pwd->pw_gid);
-        if (pwd->pw_gecos != NULL)
-                printf("%s", pwd->pw_gecos);
-        printf(":");
-        if (pwd->pw_dir != NULL)
-                printf("%s", pwd->pw_dir);
-        printf(":");
-        if (pwd->pw_shell != NULL)
-                printf("%s", pwd->pw_shell);
-        printf("\n");
+        passwd_view_t view = {
+                .name = strview(pwd->pw_name),
+                .passwd = strview(pwd->pw_passwd),
+                .uid = pwd->pw_uid,
+                .gid = pwd->pw_gid,
+                .gecos = strview(pwd->pw_gecos),
+                .dir = strview(pwd->pw_dir),
+                .shell = strview(pwd->pw_shell),
+        };
+
+        print_passwd_view(&view);
+}
+
+static void emit_passwd_record(const char *record, size_t len)
+{
+        passwd_view_t pwd;
+
+        if (files_parse_passwd(record, len, &pwd))
+                print_passwd_view(&pwd);
+}
+
+static const files_database_t passwd_files = {
+        .path = "/etc/passwd",
+        .fields = 7,
+        .id_field = -1,
+        .emit = emit_passwd_record,
+};
+
+static int get_password_files(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        return files_get(&passwd_files, keys, key_cnt, next);
+}
+
+static int enum_password_files_all(void)
+{
+        return files_enum(&passwd_files);
 }
 
 GET_SIMPLE(password, getpwnam, passwd)
 ENUM_ALL(password, pwent, , passwd)
 
+static void print_passwd_record(const dbrecord_t *rec)
+{
+        passwd_view_t pwd;
+
+        dbfile_passwd_view(rec, &pwd);
+        print_passwd_view(&pwd);
+}
+
+static int get_password_db(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        dbfile_t db;
+        dbrecord_t rec;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (!dbfile_open_database(&db, "password"))
+                return chain_get(next, keys, key_cnt);
+
+        for (; key_cnt-- > 0; keys++) {
+                if (dbfile_find_name(&db, *keys, &rec))
+                        print_passwd_record(&rec);
+                else
+                        chain_get(next, keys, 1);
+        }
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+static int enum_password_db_all(void)
+{
+        dbfile_t db;
+        dbrecord_t rec = { .next = NULL };
+
+        if (!dbfile_open_database(&db, "password"))
+                return RES_KEY_NOT_FOUND;
+        while (dbfile_next(&db, &rec))
+                print_passwd_record(&rec);
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+BACKEND(password, files);
+LIBC_BACKEND(password);
+BACKEND(password, db);
+DATABASE_BACKENDS(password,
+                  "files,libc",
+                  &password_files_backend,
+                  &password_libc_backend,
+                  &password_db_backend,
+                  &cache_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
@@ -25,6 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <netdb.h>
 #include <stdlib.h>
@@ -36,18 +38,24 @@ static void print_protoent_info(struct protoent *ent)
         char **alias = NULL;
         int cnt = 0;
 
-        cnt += printf("%s ", ent->p_name);
-        print_align_to(cnt, proto_align_to);
-        printf("%d", ent->p_proto);
+        GETENT_PROBE_RECORD_STR(ent->p_name);
+        cnt += out_str(ent->p_name);
+        cnt += out_char(' ');
+        out_pad(cnt, proto_align_to);
+        out_int(ent->p_proto);
         for (alias = ent->p_aliases; alias != NULL && *alias != NULL; alias++) {
-                printf(" %s", *alias);
+                out_char(' ');
+                out_str(*alias);
         }
-        printf("\n");
+        out_char('\n');
 }
 
 GET_NUMERIC(protocols, getprotobyname, getprotobynumber, protoent)
 ENUM_ALL(protocols, protoent, 1, protoent)
 
+LIBC_BACKEND(protocols);
+DATABASE_BACKENDS(protocols, "libc", &protocols_libc_backend, &cache_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
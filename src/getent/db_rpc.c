@@ -25,6 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <netdb.h>
 #include <stdlib.h>
@@ -39,20 +41,26 @@ static void print_rpcent_info(struct rpcent *rpc)
         int cnt = 0;
         int first = 1;
 
-        cnt += printf("%s ", rpc->r_name);
-        print_align_to(cnt, rpc_align_to);
-        printf("%d", rpc->r_number);
+        GETENT_PROBE_RECORD_STR(rpc->r_name);
+        cnt += out_str(rpc->r_name);
+        cnt += out_char(' ');
+        out_pad(cnt, rpc_align_to);
+        out_int(rpc->r_number);
 
         for (alias = rpc->r_aliases; alias != NULL && *alias != NULL; alias++) {
-                printf("%s%s", first == 1 ? "  " : " ", *alias);
+                out_str(first == 1 ? "  " : " ");
+                out_str(*alias);
                 first = 0;
         }
-        printf("\n");
+        out_char('\n');
 }
 
 GET_NUMERIC(rpc, getrpcbyname, getrpcbynumber, rpcent)
 ENUM_ALL(rpc, rpcent, 1, rpcent)
 
+LIBC_BACKEND(rpc);
+DATABASE_BACKENDS(rpc, "libc", &rpc_libc_backend);
+
 #endif
 
 /*
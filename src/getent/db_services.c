@@ -25,6 +25,8 @@
 #define _GNU_SOURCE
 
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 
 #include <netdb.h>
 #include <stdlib.h>
@@ -36,16 +38,21 @@ static void print_servent_info(struct servent *ent)
         char **alias = NULL;
         int cnt = 0;
 
-        cnt = printf("%s ", ent->s_name);
-        print_align_to(cnt, service_align_to);
-        printf("%hu/%s", ntohs((uint16_t)ent->s_port), ent->s_proto);
+        GETENT_PROBE_RECORD_STR(ent->s_name);
+        cnt = out_str(ent->s_name);
+        cnt += out_char(' ');
+        out_pad(cnt, service_align_to);
+        out_uint(ntohs((uint16_t)ent->s_port));
+        out_char('/');
+        out_str(ent->s_proto);
         for (alias = ent->s_aliases; alias != NULL && *alias != NULL; alias++) {
-                printf(" %s", *alias);
+                out_char(' ');
+                out_str(*alias);
         }
-        printf("\n");
+        out_char('\n');
 }
 
-int get_services(const char **keys, int key_cnt)
+int get_services(const char **keys, int key_cnt, const getent_chain_t *next)
 {
         if (keys == NULL)
                 return RES_KEY_NOT_FOUND;
@@ -61,6 +68,8 @@ int get_services(const char **keys, int key_cnt)
                         ent = getservbyname(*keys, NULL);
                 if (ent != NULL)
                         print_servent_info(ent);
+                else
+                        chain_get(next, keys, 1);
         }
 
         return RES_OK;
@@ -68,6 +77,9 @@ int get_services(const char **keys, int key_cnt)
 
 ENUM_ALL(services, servent, 1, servent)
 
+LIBC_BACKEND(services);
+DATABASE_BACKENDS(services, "libc", &services_libc_backend, &cache_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
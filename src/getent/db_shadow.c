@@ -24,35 +24,109 @@
 
 #define _GNU_SOURCE
 
+#include "dbfile.h"
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
 #include <shadow.h>
+#include <stdlib.h>
 
 static void print_spwd_info(struct spwd *pwd)
 {
-        printf("%s:%s:%ld:", pwd->sp_namp, pwd->sp_pwdp, pwd->sp_lstchg);
+        GETENT_PROBE_RECORD_STR(pwd->sp_namp);
+        out_str(pwd->sp_namp);
+        out_char(':');
+        out_str(pwd->sp_pwdp);
+        out_char(':');
+        out_int(pwd->sp_lstchg);
+        out_char(':');
         if (pwd->sp_min >= 0)
-                printf("%ld", pwd->sp_min);
-        printf(":");
+                out_int(pwd->sp_min);
+        out_char(':');
         if (pwd->sp_max >= 0)
-                printf("%ld", pwd->sp_max);
-        printf(":");
+                out_int(pwd->sp_max);
+        out_char(':');
         if (pwd->sp_warn >= 0)
-                printf("%ld", pwd->sp_warn);
-        printf(":");
+                out_int(pwd->sp_warn);
+        out_char(':');
         if (pwd->sp_inact >= 0)
-                printf("%ld", pwd->sp_inact);
-        printf(":");
+                out_int(pwd->sp_inact);
+        out_char(':');
         if (pwd->sp_expire >= 0)
-                printf("%ld", pwd->sp_expire);
-        printf(":");
+                out_int(pwd->sp_expire);
+        out_char(':');
         if (pwd->sp_flag != (unsigned long)-1)
-                printf("%lu", pwd->sp_flag);
-        printf("\n");
+                out_uint(pwd->sp_flag);
+        out_char('\n');
 }
 
 GET_SIMPLE(shadow, getspnam, spwd)
 ENUM_ALL(shadow, spent, , spwd)
 
+/**
+ * Numeric shadow fields are optional, libc reports empty ones as -1
+ */
+static long shadow_field(const char *field)
+{
+        return *field == '\0' ? -1 : strtol(field, NULL, 10);
+}
+
+static void print_spwd_record(const dbrecord_t *rec)
+{
+        struct spwd pwd = {
+                .sp_namp = (char *)rec->fields[0],
+                .sp_pwdp = (char *)rec->fields[1],
+                .sp_lstchg = shadow_field(rec->fields[2]),
+                .sp_min = shadow_field(rec->fields[3]),
+                .sp_max = shadow_field(rec->fields[4]),
+                .sp_warn = shadow_field(rec->fields[5]),
+                .sp_inact = shadow_field(rec->fields[6]),
+                .sp_expire = shadow_field(rec->fields[7]),
+                .sp_flag = (unsigned long)shadow_field(rec->fields[8]),
+        };
+
+        print_spwd_info(&pwd);
+}
+
+static int get_shadow_db(const char **keys, int key_cnt, const getent_chain_t *next)
+{
+        dbfile_t db;
+        dbrecord_t rec;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+        if (!dbfile_open_database(&db, "shadow"))
+                return chain_get(next, keys, key_cnt);
+
+        for (; key_cnt-- > 0; keys++) {
+                if (dbfile_find_name(&db, *keys, &rec))
+                        print_spwd_record(&rec);
+                else
+                        chain_get(next, keys, 1);
+        }
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+static int enum_shadow_db_all(void)
+{
+        dbfile_t db;
+        dbrecord_t rec = { .next = NULL };
+
+        if (!dbfile_open_database(&db, "shadow"))
+                return RES_KEY_NOT_FOUND;
+        while (dbfile_next(&db, &rec))
+                print_spwd_record(&rec);
+        dbfile_close(&db);
+
+        return RES_OK;
+}
+
+LIBC_BACKEND(shadow);
+BACKEND(shadow, db);
+DATABASE_BACKENDS(shadow, "libc", &shadow_libc_backend, &shadow_db_backend);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
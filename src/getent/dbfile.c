@@ -0,0 +1,248 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dbfile.h"
+#include "getent.h"
+#include "stats.h"
+
+const char *dbfile_path(const char *dir, const char *name, char *buf, size_t len)
+{
+        char rooted[PATH_MAX];
+
+        /* Keep the names users know from /etc */
+        if (strcmp(name, "password") == 0)
+                name = "passwd";
+        if (dir == NULL)
+                dir = root_path(GETENT_DB_DIR, rooted, sizeof(rooted));
+        snprintf(buf, len, "%s/%s.db", dir, name);
+        return buf;
+}
+
+static bool valid_index(const dbfile_t *db, const dbfile_index_t *idx)
+{
+        if (idx->bucket_cnt == 0)
+                return true;
+        if (idx->slot_cnt == 0)
+                return false;
+        if (idx->seeds_off > db->size ||
+            (db->size - idx->seeds_off) / sizeof(uint32_t) < idx->bucket_cnt)
+                return false;
+        if (idx->slots_off > db->size ||
+            (db->size - idx->slots_off) / sizeof(uint32_t) < idx->slot_cnt)
+                return false;
+        return (idx->seeds_off | idx->slots_off) % sizeof(uint32_t) == 0;
+}
+
+bool dbfile_open(dbfile_t *db, const char *path)
+{
+        struct stat st;
+        void *map = NULL;
+        int fd = -1;
+
+        memset(db, 0, sizeof(dbfile_t));
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(dbfile_header_t)) {
+                close(fd);
+                return false;
+        }
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return false;
+
+        db->map = map;
+        db->size = (size_t)st.st_size;
+        db->hdr = map;
+        if (db->hdr->magic != DBFILE_MAGIC || db->hdr->version != DBFILE_VERSION ||
+            db->hdr->fields == 0 || db->hdr->fields > DBFILE_FIELDS_MAX ||
+            db->hdr->id_field < -1 || db->hdr->id_field >= (int32_t)db->hdr->fields ||
+            db->hdr->records_off > db->size ||
+            db->size - db->hdr->records_off < db->hdr->records_size ||
+            !valid_index(db, &db->hdr->index[DBFILE_INDEX_NAME]) ||
+            !valid_index(db, &db->hdr->index[DBFILE_INDEX_ID])) {
+                dbfile_close(db);
+                return false;
+        }
+        return true;
+}
+
+bool dbfile_open_database(dbfile_t *db, const char *name)
+{
+        char path[PATH_MAX];
+
+        if (dbfile_open(db, dbfile_path(NULL, name, path, sizeof(path))))
+                return true;
+        fprintf(stderr, "Unable to open %s, it can be built with getent-mkdb\n", path);
+        return false;
+}
+
+void dbfile_close(dbfile_t *db)
+{
+        if (db->map != NULL)
+                munmap((void *)db->map, db->size);
+        memset(db, 0, sizeof(dbfile_t));
+}
+
+/**
+ * Decode the record at @off, relative to the start of the records
+ */
+static bool read_record(const dbfile_t *db, uint64_t off, dbrecord_t *rec)
+{
+        const unsigned char *start = db->map + db->hdr->records_off;
+        const char *p = NULL;
+        const char *end = NULL;
+        uint32_t len = 0;
+
+        if (off + sizeof(uint32_t) > db->hdr->records_size)
+                return false;
+        memcpy(&len, start + off, sizeof(len));
+        if (len <= sizeof(uint32_t) || len > db->hdr->records_size - off)
+                return false;
+
+        stats_read(1, len);
+        p = (const char *)start + off + sizeof(uint32_t);
+        end = (const char *)start + off + len;
+        if (end[-1] != '\0')
+                return false;
+
+        for (uint32_t i = 0; i < db->hdr->fields; i++) {
+                if (p >= end)
+                        return false;
+                rec->fields[i] = p;
+                p += strlen(p) + 1;
+        }
+        rec->tail = p;
+        rec->tail_cnt = 0;
+        for (; p < end; p += strlen(p) + 1)
+                rec->tail_cnt++;
+        rec->next = (const unsigned char *)end;
+        return true;
+}
+
+/**
+ * Return the record offset stored in the slot @key hashes to
+ */
+static uint32_t lookup(const dbfile_t *db, int which, const void *key, size_t len)
+{
+        const dbfile_index_t *idx = &db->hdr->index[which];
+        uint32_t seed = 0;
+        uint32_t slot = 0;
+
+        if (idx->bucket_cnt == 0)
+                return DBFILE_EMPTY_SLOT;
+        memcpy(&seed,
+               db->map + idx->seeds_off +
+                   (dbfile_hash(key, len, 0) % idx->bucket_cnt) * sizeof(uint32_t),
+               sizeof(seed));
+        memcpy(&slot,
+               db->map + idx->slots_off +
+                   (dbfile_hash(key, len, seed) % idx->slot_cnt) * sizeof(uint32_t),
+               sizeof(slot));
+        return slot;
+}
+
+bool dbfile_find_name(const dbfile_t *db, const char *name, dbrecord_t *rec)
+{
+        uint32_t off = lookup(db, DBFILE_INDEX_NAME, name, strlen(name));
+
+        if (off == DBFILE_EMPTY_SLOT || !read_record(db, off, rec))
+                return false;
+        return strcmp(rec->fields[0], name) == 0;
+}
+
+bool dbfile_find_id(const dbfile_t *db, unsigned long id, dbrecord_t *rec)
+{
+        uint32_t key = (uint32_t)id;
+        uint32_t off = 0;
+        char *end = NULL;
+
+        if (db->hdr->id_field < 0 || id > UINT32_MAX)
+                return false;
+        off = lookup(db, DBFILE_INDEX_ID, &key, sizeof(key));
+        if (off == DBFILE_EMPTY_SLOT || !read_record(db, off, rec))
+                return false;
+        return strtoul(rec->fields[db->hdr->id_field], &end, 10) == id && *end == '\0';
+}
+
+bool dbfile_next(const dbfile_t *db, dbrecord_t *rec)
+{
+        const unsigned char *start = db->map + db->hdr->records_off;
+        uint64_t off = rec->next == NULL ? 0 : (uint64_t)(rec->next - start);
+
+        if (off >= db->hdr->records_size)
+                return false;
+        return read_record(db, off, rec);
+}
+
+void dbfile_passwd_view(const dbrecord_t *rec, passwd_view_t *pwd)
+{
+        pwd->name = strview(rec->fields[0]);
+        pwd->passwd = strview(rec->fields[1]);
+        pwd->uid = (uid_t)strtoul(rec->fields[2], NULL, 10);
+        pwd->gid = (gid_t)strtoul(rec->fields[3], NULL, 10);
+        pwd->gecos = strview(rec->fields[4]);
+        pwd->dir = strview(rec->fields[5]);
+        pwd->shell = strview(rec->fields[6]);
+}
+
+void dbfile_group_view(const dbrecord_t *rec, group_view_t *grp)
+{
+        const char *end = rec->tail;
+
+        for (size_t i = 0; i < rec->tail_cnt; i++)
+                end += strlen(end) + 1;
+        grp->name = strview(rec->fields[0]);
+        grp->passwd = strview(rec->fields[1]);
+        grp->gid = (gid_t)strtoul(rec->fields[2], NULL, 10);
+        /* Members follow one another, each NUL terminated */
+        grp->members.data = rec->tail;
+        grp->members.len = (int)(end - rec->tail);
+        grp->member_sep = '\0';
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
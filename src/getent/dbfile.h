@@ -0,0 +1,136 @@
+#ifndef GETENT_DBFILE_H
+#define GETENT_DBFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "files.h"
+
+#ifndef GETENT_DB_DIR
+#define GETENT_DB_DIR "/var/lib/libc-support"
+#endif
+
+/**
+ * Indexed database files, as written by getent-mkdb.
+ *
+ * A file holds the records of one database and two minimal perfect hash
+ * tables over them, one by name and one by numeric id. Lookups hash the
+ * key twice (once to pick a bucket, once with the bucket's displacement
+ * seed to pick a slot), then compare a single record.
+ *
+ * Records are stored as NUL terminated fields so that the struct passwd
+ * and friends handed to the formatters can point straight into the
+ * mapping:
+ *
+ *      uint32_t length of the record, including this prefix
+ *      fixed fields ("fields" in the header), each NUL terminated
+ *      any number of trailing fields (group members), each NUL terminated
+ *
+ * All integers are in host byte order: the files are built on the machine
+ * that reads them.
+ */
+#define DBFILE_MAGIC 0x42444547U /* GEDB */
+#define DBFILE_VERSION 1
+#define DBFILE_FIELDS_MAX 9
+#define DBFILE_EMPTY_SLOT UINT32_MAX
+
+enum { DBFILE_INDEX_NAME = 0, DBFILE_INDEX_ID = 1, DBFILE_INDEX_CNT = 2 };
+
+typedef struct dbfile_index {
+        uint64_t seeds_off;  /**< Offset of the per bucket displacement seeds */
+        uint64_t slots_off;  /**< Offset of the slots (record offsets) */
+        uint32_t bucket_cnt; /**< Number of buckets, 0 when the index is absent */
+        uint32_t slot_cnt;   /**< Number of slots */
+} dbfile_index_t;
+
+typedef struct dbfile_header {
+        uint32_t magic;      /**< DBFILE_MAGIC */
+        uint32_t version;    /**< DBFILE_VERSION */
+        uint32_t record_cnt; /**< Number of records */
+        uint32_t fields;     /**< Fixed fields per record */
+        int32_t id_field;    /**< Field indexed by id, or -1 */
+        uint32_t reserved;
+        uint64_t records_off;  /**< Offset of the first record */
+        uint64_t records_size; /**< Size of all records */
+        dbfile_index_t index[DBFILE_INDEX_CNT];
+} dbfile_header_t;
+
+/**
+ * A mapped database file
+ */
+typedef struct dbfile {
+        const unsigned char *map;
+        size_t size;
+        const dbfile_header_t *hdr;
+} dbfile_t;
+
+/**
+ * A record, pointing into the mapping
+ */
+typedef struct dbrecord {
+        const char *fields[DBFILE_FIELDS_MAX]; /**< Fixed fields */
+        const char *tail;                      /**< First trailing field */
+        size_t tail_cnt;                       /**< Number of trailing fields */
+        const unsigned char *next;             /**< Start of the following record */
+} dbrecord_t;
+
+/**
+ * Hash @len bytes of @key with @seed. Shared by the builder and reader.
+ */
+static inline uint64_t dbfile_hash(const void *key, size_t len, uint32_t seed)
+{
+        const unsigned char *p = key;
+        uint64_t h = 14695981039346656037ULL ^ ((uint64_t)seed * 0x9E3779B97F4A7C15ULL);
+
+        while (len-- > 0) {
+                h ^= *p++;
+                h *= 1099511628211ULL;
+        }
+        return h ^ (h >> 32);
+}
+
+/**
+ * Return the path of the indexed file for database @name in @buf. Files
+ * live in @dir, or GETENT_DB_DIR (under root_dir) when NULL.
+ */
+extern const char *dbfile_path(const char *dir, const char *name, char *buf, size_t len);
+
+/**
+ * Map @path. Returns false if it is missing or not a valid database.
+ */
+extern bool dbfile_open(dbfile_t *db, const char *path);
+
+/**
+ * Map the indexed file of database @name. Complains on stderr and returns
+ * false if it is missing.
+ */
+extern bool dbfile_open_database(dbfile_t *db, const char *name);
+
+/**
+ * Unmap the database
+ */
+extern void dbfile_close(dbfile_t *db);
+
+/**
+ * Find the record named @name, or with id @id. Return false if missing.
+ */
+extern bool dbfile_find_name(const dbfile_t *db, const char *name, dbrecord_t *rec);
+extern bool dbfile_find_id(const dbfile_t *db, unsigned long id, dbrecord_t *rec);
+
+/**
+ * Walk all records in file order: pass NULL in @rec->next to get the first
+ * one. Returns false past the last record.
+ */
+extern bool dbfile_next(const dbfile_t *db, dbrecord_t *rec);
+
+/**
+ * Read a record of the password or group database as the view
+ * files_parse_passwd() or files_parse_group() gives for a line of /etc,
+ * so that both sources are printed and copied by the same code
+ */
+extern void dbfile_passwd_view(const dbrecord_t *rec, passwd_view_t *pwd);
+extern void dbfile_group_view(const dbrecord_t *rec, group_view_t *grp);
+
+#endif
@@ -0,0 +1,990 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns.h"
+#include "getent.h"
+#include "stats.h"
+
+#define DNS_PORT "53"
+#define DNS_HEADER_SIZE 12
+#define DNS_UDP_MAX 512
+#define DNS_TCP_MAX 65535
+#define DNS_CNAME_MAX 16
+#define DNS_QUERIES_MAX 3 /* A, AAAA and PTR */
+
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_TC 0x0200
+#define DNS_FLAG_RD 0x0100
+#define DNS_RCODE(flags) ((flags)&0x000f)
+
+enum { DNS_TYPE_A = 1,
+       DNS_TYPE_CNAME = 5,
+       DNS_TYPE_PTR = 12,
+       DNS_TYPE_AAAA = 28,
+       DNS_CLASS_IN = 1,
+};
+enum { DNS_RCODE_NOERROR = 0, DNS_RCODE_NXDOMAIN = 3 };
+
+/**
+ * What a reply, or the lack of one, told us about a query
+ */
+enum { REPLY_IGNORE, REPLY_RETRY, REPLY_POSITIVE, REPLY_NEGATIVE, REPLY_FAILED };
+
+enum { QUERY_IDLE, QUERY_SENT, QUERY_TCP, QUERY_DONE };
+
+/**
+ * Stages of asking again over TCP
+ */
+enum { TCP_SEND, TCP_LENGTH, TCP_REPLY };
+
+typedef struct dns_query {
+        uint16_t id;
+        uint16_t type;
+        int state;
+        int outcome;      /**< REPLY_* once done */
+        int sent;         /**< Transmissions so far */
+        int ns;           /**< Nameserver of the last transmission */
+        int64_t deadline; /**< When to give up on the last transmission, in ms */
+        /* While QUERY_TCP */
+        int tcp_fd;
+        int tcp_stage;          /**< TCP_* */
+        unsigned char *tcp_buf; /**< Query being sent, then the reply being read */
+        size_t tcp_len;         /**< Bytes to transfer in this stage */
+        size_t tcp_done;        /**< Bytes transferred so far */
+} dns_query_t;
+
+typedef struct dns_lookup {
+        const char *name;            /**< Key as given */
+        char fqdn[DNS_NAME_MAX + 1]; /**< Name being asked for */
+        int candidate;               /**< Position in the search order */
+        dns_query_t queries[DNS_QUERIES_MAX];
+        int query_cnt;
+} dns_lookup_t;
+
+typedef struct dns_ctx {
+        const dns_conf_t *conf;
+        int want;
+        dns_lookup_t *lookups;
+        dns_result_t *results;
+        int fds[2];                /**< UDP sockets, IPv4 then IPv6 */
+        int32_t *ids;              /**< Lookup * DNS_QUERIES_MAX + query + 1 by ID */
+        int active[DNS_WINDOW];    /**< Lookups with queries in flight */
+        int active_cnt;
+} dns_ctx_t;
+
+static void put16(unsigned char *p, uint16_t v)
+{
+        p[0] = (unsigned char)(v >> 8);
+        p[1] = (unsigned char)v;
+}
+
+static uint16_t get16(const unsigned char *p)
+{
+        return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static int64_t now_ms(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void add_nameserver(dns_conf_t *conf, const char *addr)
+{
+        struct addrinfo hints = {
+                .ai_flags = AI_NUMERICHOST | AI_NUMERICSERV,
+                .ai_socktype = SOCK_DGRAM,
+        };
+        struct addrinfo *info = NULL;
+
+        if (conf->ns_cnt == DNS_NAMESERVERS_MAX)
+                return;
+        if (getaddrinfo(addr, DNS_PORT, &hints, &info) != 0)
+                return;
+        if (info->ai_addrlen <= sizeof(struct sockaddr_storage)) {
+                memcpy(&conf->ns[conf->ns_cnt], info->ai_addr, info->ai_addrlen);
+                conf->ns_len[conf->ns_cnt++] = info->ai_addrlen;
+        }
+        freeaddrinfo(info);
+}
+
+static int option_value(const char *word, const char *name, int value, int max)
+{
+        size_t len = strlen(name);
+        int v = 0;
+
+        if (strncmp(word, name, len) != 0 || word[len] != ':')
+                return value;
+        v = atoi(word + len + 1);
+        if (v < 0)
+                return value;
+        return v > max ? max : v;
+}
+
+void dns_load_conf(const char *path, dns_conf_t *conf)
+{
+        static const char *seps = " \t\r\n";
+        char *line = NULL;
+        size_t line_size = 0;
+        FILE *fp = NULL;
+
+        memset(conf, 0, sizeof(dns_conf_t));
+        conf->ndots = 1;
+        conf->timeout = 5;
+        conf->attempts = 2;
+
+        fp = fopen(path, "re");
+        while (fp != NULL && getline(&line, &line_size, fp) != -1) {
+                char *save = NULL;
+                char *word = strtok_r(line, seps, &save);
+
+                if (word == NULL || *word == '#' || *word == ';')
+                        continue;
+                if (strcmp(word, "nameserver") == 0) {
+                        word = strtok_r(NULL, seps, &save);
+                        if (word != NULL)
+                                add_nameserver(conf, word);
+                } else if (strcmp(word, "domain") == 0 || strcmp(word, "search") == 0) {
+                        /* Whichever comes last wins */
+                        conf->search_cnt = 0;
+                        while ((word = strtok_r(NULL, seps, &save)) != NULL &&
+                               conf->search_cnt < DNS_SEARCH_MAX) {
+                                size_t len = strlen(word);
+
+                                if (len > 0 && word[len - 1] == '.')
+                                        word[--len] = '\0';
+                                if (len == 0 || len > DNS_NAME_MAX)
+                                        continue;
+                                memcpy(conf->search[conf->search_cnt++], word, len + 1);
+                        }
+                } else if (strcmp(word, "options") == 0) {
+                        while ((word = strtok_r(NULL, seps, &save)) != NULL) {
+                                conf->ndots = option_value(word, "ndots", conf->ndots, 15);
+                                conf->timeout = option_value(word, "timeout", conf->timeout, 30);
+                                conf->attempts = option_value(word, "attempts", conf->attempts, 5);
+                        }
+                }
+        }
+        if (fp != NULL)
+                fclose(fp);
+        free(line);
+
+        if (conf->ns_cnt == 0)
+                add_nameserver(conf, "127.0.0.1");
+        if (conf->timeout == 0)
+                conf->timeout = 1;
+        if (conf->attempts == 0)
+                conf->attempts = 1;
+}
+
+/**
+ * Work out the name to ask for on the @candidate'th try of @name, in the
+ * same order as libc: names with at least ndots dots are tried as they
+ * are first, others go through the search list first.
+ */
+static bool candidate_name(const dns_conf_t *conf, const char *name, int candidate, char *buf)
+{
+        size_t len = strlen(name);
+        const char *domain = NULL;
+        int dots = 0;
+        bool as_is_first = false;
+
+        if (len > 0 && name[len - 1] == '.') {
+                if (candidate > 0 || len - 1 > DNS_NAME_MAX)
+                        return false;
+                memcpy(buf, name, len - 1);
+                buf[len - 1] = '\0';
+                return true;
+        }
+
+        for (const char *p = name; *p != '\0'; p++)
+                if (*p == '.')
+                        dots++;
+        as_is_first = dots >= conf->ndots;
+        if (as_is_first)
+                candidate--;
+        if (candidate == (as_is_first ? -1 : conf->search_cnt))
+                domain = NULL;
+        else if (candidate >= 0 && candidate < conf->search_cnt)
+                domain = conf->search[candidate];
+        else
+                return false;
+
+        /* A name too long to ask for is left empty and fails to encode */
+        buf[0] = '\0';
+        if (domain == NULL && len <= DNS_NAME_MAX) {
+                memcpy(buf, name, len + 1);
+        } else if (domain != NULL && len + 1 + strlen(domain) <= DNS_NAME_MAX) {
+                memcpy(buf, name, len);
+                buf[len] = '.';
+                memcpy(buf + len + 1, domain, strlen(domain) + 1);
+        }
+        return true;
+}
+
+/**
+ * Write @name in wire format. Returns its length, or 0 for names that
+ * cannot be asked for.
+ */
+static size_t encode_name(const char *name, unsigned char *out)
+{
+        size_t pos = 0;
+
+        while (*name != '\0') {
+                const char *dot = strchrnul(name, '.');
+                size_t len = (size_t)(dot - name);
+
+                if (len == 0 || len > 63 || pos + len + 2 > DNS_NAME_MAX + 2)
+                        return 0;
+                out[pos++] = (unsigned char)len;
+                memcpy(out + pos, name, len);
+                pos += len;
+                name = *dot != '\0' ? dot + 1 : dot;
+        }
+        if (pos == 0)
+                return 0;
+        out[pos++] = 0;
+        return pos;
+}
+
+static size_t build_query(const char *name, uint16_t id, uint16_t type, unsigned char *buf)
+{
+        size_t len = encode_name(name, buf + DNS_HEADER_SIZE);
+
+        if (len == 0)
+                return 0;
+        memset(buf, 0, DNS_HEADER_SIZE);
+        put16(buf, id);
+        put16(buf + 2, DNS_FLAG_RD);
+        put16(buf + 4, 1);
+        put16(buf + DNS_HEADER_SIZE + len, type);
+        put16(buf + DNS_HEADER_SIZE + len + 2, DNS_CLASS_IN);
+        return DNS_HEADER_SIZE + len + 4;
+}
+
+/**
+ * Expand the possibly compressed name at @pos of @msg into @out.
+ * Returns the offset following the name, or 0 if it is malformed.
+ */
+static size_t read_name(const unsigned char *msg, size_t len, size_t pos, char *out)
+{
+        size_t next = 0;
+        size_t out_len = 0;
+        int jumps = 0;
+
+        for (;;) {
+                unsigned char c = 0;
+
+                if (pos >= len)
+                        return 0;
+                c = msg[pos];
+                if (c == 0) {
+                        pos++;
+                        break;
+                }
+                if ((c & 0xc0) == 0xc0) {
+                        if (pos + 1 >= len || ++jumps > DNS_CNAME_MAX * 4)
+                                return 0;
+                        if (next == 0)
+                                next = pos + 2;
+                        pos = (size_t)(c & 0x3f) << 8 | msg[pos + 1];
+                        continue;
+                }
+                if ((c & 0xc0) != 0 || pos + 1 + c > len)
+                        return 0;
+                if (out_len + (out_len > 0) + c > DNS_NAME_MAX)
+                        return 0;
+                if (out_len > 0)
+                        out[out_len++] = '.';
+                memcpy(out + out_len, msg + pos + 1, c);
+                out_len += c;
+                pos += 1 + (size_t)c;
+        }
+        out[out_len] = '\0';
+        return next != 0 ? next : pos;
+}
+
+typedef struct dns_rr {
+        char owner[DNS_NAME_MAX + 1];
+        uint16_t type;
+        uint16_t class;
+        uint16_t rdlen;
+        size_t rdata; /**< Offset of the record data */
+} dns_rr_t;
+
+static size_t read_rr(const unsigned char *msg, size_t len, size_t pos, dns_rr_t *rr)
+{
+        pos = read_name(msg, len, pos, rr->owner);
+        if (pos == 0 || pos + 10 > len)
+                return 0;
+        rr->type = get16(msg + pos);
+        rr->class = get16(msg + pos + 2);
+        rr->rdlen = get16(msg + pos + 8);
+        rr->rdata = pos + 10;
+        if (rr->rdata + rr->rdlen > len)
+                return 0;
+        stats_read(1, 0);
+        return rr->rdata + rr->rdlen;
+}
+
+static void add_address(dns_result_t *result, int family, const void *addr, size_t len)
+{
+        dns_addr_t *grown = realloc(result->addrs, (result->addr_cnt + 1) * sizeof(dns_addr_t));
+
+        if (grown == NULL)
+                err("Out of memory\n");
+        result->addrs = grown;
+        result->addrs[result->addr_cnt].family = family;
+        memcpy(result->addrs[result->addr_cnt].addr, addr, len);
+        result->addr_cnt++;
+}
+
+/**
+ * Check that @msg answers @query of @lookup and collect its addresses, or
+ * the name it points to, following CNAMEs from the name asked for.
+ */
+static int parse_reply(const dns_lookup_t *lookup, const dns_query_t *query,
+                       const unsigned char *msg, size_t len, dns_result_t *result)
+{
+        char name[DNS_NAME_MAX + 1];
+        char target[DNS_NAME_MAX + 1];
+        const char *canon = target;
+        uint16_t flags = 0;
+        uint16_t ancount = 0;
+        size_t answers = 0;
+        size_t pos = 0;
+        bool changed = true;
+        bool positive = false;
+        dns_rr_t rr;
+
+        if (len < DNS_HEADER_SIZE || get16(msg + 4) != 1)
+                return REPLY_IGNORE;
+        flags = get16(msg + 2);
+        ancount = get16(msg + 6);
+
+        pos = read_name(msg, len, DNS_HEADER_SIZE, name);
+        if (pos == 0 || pos + 4 > len || strcasecmp(name, lookup->fqdn) != 0 ||
+            get16(msg + pos) != query->type || get16(msg + pos + 2) != DNS_CLASS_IN)
+                return REPLY_IGNORE;
+        answers = pos + 4;
+
+        if (DNS_RCODE(flags) == DNS_RCODE_NXDOMAIN)
+                return REPLY_NEGATIVE;
+        if (DNS_RCODE(flags) != DNS_RCODE_NOERROR)
+                return REPLY_RETRY;
+
+        /* Check every record up front so that nothing is kept from a broken reply */
+        pos = answers;
+        for (uint16_t i = 0; i < ancount; i++)
+                if ((pos = read_rr(msg, len, pos, &rr)) == 0)
+                        return REPLY_RETRY;
+
+        /* Records may come in any order, walk the CNAME chain to its end first */
+        memcpy(target, lookup->fqdn, sizeof(target));
+        for (int hops = 0; changed && hops < DNS_CNAME_MAX; hops++) {
+                changed = false;
+                pos = answers;
+                for (uint16_t i = 0; i < ancount; i++) {
+                        pos = read_rr(msg, len, pos, &rr);
+                        if (rr.type != DNS_TYPE_CNAME || rr.class != DNS_CLASS_IN ||
+                            strcasecmp(rr.owner, target) != 0)
+                                continue;
+                        if (read_name(msg, len, rr.rdata, target) == 0)
+                                return REPLY_RETRY;
+                        changed = true;
+                        break;
+                }
+        }
+
+        pos = answers;
+        for (uint16_t i = 0; i < ancount; i++) {
+                pos = read_rr(msg, len, pos, &rr);
+                if (rr.type != query->type || rr.class != DNS_CLASS_IN ||
+                    strcasecmp(rr.owner, target) != 0)
+                        continue;
+                if (rr.type == DNS_TYPE_A && rr.rdlen == 4)
+                        add_address(result, AF_INET, msg + rr.rdata, 4);
+                else if (rr.type == DNS_TYPE_AAAA && rr.rdlen == 16)
+                        add_address(result, AF_INET6, msg + rr.rdata, 16);
+                else if (rr.type == DNS_TYPE_PTR && !positive &&
+                         read_name(msg, len, rr.rdata, name) != 0)
+                        canon = name;
+                else
+                        continue;
+                positive = true;
+        }
+        if (!positive)
+                return REPLY_NEGATIVE;
+
+        if (!result->found)
+                memcpy(result->canon, canon, sizeof(result->canon));
+        result->found = true;
+        return REPLY_POSITIVE;
+}
+
+static bool same_address(const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+        if (a->ss_family != b->ss_family)
+                return false;
+        if (a->ss_family == AF_INET) {
+                const struct sockaddr_in *x = (const struct sockaddr_in *)a;
+                const struct sockaddr_in *y = (const struct sockaddr_in *)b;
+
+                return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
+        }
+        if (a->ss_family == AF_INET6) {
+                const struct sockaddr_in6 *x = (const struct sockaddr_in6 *)a;
+                const struct sockaddr_in6 *y = (const struct sockaddr_in6 *)b;
+
+                return x->sin6_port == y->sin6_port &&
+                       memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(struct in6_addr)) == 0;
+        }
+        return false;
+}
+
+static int udp_socket(dns_ctx_t *ctx, int family)
+{
+        int *fd = &ctx->fds[family == AF_INET6 ? 1 : 0];
+
+        if (*fd < 0)
+                *fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        return *fd;
+}
+
+static void send_query(dns_ctx_t *ctx, dns_lookup_t *lookup, dns_query_t *query)
+{
+        const dns_conf_t *conf = ctx->conf;
+        unsigned char packet[DNS_UDP_MAX];
+        size_t len = build_query(lookup->fqdn, query->id, query->type, packet);
+        int ns = query->sent % conf->ns_cnt;
+        int fd = udp_socket(ctx, conf->ns[ns].ss_family);
+
+        query->ns = ns;
+        query->sent++;
+        query->state = QUERY_SENT;
+        query->deadline = now_ms() + conf->timeout * 1000;
+        /* A failed send is treated like a lost packet */
+        if (fd >= 0)
+                (void)sendto(fd, packet, len, 0, (const struct sockaddr *)&conf->ns[ns],
+                             conf->ns_len[ns]);
+}
+
+static uint16_t allocate_id(dns_ctx_t *ctx, int32_t tag)
+{
+        uint16_t id = 0;
+
+        do {
+                if (getrandom(&id, sizeof(id), 0) != sizeof(id))
+                        id = (uint16_t)(id * 31421U + 6927U);
+        } while (ctx->ids[id] != 0);
+        ctx->ids[id] = tag;
+        return id;
+}
+
+static void finish_query(dns_ctx_t *ctx, dns_query_t *query, int outcome)
+{
+        ctx->ids[query->id] = 0;
+        query->state = QUERY_DONE;
+        query->outcome = outcome;
+}
+
+/**
+ * Ask @query again over TCP after a truncated reply. The exchange is
+ * driven by the poll loop through tcp_progress(), so the other queries
+ * carry on meanwhile. Returns false if no connection could be started.
+ */
+static bool start_tcp(const dns_ctx_t *ctx, const dns_lookup_t *lookup, dns_query_t *query)
+{
+        const dns_conf_t *conf = ctx->conf;
+        const struct sockaddr_storage *ns = &conf->ns[query->ns];
+        unsigned char *buf = malloc(2 + DNS_TCP_MAX);
+        size_t len = buf != NULL ? build_query(lookup->fqdn, query->id, query->type, buf + 2) : 0;
+        int fd = -1;
+
+        if (len > 0)
+                fd = socket(ns->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (const struct sockaddr *)ns, conf->ns_len[query->ns]) != 0 &&
+            errno != EINPROGRESS) {
+                close(fd);
+                fd = -1;
+        }
+        if (fd < 0) {
+                free(buf);
+                return false;
+        }
+
+        put16(buf, (uint16_t)len);
+        query->state = QUERY_TCP;
+        query->deadline = now_ms() + conf->timeout * 1000;
+        query->tcp_fd = fd;
+        query->tcp_stage = TCP_SEND;
+        query->tcp_buf = buf;
+        query->tcp_len = len + 2;
+        query->tcp_done = 0;
+        return true;
+}
+
+static void close_tcp(dns_query_t *query)
+{
+        close(query->tcp_fd);
+        free(query->tcp_buf);
+        query->tcp_buf = NULL;
+        query->state = QUERY_SENT;
+}
+
+/**
+ * Send queries for the current candidate name of lookup @i. Returns false
+ * when the name cannot be asked for.
+ */
+static bool start_candidate(dns_ctx_t *ctx, int i)
+{
+        dns_lookup_t *lookup = &ctx->lookups[i];
+        unsigned char scratch[DNS_NAME_MAX + 2];
+
+        if (encode_name(lookup->fqdn, scratch) == 0)
+                return false;
+        for (int q = 0; q < lookup->query_cnt; q++) {
+                dns_query_t *query = &lookup->queries[q];
+
+                query->id = allocate_id(ctx, i * DNS_QUERIES_MAX + q + 1);
+                query->state = QUERY_IDLE;
+                query->sent = 0;
+                send_query(ctx, lookup, query);
+        }
+        return true;
+}
+
+static void deactivate(dns_ctx_t *ctx, int i)
+{
+        for (int a = 0; a < ctx->active_cnt; a++) {
+                if (ctx->active[a] != i)
+                        continue;
+                ctx->active[a] = ctx->active[--ctx->active_cnt];
+                return;
+        }
+}
+
+/**
+ * Move on to the next candidate name of lookup @i, or finish it
+ */
+static void next_candidate(dns_ctx_t *ctx, int i)
+{
+        dns_lookup_t *lookup = &ctx->lookups[i];
+
+        while (candidate_name(ctx->conf, lookup->name, ++lookup->candidate, lookup->fqdn))
+                if (start_candidate(ctx, i))
+                        return;
+        deactivate(ctx, i);
+}
+
+/**
+ * Decide what to do with lookup @i once all of its queries are answered
+ */
+static void lookup_progress(dns_ctx_t *ctx, int i)
+{
+        dns_lookup_t *lookup = &ctx->lookups[i];
+        bool failed = false;
+
+        for (int q = 0; q < lookup->query_cnt; q++) {
+                if (lookup->queries[q].state != QUERY_DONE)
+                        return;
+                failed |= lookup->queries[q].outcome == REPLY_FAILED;
+        }
+
+        /* Move on down the search list only when every query came back negative */
+        if (ctx->results[i].found || failed)
+                deactivate(ctx, i);
+        else
+                next_candidate(ctx, i);
+}
+
+static bool literal_address(dns_ctx_t *ctx, int i)
+{
+        dns_result_t *result = &ctx->results[i];
+        const char *name = ctx->lookups[i].name;
+        unsigned char addr[16];
+
+        if (inet_pton(AF_INET, name, addr) == 1) {
+                if (ctx->want & DNS_WANT_A)
+                        add_address(result, AF_INET, addr, 4);
+        } else if (inet_pton(AF_INET6, name, addr) == 1) {
+                if (ctx->want & DNS_WANT_AAAA)
+                        add_address(result, AF_INET6, addr, 16);
+        } else
+                return false;
+
+        if (result->addr_cnt > 0) {
+                snprintf(result->canon, sizeof(result->canon), "%s", name);
+                result->found = true;
+        }
+        return true;
+}
+
+static void start_lookup(dns_ctx_t *ctx, int i)
+{
+        dns_lookup_t *lookup = &ctx->lookups[i];
+
+        if (literal_address(ctx, i))
+                return;
+
+        if (ctx->want & DNS_WANT_A)
+                lookup->queries[lookup->query_cnt++].type = DNS_TYPE_A;
+        if (ctx->want & DNS_WANT_AAAA)
+                lookup->queries[lookup->query_cnt++].type = DNS_TYPE_AAAA;
+        if (ctx->want & DNS_WANT_PTR)
+                lookup->queries[lookup->query_cnt++].type = DNS_TYPE_PTR;
+
+        ctx->active[ctx->active_cnt++] = i;
+        lookup->candidate = -1;
+        next_candidate(ctx, i);
+}
+
+/**
+ * Act on what a reply, or the lack of one, told us about @query of lookup
+ * @i: send it again, or settle it and see whether the lookup is done
+ */
+static void settle_query(dns_ctx_t *ctx, int i, dns_query_t *query, int outcome)
+{
+        const dns_conf_t *conf = ctx->conf;
+
+        switch (outcome) {
+        case REPLY_IGNORE:
+                return;
+        case REPLY_RETRY:
+                if (query->sent < conf->attempts * conf->ns_cnt) {
+                        send_query(ctx, &ctx->lookups[i], query);
+                        return;
+                }
+                finish_query(ctx, query, REPLY_FAILED);
+                break;
+        default:
+                finish_query(ctx, query, outcome);
+                break;
+        }
+        lookup_progress(ctx, i);
+}
+
+/**
+ * Move the TCP exchange of @query of lookup @i along as far as its socket
+ * allows, settling the query once the reply is in or the connection fails
+ */
+static void tcp_progress(dns_ctx_t *ctx, int i, dns_query_t *query)
+{
+        int outcome = REPLY_RETRY;
+
+        for (;;) {
+                unsigned char *p = query->tcp_buf + query->tcp_done;
+                size_t left = query->tcp_len - query->tcp_done;
+                ssize_t r = 0;
+
+                if (query->tcp_stage == TCP_SEND)
+                        r = send(query->tcp_fd, p, left, MSG_NOSIGNAL);
+                else
+                        r = recv(query->tcp_fd, p, left, 0);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r < 0 && errno == EAGAIN)
+                        return;
+                if (r <= 0)
+                        break;
+                if (query->tcp_stage != TCP_SEND)
+                        stats_read(0, (size_t)r);
+                query->tcp_done += (size_t)r;
+                if (query->tcp_done < query->tcp_len)
+                        continue;
+
+                query->tcp_done = 0;
+                if (query->tcp_stage == TCP_SEND) {
+                        query->tcp_stage = TCP_LENGTH;
+                        query->tcp_len = 2;
+                } else if (query->tcp_stage == TCP_LENGTH) {
+                        query->tcp_stage = TCP_REPLY;
+                        query->tcp_len = get16(query->tcp_buf);
+                        if (query->tcp_len < DNS_HEADER_SIZE)
+                                break;
+                } else {
+                        if (get16(query->tcp_buf) == query->id)
+                                outcome = parse_reply(&ctx->lookups[i], query, query->tcp_buf,
+                                                      query->tcp_len, &ctx->results[i]);
+                        break;
+                }
+        }
+        close_tcp(query);
+        settle_query(ctx, i, query, outcome);
+}
+
+static void handle_reply(dns_ctx_t *ctx, unsigned char *msg, size_t len,
+                         const struct sockaddr_storage *from)
+{
+        const dns_conf_t *conf = ctx->conf;
+        dns_lookup_t *lookup = NULL;
+        dns_query_t *query = NULL;
+        int32_t tag = 0;
+        int outcome = REPLY_IGNORE;
+        bool known = false;
+        int i = 0;
+
+        if (len < DNS_HEADER_SIZE || (get16(msg + 2) & DNS_FLAG_QR) == 0)
+                return;
+        tag = ctx->ids[get16(msg)];
+        if (tag == 0)
+                return;
+        for (int ns = 0; ns < conf->ns_cnt && !known; ns++)
+                known = same_address(from, &conf->ns[ns]);
+        if (!known)
+                return;
+
+        i = (tag - 1) / DNS_QUERIES_MAX;
+        lookup = &ctx->lookups[i];
+        query = &lookup->queries[(tag - 1) % DNS_QUERIES_MAX];
+        if (query->state != QUERY_SENT)
+                return;
+
+        if (get16(msg + 2) & DNS_FLAG_TC) {
+                if (start_tcp(ctx, lookup, query))
+                        return;
+                outcome = REPLY_RETRY;
+        } else {
+                outcome = parse_reply(lookup, query, msg, len, &ctx->results[i]);
+        }
+        settle_query(ctx, i, query, outcome);
+}
+
+static void receive_replies(dns_ctx_t *ctx, int fd)
+{
+        unsigned char msg[DNS_UDP_MAX];
+
+        for (;;) {
+                struct sockaddr_storage from;
+                socklen_t from_len = sizeof(from);
+                ssize_t r = recvfrom(fd, msg, sizeof(msg), 0, (struct sockaddr *)&from, &from_len);
+
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r < 0)
+                        return;
+                stats_read(0, (size_t)r);
+                handle_reply(ctx, msg, (size_t)r, &from);
+        }
+}
+
+/**
+ * Send queries again once they time out, giving up after every
+ * nameserver had its attempts
+ */
+static void expire_queries(dns_ctx_t *ctx, int64_t now)
+{
+        const dns_conf_t *conf = ctx->conf;
+
+        /* Lookups may leave the active list as we go, walk it backwards */
+        for (int a = ctx->active_cnt - 1; a >= 0; a--) {
+                int i = ctx->active[a];
+                dns_lookup_t *lookup = &ctx->lookups[i];
+                bool finished = false;
+
+                for (int q = 0; q < lookup->query_cnt; q++) {
+                        dns_query_t *query = &lookup->queries[q];
+
+                        if ((query->state != QUERY_SENT && query->state != QUERY_TCP) ||
+                            query->deadline > now)
+                                continue;
+                        if (query->state == QUERY_TCP)
+                                close_tcp(query);
+                        if (query->sent < conf->attempts * conf->ns_cnt) {
+                                send_query(ctx, lookup, query);
+                                continue;
+                        }
+                        finish_query(ctx, query, REPLY_FAILED);
+                        finished = true;
+                }
+                if (finished)
+                        lookup_progress(ctx, i);
+        }
+}
+
+static int next_timeout(const dns_ctx_t *ctx, int64_t now)
+{
+        int64_t first = INT64_MAX;
+
+        for (int a = 0; a < ctx->active_cnt; a++) {
+                const dns_lookup_t *lookup = &ctx->lookups[ctx->active[a]];
+
+                for (int q = 0; q < lookup->query_cnt; q++)
+                        if ((lookup->queries[q].state == QUERY_SENT ||
+                             lookup->queries[q].state == QUERY_TCP) &&
+                            lookup->queries[q].deadline < first)
+                                first = lookup->queries[q].deadline;
+        }
+        if (first == INT64_MAX)
+                return 0;
+        return first > now ? (int)(first - now) : 0;
+}
+
+void dns_resolve(const dns_conf_t *conf, const char **names, int cnt, int want,
+                 dns_result_t *results)
+{
+        dns_ctx_t ctx = {
+                .conf = conf,
+                .want = want,
+                .results = results,
+                .fds = { -1, -1 },
+                .active_cnt = 0,
+        };
+        int next = 0;
+
+        memset(results, 0, (size_t)cnt * sizeof(dns_result_t));
+        ctx.lookups = calloc((size_t)cnt, sizeof(dns_lookup_t));
+        ctx.ids = calloc(UINT16_MAX + 1, sizeof(int32_t));
+        if (ctx.lookups == NULL || ctx.ids == NULL)
+                err("Out of memory\n");
+        for (int i = 0; i < cnt; i++)
+                ctx.lookups[i].name = names[i];
+
+        while (next < cnt || ctx.active_cnt > 0) {
+                struct pollfd pfds[2 + DNS_WINDOW * DNS_QUERIES_MAX];
+                int tcp_tags[DNS_WINDOW * DNS_QUERIES_MAX];
+                nfds_t udp_cnt = 0;
+                nfds_t pfd_cnt = 0;
+
+                while (ctx.active_cnt < DNS_WINDOW && next < cnt)
+                        start_lookup(&ctx, next++);
+                if (ctx.active_cnt == 0)
+                        continue;
+
+                for (int f = 0; f < 2; f++) {
+                        if (ctx.fds[f] < 0)
+                                continue;
+                        pfds[pfd_cnt].fd = ctx.fds[f];
+                        pfds[pfd_cnt].events = POLLIN;
+                        pfds[pfd_cnt++].revents = 0;
+                }
+                udp_cnt = pfd_cnt;
+                for (int a = 0; a < ctx.active_cnt; a++) {
+                        const dns_lookup_t *lookup = &ctx.lookups[ctx.active[a]];
+
+                        for (int q = 0; q < lookup->query_cnt; q++) {
+                                const dns_query_t *query = &lookup->queries[q];
+
+                                if (query->state != QUERY_TCP)
+                                        continue;
+                                tcp_tags[pfd_cnt - udp_cnt] = ctx.active[a] * DNS_QUERIES_MAX + q;
+                                pfds[pfd_cnt].fd = query->tcp_fd;
+                                pfds[pfd_cnt].events = query->tcp_stage == TCP_SEND ? POLLOUT
+                                                                                    : POLLIN;
+                                pfds[pfd_cnt++].revents = 0;
+                        }
+                }
+                if (poll(pfds, pfd_cnt, next_timeout(&ctx, now_ms())) < 0 && errno != EINTR)
+                        break;
+                for (nfds_t p = 0; p < udp_cnt; p++)
+                        if (pfds[p].revents & POLLIN)
+                                receive_replies(&ctx, pfds[p].fd);
+                for (nfds_t p = udp_cnt; p < pfd_cnt; p++) {
+                        int tag = tcp_tags[p - udp_cnt];
+                        dns_query_t *query =
+                            &ctx.lookups[tag / DNS_QUERIES_MAX].queries[tag % DNS_QUERIES_MAX];
+
+                        /* Replies handled above may have moved the query on */
+                        if (pfds[p].revents != 0 && query->state == QUERY_TCP &&
+                            query->tcp_fd == pfds[p].fd)
+                                tcp_progress(&ctx, tag / DNS_QUERIES_MAX, query);
+                }
+                expire_queries(&ctx, now_ms());
+        }
+
+        for (int i = 0; i < cnt; i++)
+                for (int q = 0; q < ctx.lookups[i].query_cnt; q++)
+                        if (ctx.lookups[i].queries[q].state == QUERY_TCP)
+                                close_tcp(&ctx.lookups[i].queries[q]);
+
+        for (int f = 0; f < 2; f++)
+                if (ctx.fds[f] >= 0)
+                        close(ctx.fds[f]);
+        free(ctx.ids);
+        free(ctx.lookups);
+}
+
+void dns_reverse_name(const dns_addr_t *addr, char *buf)
+{
+        static const char hex[] = "0123456789abcdef";
+        size_t pos = 0;
+
+        if (addr->family == AF_INET) {
+                snprintf(buf,
+                         DNS_NAME_MAX + 1,
+                         "%u.%u.%u.%u.in-addr.arpa.",
+                         addr->addr[3],
+                         addr->addr[2],
+                         addr->addr[1],
+                         addr->addr[0]);
+                return;
+        }
+        for (int i = 15; i >= 0; i--) {
+                buf[pos++] = hex[addr->addr[i] & 0xf];
+                buf[pos++] = '.';
+                buf[pos++] = hex[addr->addr[i] >> 4];
+                buf[pos++] = '.';
+        }
+        memcpy(buf + pos, "ip6.arpa.", sizeof("ip6.arpa."));
+}
+
+void dns_results_free(dns_result_t *results, int cnt)
+{
+        for (int i = 0; i < cnt; i++) {
+                free(results[i].addrs);
+                results[i].addrs = NULL;
+                results[i].addr_cnt = 0;
+        }
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,78 @@
+#ifndef GETENT_DNS_H
+#define GETENT_DNS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+/**
+ * Built-in stub resolver behind "-s dns".
+ *
+ * All keys of a lookup are resolved together: queries for up to
+ * DNS_WINDOW names are kept in flight on one socket per address family,
+ * replies are matched back by their ID, and lost queries are sent again to
+ * the next nameserver once they time out. A truncated reply is asked for
+ * again over TCP.
+ *
+ * Nameservers, the search list and the ndots, timeout and attempts options
+ * come from resolv.conf(5), with the same defaults as libc.
+ */
+#define DNS_RESOLV_CONF "/etc/resolv.conf"
+#define DNS_NAME_MAX 253
+#define DNS_NAMESERVERS_MAX 3
+#define DNS_SEARCH_MAX 6
+#define DNS_WINDOW 64
+
+/**
+ * Record types to ask for, combined
+ */
+enum { DNS_WANT_A = 1 << 0, DNS_WANT_AAAA = 1 << 1, DNS_WANT_PTR = 1 << 2 };
+
+typedef struct dns_conf {
+        struct sockaddr_storage ns[DNS_NAMESERVERS_MAX];
+        socklen_t ns_len[DNS_NAMESERVERS_MAX];
+        int ns_cnt;
+        char search[DNS_SEARCH_MAX][DNS_NAME_MAX + 1];
+        int search_cnt;
+        int ndots;
+        int timeout;  /**< Seconds to wait for a reply */
+        int attempts; /**< Times every nameserver is tried */
+} dns_conf_t;
+
+typedef struct dns_addr {
+        int family;              /**< AF_INET or AF_INET6 */
+        unsigned char addr[16];  /**< Address in network byte order */
+} dns_addr_t;
+
+typedef struct dns_result {
+        bool found;
+        /** Name the addresses belong to after CNAMEs, or the name a PTR points to */
+        char canon[DNS_NAME_MAX + 1];
+        dns_addr_t *addrs; /**< Addresses, in the order they were answered */
+        size_t addr_cnt;
+} dns_result_t;
+
+/**
+ * Read the resolver configuration from @path. A missing file gives the
+ * libc defaults: the local nameserver and no search list.
+ */
+extern void dns_load_conf(const char *path, dns_conf_t *conf);
+
+/**
+ * Resolve @names, asking for the record types in @want. Results are
+ * stored at the same position in @results, which must hold @cnt entries
+ * and be released with dns_results_free. Names that could not be
+ * resolved, for whatever reason, are left with found unset.
+ */
+extern void dns_resolve(const dns_conf_t *conf, const char **names, int cnt, int want,
+                        dns_result_t *results);
+
+extern void dns_results_free(dns_result_t *results, int cnt);
+
+/**
+ * Write the in-addr.arpa or ip6.arpa name of @addr to @buf, which must
+ * hold DNS_NAME_MAX + 1 bytes
+ */
+extern void dns_reverse_name(const dns_addr_t *addr, char *buf);
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "files.h"
+#include "getent.h"
+#include "keyset.h"
+#include "stats.h"
+
+bool files_map(const char *path, files_map_t *map)
+{
+        char rooted[PATH_MAX];
+        struct stat st;
+        void *data = NULL;
+        int fd = -1;
+
+        memset(map, 0, sizeof(files_map_t));
+
+        fd = open(root_path(path, rooted, sizeof(rooted)), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+        if (fstat(fd, &st) != 0) {
+                close(fd);
+                return false;
+        }
+        if (!S_ISREG(st.st_mode)) {
+                close(fd);
+                errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+                return false;
+        }
+        if (st.st_size > 0) {
+                data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED) {
+                        close(fd);
+                        return false;
+                }
+                madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+                map->data = data;
+                map->size = (size_t)st.st_size;
+        }
+        map->st = st;
+        close(fd);
+        return true;
+}
+
+void files_unmap(files_map_t *map)
+{
+        if (map->data != NULL)
+                munmap((void *)map->data, map->size);
+        map->data = NULL;
+        map->size = 0;
+}
+
+bool files_next(const files_map_t *map, size_t *pos, const char **record, size_t *len)
+{
+        while (*pos < map->size) {
+                const char *line = map->data + *pos;
+                const char *end = memchr(line, '\n', map->size - *pos);
+                size_t line_len = end != NULL ? (size_t)(end - line) : map->size - *pos;
+
+                *pos += line_len + 1;
+                stats_read(0, line_len + 1);
+                if (line_len == 0 || *line == '#' || *line == '+' || *line == '-' || *line == ':')
+                        continue;
+                stats_read(1, 0);
+                *record = line;
+                *len = line_len;
+                return true;
+        }
+        return false;
+}
+
+/**
+ * Split @record at colons into at most @max fields, the last one running
+ * to the end of the record as libc does. Returns the number of fields found.
+ */
+static int split_fields(const char *record, size_t len, strview_t *fields, int max)
+{
+        const char *end = record + len;
+        int cnt = 0;
+
+        for (;;) {
+                const char *sep = NULL;
+
+                if (cnt + 1 < max)
+                        sep = memchr(record, ':', (size_t)(end - record));
+                fields[cnt].data = record;
+                fields[cnt].len = (int)((sep != NULL ? sep : end) - record);
+                cnt++;
+                if (sep == NULL)
+                        return cnt;
+                record = sep + 1;
+        }
+}
+
+static bool parse_id(const strview_t *field, unsigned long *id)
+{
+        unsigned long value = 0;
+
+        if (field->len == 0)
+                return false;
+        for (int i = 0; i < field->len; i++) {
+                if (field->data[i] < '0' || field->data[i] > '9')
+                        return false;
+                value = value * 10 + (unsigned long)(field->data[i] - '0');
+        }
+        *id = value;
+        return true;
+}
+
+bool files_parse_passwd(const char *record, size_t len, passwd_view_t *pwd)
+{
+        strview_t fields[7];
+        unsigned long uid = 0;
+        unsigned long gid = 0;
+
+        if (split_fields(record, len, fields, 7) != 7)
+                return false;
+        if (!parse_id(&fields[2], &uid) || !parse_id(&fields[3], &gid))
+                return false;
+
+        pwd->name = fields[0];
+        pwd->passwd = fields[1];
+        pwd->uid = (uid_t)uid;
+        pwd->gid = (gid_t)gid;
+        pwd->gecos = fields[4];
+        pwd->dir = fields[5];
+        pwd->shell = fields[6];
+        return true;
+}
+
+bool files_parse_group(const char *record, size_t len, group_view_t *grp)
+{
+        strview_t fields[4];
+        unsigned long gid = 0;
+
+        if (split_fields(record, len, fields, 4) != 4)
+                return false;
+        if (!parse_id(&fields[2], &gid))
+                return false;
+
+        grp->name = fields[0];
+        grp->passwd = fields[1];
+        grp->gid = (gid_t)gid;
+        grp->members = fields[3];
+        grp->member_sep = ',';
+        return true;
+}
+
+/**
+ * Return the numeric value of field @field_no in @record
+ */
+static bool record_id(const char *record, size_t len, int field_no, unsigned long *id)
+{
+        const char *end = record + len;
+        const char *sep = NULL;
+        strview_t field;
+
+        for (; field_no > 0; field_no--) {
+                sep = memchr(record, ':', (size_t)(end - record));
+                if (sep == NULL)
+                        return false;
+                record = sep + 1;
+        }
+        sep = memchr(record, ':', (size_t)(end - record));
+        field.data = record;
+        field.len = (int)((sep != NULL ? sep : end) - record);
+        return parse_id(&field, id);
+}
+
+static int record_fields(const char *record, size_t len)
+{
+        const char *end = record + len;
+        int cnt = 1;
+
+        while ((record = memchr(record, ':', (size_t)(end - record))) != NULL) {
+                record++;
+                cnt++;
+        }
+        return cnt;
+}
+
+/**
+ * Answer @key with @record unless an earlier record already did. Returns
+ * true if the key was answered now.
+ */
+static bool claim_key(strview_t *records, int key, const char *record, size_t len)
+{
+        if (key < 0 || records[key].data != NULL)
+                return false;
+        records[key].data = record;
+        records[key].len = (int)len;
+        return true;
+}
+
+/**
+ * Walk @map once, remembering where the first record matching each key is.
+ * A record may answer a name key and an id key at once, as every key must
+ * get the record a lookup of it alone would.
+ */
+static void scan_file(const files_database_t *db, const files_map_t *map, const keyset_t *set,
+                      strview_t *records)
+{
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+        int pending = set->unique;
+
+        while (pending > 0 && files_next(map, &pos, &record, &len)) {
+                const char *colon = memchr(record, ':', len);
+                size_t name_len = colon != NULL ? (size_t)(colon - record) : len;
+                unsigned long id = 0;
+
+                if (record_fields(record, len) < db->fields)
+                        continue;
+
+                if (claim_key(records, keyset_find_name(set, record, name_len), record, len))
+                        pending--;
+                if (db->id_field >= 0 && record_id(record, len, db->id_field, &id) &&
+                    claim_key(records, keyset_find_id(set, id), record, len))
+                        pending--;
+        }
+}
+
+int files_get(const files_database_t *db, const char **keys, int key_cnt,
+              const getent_chain_t *next)
+{
+        keyset_t set;
+        strview_t *records = NULL;
+        files_map_t map;
+
+        if (keys == NULL)
+                return RES_KEY_NOT_FOUND;
+
+        if (!keyset_init(&set, keys, key_cnt, db->id_field >= 0))
+                err("Out of memory\n");
+        records = calloc((size_t)key_cnt, sizeof(strview_t));
+        if (records == NULL)
+                err("Out of memory\n");
+
+        if (files_map(db->path, &map))
+                scan_file(db, &map, &set, records);
+
+        for (int i = 0; i < key_cnt; i++) {
+                const strview_t *record = &records[set.first[i]];
+
+                if (record->data != NULL)
+                        db->emit(record->data, (size_t)record->len);
+                else
+                        chain_get(next, &keys[i], 1);
+        }
+
+        files_unmap(&map);
+        free(records);
+        keyset_free(&set);
+
+        return RES_OK;
+}
+
+int files_enum(const files_database_t *db)
+{
+        files_map_t map;
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+
+        if (!files_map(db->path, &map))
+                return RES_KEY_NOT_FOUND;
+        while (files_next(&map, &pos, &record, &len))
+                db->emit(record, len);
+        files_unmap(&map);
+
+        return RES_OK;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
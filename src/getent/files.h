@@ -0,0 +1,108 @@
+#ifndef GETENT_FILES_H
+#define GETENT_FILES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "getent.h"
+
+/**
+ * A slice of a mapped file. Views are not NUL terminated.
+ */
+typedef struct strview {
+        const char *data;
+        int len;
+} strview_t;
+
+static inline strview_t strview(const char *s)
+{
+        return (strview_t){ .data = s, .len = s != NULL ? (int)strlen(s) : 0 };
+}
+
+/**
+ * A read only mapping of a whole file
+ */
+typedef struct files_map {
+        const char *data;
+        size_t size;
+        struct stat st; /**< Status of the file when it was mapped */
+} files_map_t;
+
+/**
+ * A passwd(5) record, pointing into the file it was parsed from
+ */
+typedef struct passwd_view {
+        strview_t name;
+        strview_t passwd;
+        uid_t uid;
+        gid_t gid;
+        strview_t gecos;
+        strview_t dir;
+        strview_t shell;
+} passwd_view_t;
+
+/**
+ * A group(5) record, pointing into the file it was parsed from. The
+ * member list is kept as written, empty members included.
+ */
+typedef struct group_view {
+        strview_t name;
+        strview_t passwd;
+        gid_t gid;
+        strview_t members;
+        char member_sep; /**< ',' as in the file, '\0' in a getent-mkdb index */
+} group_view_t;
+
+/**
+ * Description of a colon separated database in /etc. The file is mapped
+ * and records are handed to @emit where they lie, without being copied.
+ */
+typedef struct files_database {
+        const char *path;                              /**< File to read */
+        int fields;                                    /**< Minimum number of fields in a record */
+        int id_field;                                  /**< Field holding the numeric id, or -1 */
+        void (*emit)(const char *record, size_t len);  /**< Parse and print a record */
+} files_database_t;
+
+/**
+ * Resolve @keys against @db in a single pass over the file, printing
+ * results in key order. Keys missing from the file are handed to the
+ * @next backends, in place.
+ */
+extern int files_get(const files_database_t *db, const char **keys, int key_cnt,
+                     const getent_chain_t *next);
+
+/**
+ * Print every record of @db, in file order.
+ */
+extern int files_enum(const files_database_t *db);
+
+/**
+ * Map the system file @path for reading, under root_dir when one is set.
+ * Returns false with errno set if it cannot be read or is not a regular
+ * file. Empty files are mapped with a NULL @data.
+ */
+extern bool files_map(const char *path, files_map_t *map);
+
+extern void files_unmap(files_map_t *map);
+
+/**
+ * Find the next record at or after @pos, skipping blank lines, comments
+ * and NIS compat entries. The record excludes its newline.
+ */
+extern bool files_next(const files_map_t *map, size_t *pos, const char **record, size_t *len);
+
+/**
+ * Split a passwd(5) record. Returns false for malformed records.
+ */
+extern bool files_parse_passwd(const char *record, size_t len, passwd_view_t *pwd);
+
+/**
+ * Split a group(5) record. Returns false for malformed records.
+ */
+extern bool files_parse_group(const char *record, size_t len, group_view_t *grp);
+
+#endif
@@ -25,58 +25,335 @@
 #define _GNU_SOURCE
 
 #include <getopt.h>
-#include <locale.h>
-#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "config.h"
 #include "databases.h"
 #include "getent.h"
+#include "output.h"
+#include "probes.h"
+#include "stats.h"
 
 enum { HELP_SHORT, HELP_FULL };
 
-void err(const char *msg, ...)
+/**
+ * Long options without a short equivalent
+ */
+enum { OPT_STDIN = 0x100, OPT_NAMES, OPT_ROOT, OPT_STATS };
+
+/**
+ * Keys read from a regular file are looked up this many at a time, so
+ * databases with a batch path still get to use it.
+ */
+static const size_t STREAM_BATCH_KEYS = 65536;
+
+/**
+ * Service configurations given with -s: either "services" for every
+ * database, or "database:services" for a single one.
+ */
+#define SERVICE_SPECS_MAX 16
+static const char *service_specs[SERVICE_SPECS_MAX];
+static size_t service_spec_cnt = 0;
+
+/**
+ * Upper bound for -j, each job is a thread blocked in the resolver
+ */
+#define RESOLVE_JOBS_MAX 256
+
+/**
+ * Ask getentd first (-c)
+ */
+static bool use_cache = false;
+
+/**
+ * Report what every lookup cost (--stats)
+ */
+static stats_format_t stats_format = STATS_OFF;
+
+/**
+ * Put the options back to their defaults, as main() runs once per command
+ * under the bash builtins
+ */
+static void reset_options(void)
+{
+        service_spec_cnt = 0;
+        use_cache = false;
+        stats_format = STATS_OFF;
+        resolve_jobs = 1;
+        host_names = HOST_NAMES_PTR;
+        output.failed = false;
+}
+
+static const getconf_database_config_t *find_database(const char *dbase)
+{
+        size_t i = 0;
+
+        for (i = 0; i < databases_size; i++) {
+                if (databases[i].name == NULL)
+                        continue;
+                if (strcmp(databases[i].name, dbase) == 0)
+                        return &databases[i];
+        }
+
+        err("Unknown database: %s\n", dbase);
+        return NULL;
+}
+
+/**
+ * Keep only the @cnt @backends that read files themselves, as libc and
+ * getentd would answer for the running system instead of root_dir. Asking
+ * for them explicitly with -s is an error, leaving them out of the
+ * defaults is not. Returns the number kept.
+ */
+static size_t root_backends(const getconf_database_config_t *db, bool explicit,
+                            const getent_backend_t **backends, size_t cnt)
 {
-        va_list args;
+        size_t kept = 0;
 
-        va_start(args, msg);
-        (void)vfprintf(stderr, msg, args);
-        va_end(args);
+        for (size_t i = 0; i < cnt; i++) {
+                if (!backends[i]->system_only)
+                        backends[kept++] = backends[i];
+                else if (explicit)
+                        err("Service %s cannot read from --root\n", backends[i]->name);
+        }
+        if (kept == 0)
+                err("No default service of %s reads from --root, select one with -s\n",
+                    db->name);
+        return kept;
+}
+
+/**
+ * Work out which backends answer @db. A configuration naming the database
+ * wins over one for every database, which wins over the defaults.
+ */
+static void database_chain(const getconf_database_config_t *db, getent_chain_t *chain)
+{
+        static const getent_backend_t *backends[DATABASE_BACKENDS_MAX];
+        const getent_backend_t *cache = database_backend(db, "cache");
+        const char *spec = db->defaults;
+        bool specific = false;
+        size_t offset = 0;
 
-        exit(EXIT_FAILURE);
+        for (size_t i = 0; i < service_spec_cnt; i++) {
+                const char *colon = strchr(service_specs[i], ':');
+                size_t len = 0;
+
+                if (colon == NULL) {
+                        if (!specific)
+                                spec = service_specs[i];
+                        continue;
+                }
+                len = (size_t)(colon - service_specs[i]);
+                if (strlen(db->name) == len && strncmp(service_specs[i], db->name, len) == 0) {
+                        spec = colon + 1;
+                        specific = true;
+                }
+        }
+
+        if (use_cache && cache != NULL && strstr(spec, "cache") == NULL)
+                backends[offset++] = cache;
+        chain_build(db, spec, backends + offset, DATABASE_BACKENDS_MAX - offset, chain);
+        chain->backends = backends;
+        chain->cnt += offset;
+        if (root_dir != NULL)
+                chain->cnt = root_backends(db, spec != db->defaults, backends, chain->cnt);
 }
 
-int is_numeric(const char *v)
+/**
+ * Look @keys up with @chain, one at a time and timed under --stats
+ */
+static int chain_lookup(const getent_chain_t *chain, const char **keys, int key_cnt)
 {
-        if (v == NULL)
-                return 1;
+        int res = RES_OK;
 
-        for (; v != NULL && *v != (char)0; v++)
-                if (*v < '0' || *v > '9')
-                        return 0;
+        if (stats_format == STATS_OFF)
+                return chain_get(chain, keys, key_cnt);
+        for (int i = 0; i < key_cnt; i++) {
+                int r = stats_get(chain, keys[i]);
 
-        return 1;
+                if (r != RES_OK)
+                        res = r;
+        }
+        return res;
 }
 
 static int read_database(const char *dbase, const char **keys, int key_cnt)
 {
-        size_t i = 0;
+        const getconf_database_config_t *db = find_database(dbase);
+        getent_chain_t chain;
+        int res = RES_OK;
 
-        for (i = 0; i < databases_size; i++) {
-                if (databases[i].name == NULL)
+        database_chain(db, &chain);
+        GETENT_PROBE_DATABASE_START(db->name);
+        stats_begin(stats_format, db->name);
+        if (keys != NULL)
+                res = chain_lookup(&chain, keys, key_cnt);
+        else if (stats_format != STATS_OFF)
+                res = stats_enum(&chain);
+        else
+                res = chain_enum(&chain);
+        stats_end();
+        GETENT_PROBE_DATABASE_DONE(db->name, res);
+        return res;
+}
+
+/**
+ * What read_database_stream() holds, kept here so that a failed lookup
+ * caught by err_return can still release it
+ */
+static struct {
+        FILE *input;
+        char **keys;
+        size_t key_cnt;
+        char *line;
+} stream;
+
+/**
+ * Free the keys and line of the stream and close it, unless it is stdin
+ */
+static void stream_release(void)
+{
+        for (size_t i = 0; i < stream.key_cnt; i++)
+                free(stream.keys[i]);
+        free(stream.keys);
+        free(stream.line);
+        if (stream.input != NULL && stream.input != stdin)
+                fclose(stream.input);
+        memset(&stream, 0, sizeof(stream));
+}
+
+/**
+ * Look the keys read so far up with @chain
+ */
+static int stream_lookup(const getent_chain_t *chain)
+{
+        int res = chain_lookup(chain, (const char **)stream.keys, (int)stream.key_cnt);
+
+        for (size_t i = 0; i < stream.key_cnt; i++)
+                free(stream.keys[i]);
+        stream.key_cnt = 0;
+        return res;
+}
+
+/**
+ * Read @delim separated keys from @input and look each of them up in
+ * @db with @chain.
+ *
+ * Interactive input (a terminal, or a pipe from a coprocess) is answered
+ * one key at a time, flushing after every key so the other side never
+ * waits on our buffering. Keys from a regular file are handed over in
+ * large batches instead.
+ */
+static int stream_keys(const getconf_database_config_t *db, const getent_chain_t *chain,
+                       FILE *input, int delim)
+{
+        struct stat st;
+        bool interactive = true;
+        size_t batch_size = 1;
+        size_t line_size = 0;
+        ssize_t len = 0;
+        int res = RES_OK;
+
+        GETENT_PROBE_DATABASE_START(db->name);
+        stats_begin(stats_format, db->name);
+        if (fstat(fileno(input), &st) == 0 && S_ISREG(st.st_mode)) {
+                interactive = false;
+                batch_size = STREAM_BATCH_KEYS;
+        }
+
+        stream.keys = calloc(batch_size, sizeof(char *));
+        if (stream.keys == NULL)
+                err("Out of memory\n");
+
+        while ((len = getdelim(&stream.line, &line_size, delim, input)) != -1) {
+                int r = RES_OK;
+
+                if (len > 0 && stream.line[len - 1] == delim)
+                        stream.line[--len] = '\0';
+                if (len == 0)
                         continue;
-                if (strcmp(databases[i].name, dbase) != 0)
+
+                stream.keys[stream.key_cnt] = strdup(stream.line);
+                if (stream.keys[stream.key_cnt] == NULL)
+                        err("Out of memory\n");
+                if (++stream.key_cnt < batch_size)
                         continue;
-                if (keys != NULL)
-                        return databases[i].get(keys, key_cnt);
-                return databases[i].enum_all();
+
+                r = stream_lookup(chain);
+                if (r != RES_OK)
+                        res = r;
+                if (interactive)
+                        out_flush();
         }
 
-        err("Unknown database: %s\n", dbase);
-        return RES_MISSING_ARG_OR_INVALID_DATABASE;
+        if (stream.key_cnt > 0) {
+                int r = stream_lookup(chain);
+                if (r != RES_OK)
+                        res = r;
+        }
+
+        stats_end();
+        GETENT_PROBE_DATABASE_DONE(db->name, res);
+        return res;
+}
+
+/**
+ * Look up the keys of @input as stream_keys() does, then close it unless
+ * it is stdin. That also happens when err() returns to the caller through
+ * err_return, so nothing is left behind in a shell running the builtins.
+ */
+static int read_database_stream(const getconf_database_config_t *db,
+                                const getent_chain_t *chain, FILE *input, int delim)
+{
+        jmp_buf *caller = err_return;
+        jmp_buf failed;
+        int res = RES_OK;
+
+        stream.input = input;
+        if (caller != NULL) {
+                if (setjmp(failed) != 0) {
+                        err_return = caller;
+                        stream_release();
+                        longjmp(*caller, 1);
+                }
+                err_return = &failed;
+        }
+        res = stream_keys(db, chain, input, delim);
+        err_return = caller;
+        stream_release();
+        return res;
+}
+
+/**
+ * Parse the argument to -j
+ */
+static unsigned int parse_jobs(const char *arg)
+{
+        char *end = NULL;
+        unsigned long v = strtoul(arg, &end, 10);
+
+        if (*arg == '\0' || *end != '\0' || v == 0 || v > RESOLVE_JOBS_MAX)
+                err("Invalid number of jobs: %s\n", arg);
+        return (unsigned int)v;
+}
+
+/**
+ * Parse the argument to --names
+ */
+static int parse_host_names(const char *arg)
+{
+        if (strcmp(arg, "ptr") == 0)
+                return HOST_NAMES_PTR;
+        if (strcmp(arg, "canon") == 0)
+                return HOST_NAMES_CANON;
+        if (strcmp(arg, "cached") == 0)
+                return HOST_NAMES_CACHED;
+        err("Invalid host name source: %s\n", arg);
+        return HOST_NAMES_PTR;
 }
 
 /**
@@ -84,6 +361,14 @@ static int read_database(const char *dbase, const char **keys, int key_cnt)
  */
 static struct option prog_opts[] = {
         { "service", optional_argument, 0, 's' },
+        { "file", required_argument, NULL, 'f' },
+        { "stdin", no_argument, NULL, OPT_STDIN },
+        { "null", no_argument, NULL, 'z' },
+        { "cache", no_argument, NULL, 'c' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "names", required_argument, NULL, OPT_NAMES },
+        { "root", required_argument, NULL, OPT_ROOT },
+        { "stats", optional_argument, NULL, OPT_STATS },
         {
             "version",
             no_argument,
@@ -99,7 +384,10 @@ static struct option prog_opts[] = {
  */
 static void printUsage(const char *progname)
 {
-        fprintf(stdout, "Usage: %s [-i] [-s config] database [key ...]\n", progname);
+        fprintf(stdout, "Usage: %s [-ci] [-j jobs] [-s config] database [key ...]\n", progname);
+        fprintf(stdout,
+                "       %s [-ci] [-j jobs] [-s config] [-z] -f file|--stdin database\n",
+                progname);
 }
 
 /**
@@ -109,10 +397,38 @@ static void printHelp(const char *progname)
 {
         printUsage(progname);
 
+        fputs("    -c, --cache                          Query getentd first, if it is running\n",
+              stdout);
         fputs("    -i, --no-idn                         Disable IDN encoding for lookups\n",
               stdout);
+        fputs("    -f, --file=FILE                      Read keys from FILE, one per line\n",
+              stdout);
+        fputs("        --stdin                          Read keys from standard input\n",
+              stdout);
+        fputs("    -z, --null                           Keys are separated by NUL, not newline\n",
+              stdout);
+        fputs("    -j, --jobs=N                         Resolve up to N host keys at once\n",
+              stdout);
+        fputs("        --names=ptr|canon|cached         Name host addresses by reverse lookup,\n",
+              stdout);
+        fputs("                                         by canonical name, or by reverse\n",
+              stdout);
+        fputs("                                         lookup once per address\n", stdout);
+        fputs("        --root=DIR                       Read system files under DIR, not /\n",
+              stdout);
+        fputs("                                         (also set by $" LIBC_SUPPORT_ROOT_ENV ")\n",
+              stdout);
+        fputs("        --stats[=text|json]              Report the time, backend and bytes of\n",
+              stdout);
+        fputs("                                         each lookup on standard error\n",
+              stdout);
+        fputs("                                         (also set by $" GETENT_STATS_ENV ")\n",
+              stdout);
         fputs("    -s, --service=CONFIG                 Service configuration to be used\n",
               stdout);
+        fputs("                                         [database:]service[,service...]\n",
+              stdout);
+        fputs("                                         files, libc, db, dns, cache\n", stdout);
         fputs("    -V, --version                        Display program version and quit\n",
               stdout);
 }
@@ -128,21 +444,37 @@ static void printVersion(void)
         fputs("Available under the terms of the MIT license\n", stdout);
 }
 
+#ifdef MULTICALL
+int getent_main(int argc, char **argv)
+#else
 int main(int argc, char **argv)
+#endif
 {
         const char *dbase = NULL;
         const char **keys = NULL;
         int opt = 0;
         bool process_loop = true;
         __attribute__((unused)) bool idn = true;
-        __attribute__((unused)) const char *service = NULL;
         const char *progname = argv[0];
+        const char *keyfile = NULL;
+        const char *root = NULL;
+        const char *stats_arg = getenv(GETENT_STATS_ENV);
+        int delim = '\n';
+        const getconf_database_config_t *db = NULL;
+        getent_chain_t chain;
+        FILE *input = NULL;
+        static bool flush_at_exit = false;
 
-        setlocale(LC_ALL, "");
+        reset_options();
+        /* Formatters write to a buffer of their own, make sure it reaches stdout */
+        if (!flush_at_exit) {
+                atexit(out_flush);
+                flush_at_exit = true;
+        }
 
         while (process_loop) {
                 int option_index = 0;
-                opt = getopt_long(argc, argv, "ahVs:i", prog_opts, &option_index);
+                opt = getopt_long(argc, argv, "ahVs:if:zcj:", prog_opts, &option_index);
 
                 switch (opt) {
                 case 'h':
@@ -162,7 +494,33 @@ int main(int argc, char **argv)
                         idn = false;
                         break;
                 case 's':
-                        service = optarg;
+                        if (service_spec_cnt == SERVICE_SPECS_MAX)
+                                err("Too many service configurations\n");
+                        service_specs[service_spec_cnt++] = optarg;
+                        break;
+                case 'f':
+                        keyfile = optarg;
+                        break;
+                case OPT_STDIN:
+                        keyfile = "-";
+                        break;
+                case 'z':
+                        delim = '\0';
+                        break;
+                case 'c':
+                        use_cache = true;
+                        break;
+                case 'j':
+                        resolve_jobs = parse_jobs(optarg);
+                        break;
+                case OPT_NAMES:
+                        host_names = parse_host_names(optarg);
+                        break;
+                case OPT_ROOT:
+                        root = optarg;
+                        break;
+                case OPT_STATS:
+                        stats_arg = optarg != NULL ? optarg : "text";
                         break;
                 default:
                         break;
@@ -176,6 +534,12 @@ int main(int argc, char **argv)
         argc -= optind;
         argv += optind;
 
+        root_dir_set(root != NULL ? root : getenv(LIBC_SUPPORT_ROOT_ENV));
+        if (stats_arg != NULL && !stats_parse(stats_arg, &stats_format))
+                err("Invalid statistics format: %s\n", stats_arg);
+        if (root_dir != NULL && use_cache)
+                err("--cache cannot be used with --root\n");
+
         dbase = *argv;
         --argc;
         if (argc > 0)
@@ -185,7 +549,24 @@ int main(int argc, char **argv)
                 printUsage(progname);
                 return RES_MISSING_ARG_OR_INVALID_DATABASE;
         }
-        return read_database(dbase, keys, argc);
+        if (keyfile == NULL)
+                return read_database(dbase, keys, argc);
+
+        /* Keys come from the stream only */
+        if (keys != NULL) {
+                printUsage(progname);
+                return RES_MISSING_ARG_OR_INVALID_DATABASE;
+        }
+        /* Fail on a bad database or service before opening anything */
+        db = find_database(dbase);
+        database_chain(db, &chain);
+        if (strcmp(keyfile, "-") == 0)
+                return read_database_stream(db, &chain, stdin, delim);
+
+        input = fopen(keyfile, "re");
+        if (input == NULL)
+                err("Unable to open %s: %m\n", keyfile);
+        return read_database_stream(db, &chain, input, delim);
 }
 
 /*
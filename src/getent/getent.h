@@ -1,9 +1,14 @@
 #ifndef GETENT_H
 #define GETENT_H
 
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #include "config.h"
+#include "output.h"
+#include "stats.h"
 
 #ifndef HAVE_ALIASES
 #define HAVE_ALIASES 0
@@ -24,49 +29,115 @@ enum { RES_OK = 0,
        RES_ENUMERATION_NOT_SUPPORTED = 3,
 };
 
-typedef int (*get_func_t)(const char **keys, int key_cnt);
+typedef struct getent_backend getent_backend_t;
+
+/**
+ * The backends still to be tried for a database. A backend hands the keys
+ * it cannot answer to the rest of the chain, so `-s files,libc` only asks
+ * libc about what the files did not hold.
+ */
+typedef struct getent_chain {
+        const char *database;                     /**< Database being looked up */
+        const getent_backend_t *const *backends;  /**< Backends, in order */
+        size_t cnt;                               /**< Number of backends */
+} getent_chain_t;
+
+typedef int (*get_func_t)(const char **keys, int key_cnt, const getent_chain_t *next);
 typedef int (*enum_func_t)(void);
 
+/**
+ * A source of database entries, selected with -s
+ */
+struct getent_backend {
+        const char *name;     /**< Name used with -s */
+        get_func_t get;       /**< Look keys up, passing misses on to @next */
+        enum_func_t enum_all; /**< Print all entries, NULL if not supported */
+        bool system_only;     /**< Answers for the running system, whatever --root says */
+};
+
+/**
+ * Most backends a single chain may hold
+ */
+#define DATABASE_BACKENDS_MAX 8
+
 typedef struct getconf_database_config {
         const char *name;
-        get_func_t get;
-        enum_func_t enum_all;
+        const getent_backend_t *const *backends; /**< Backends able to answer, NULL terminated */
+        const char *defaults;                    /**< Backends used when -s is not given */
 } getconf_database_config_t;
 
 #define DST_LEN 256
 
 #define DATABASE_CONF(X)                                                                           \
         {                                                                                          \
-                .name = #X, .get = get_##X, .enum_all = enum_##X##_all                             \
+                .name = #X, .backends = X##_backends, .defaults = X##_defaults                     \
+        }
+
+/**
+ * Declare the backends of database X, and the ones used by default
+ */
+#define DATABASE_BACKENDS(X, defaults, ...)                                                        \
+        const char X##_defaults[] = defaults;                                                      \
+        const getent_backend_t *const X##_backends[] = { __VA_ARGS__, NULL }
+
+/**
+ * Backend "type" of database X, built from get_X_type and enum_X_type_all
+ */
+#define BACKEND(X, type)                                                                           \
+        static const getent_backend_t X##_##type##_backend = {                                     \
+                .name = #type, .get = get_##X##_##type, .enum_all = enum_##X##_##type##_all        \
         }
 
+/**
+ * Backend "type" of database X that cannot enumerate
+ */
+#define BACKEND_NO_ENUM(X, type)                                                                   \
+        static const getent_backend_t X##_##type##_backend = {                                     \
+                .name = #type, .get = get_##X##_##type, .enum_all = NULL                           \
+        }
+
+/**
+ * The libc backend of database X, built from get_X and enum_X_all
+ */
+#define LIBC_BACKEND(X)                                                                            \
+        static const getent_backend_t X##_libc_backend = { .name = "libc",                          \
+                                                           .get = get_##X,                         \
+                                                           .enum_all = enum_##X##_all,             \
+                                                           .system_only = true }
+
 #define ENUM_ALL(X, base, initparm, type)                                                          \
         int enum_##X##_all(void)                                                                   \
         {                                                                                          \
                 struct type *ent = NULL;                                                           \
                 set##base(initparm);                                                               \
-                while ((ent = get##base()) != NULL)                                                \
+                while ((ent = get##base()) != NULL) {                                              \
+                        stats_read(1, 0);                                                          \
                         print_##type##_info(ent);                                                  \
+                }                                                                                  \
                 end##base();                                                                       \
                 return RES_OK;                                                                     \
         }
 
 #define GET_SIMPLE(X, getfunc, type)                                                               \
-        int get_##X(const char **keys, int key_cnt)                                                \
+        int get_##X(const char **keys, int key_cnt, const getent_chain_t *next)                    \
         {                                                                                          \
                 if (keys == NULL)                                                                  \
                         return RES_KEY_NOT_FOUND;                                                  \
                 for (; key_cnt-- > 0; keys++) {                                                    \
                         struct type *ent = NULL;                                                   \
                         ent = getfunc(*keys);                                                      \
-                        if (ent != NULL)                                                           \
+                        if (ent != NULL) {                                                         \
+                                stats_read(1, 0);                                                  \
                                 print_##type##_info(ent);                                          \
+                        } else {                                                                   \
+                                chain_get(next, keys, 1);                                          \
+                        }                                                                          \
                 }                                                                                  \
                 return RES_OK;                                                                     \
         }
 
 #define GET_NUMERIC_CAST(X, getfunc, getnumericfunc, type, numcast)                                \
-        int get_##X(const char **keys, int key_cnt)                                                \
+        int get_##X(const char **keys, int key_cnt, const getent_chain_t *next)                    \
         {                                                                                          \
                 if (keys == NULL)                                                                  \
                         return RES_KEY_NOT_FOUND;                                                  \
@@ -78,8 +149,12 @@ typedef struct getconf_database_config {
                                 ent = getnumericfunc((numcast)atoi(*keys));                        \
                         else                                                                       \
                                 ent = getfunc(*keys);                                              \
-                        if (ent != NULL)                                                           \
+                        if (ent != NULL) {                                                         \
+                                stats_read(1, 0);                                                  \
                                 print_##type##_info(ent);                                          \
+                        } else {                                                                   \
+                                chain_get(next, keys, 1);                                          \
+                        }                                                                          \
                 }                                                                                  \
                 return RES_OK;                                                                     \
         }
@@ -92,20 +167,109 @@ typedef struct getconf_database_config {
                 return no_enum(#X);                                                                \
         }
 
-static inline void print_align_to(int cnt, int align_to)
-{
-        while (++cnt < align_to)
-                if (fputc(' ', stdout) == EOF)
-                        break;
-}
-
 static inline int no_enum(const char *db)
 {
-        printf("Enumeration not supported on %s\n", db);
+        out_str("Enumeration not supported on ");
+        out_str(db);
+        out_char('\n');
         return RES_ENUMERATION_NOT_SUPPORTED;
 }
 
 extern int is_numeric(const char *v);
+
+/**
+ * Load the locale of the environment. Only error text depends on it, so
+ * rather than on every start this is done when an error is about to be
+ * printed; err() sees to it.
+ */
+extern void locale_init(void);
+
+/**
+ * Set once the locale is loaded, by locale_init() or by a host process
+ * that owns it, such as a shell running the bash builtins
+ */
+extern bool locale_loaded;
+
+/**
+ * Print @msg to stderr and exit with EXIT_FAILURE, or longjmp() to
+ * err_return with 1 when the thread has set it
+ */
 extern void err(const char *msg, ...);
 
+/**
+ * Lets a process that must outlive a failed command, as a shell running
+ * the bash builtins must, catch err(). Per thread: it is only set on the
+ * thread running main(), so the -j resolver threads must never call err(),
+ * which would exit the shell from there.
+ */
+extern _Thread_local jmp_buf *err_return;
+
+/**
+ * Environment variable setting the root when --root is not given
+ */
+#define LIBC_SUPPORT_ROOT_ENV "LIBC_SUPPORT_ROOT"
+
+/**
+ * Directory standing in for / when native backends read system files
+ * (--root), NULL for the real root. libc and getentd cannot be pointed
+ * elsewhere, see getent_backend.system_only.
+ */
+extern const char *root_dir;
+
+/**
+ * Use @dir as root_dir. An empty @dir, or "/", means the real root.
+ */
+extern void root_dir_set(const char *dir);
+
+/**
+ * Return the absolute system @path as seen under root_dir, using @buf
+ * when it has to be rewritten
+ */
+extern const char *root_path(const char *path, char *buf, size_t len);
+
+/**
+ * Look @keys up with the first backend of @chain. An empty chain finds
+ * nothing.
+ */
+extern int chain_get(const getent_chain_t *chain, const char **keys, int key_cnt);
+
+/**
+ * Enumerate with the first backend of @chain able to do so
+ */
+extern int chain_enum(const getent_chain_t *chain);
+
+/**
+ * Build the chain for @db from @spec, a comma separated list of backend
+ * names. Storage for up to @max backends is provided in @backends.
+ * Unknown or unsupported backends are fatal.
+ */
+extern void chain_build(const getconf_database_config_t *db, const char *spec,
+                        const getent_backend_t **backends, size_t max, getent_chain_t *chain);
+
+/**
+ * Return the backend @name of @db, or NULL if it has none
+ */
+extern const getent_backend_t *database_backend(const getconf_database_config_t *db,
+                                                const char *name);
+
+/**
+ * getentd, see cache.c
+ */
+extern const getent_backend_t cache_backend;
+
+/**
+ * Number of host keys resolved at the same time (-j), 1 resolves them in turn
+ */
+extern unsigned int resolve_jobs;
+
+/**
+ * Where the name printed next to a host address comes from (--names)
+ */
+enum { HOST_NAMES_PTR,    /**< Reverse lookup of the address, for every key */
+       HOST_NAMES_CANON,  /**< Canonical name from the forward lookup */
+       HOST_NAMES_CACHED, /**< Reverse lookup, once per address for the whole run */
+};
+
+extern int host_names;
+
 #endif
@@ -0,0 +1,798 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "config.h"
+#include "databases.h"
+#include "getent.h"
+#include "output.h"
+
+/**
+ * Largest request a client may send
+ */
+#define REQUEST_MAX (sizeof(getentd_request_t) + 2 * UINT16_MAX)
+
+/**
+ * Number of clients served at the same time
+ */
+#define CLIENTS_MAX 64
+
+/**
+ * A cached lookup result. The cache key is the database name and the
+ * lookup key separated by a NUL byte.
+ */
+typedef struct cache_entry {
+        struct cache_entry *next;  /**< Next entry in the same hash bucket */
+        struct cache_entry *older; /**< Entry inserted before this one */
+        struct cache_entry *newer; /**< Entry inserted after this one */
+        const getconf_database_config_t *db;
+        char *key;       /**< Cache key */
+        size_t key_len;  /**< Length of the cache key */
+        char *output;    /**< Output of the lookup */
+        size_t len;      /**< Length of the output */
+        int status;      /**< Result of the lookup */
+        time_t expires;  /**< When the entry goes stale */
+} cache_entry_t;
+
+/**
+ * A connected client, the request bytes received so far and the lookup
+ * its current request waits for
+ */
+typedef struct client {
+        int fd;
+        char *buf;
+        size_t used;
+        size_t req_len;       /**< Length of the request being answered */
+        pid_t pid;            /**< Child running the lookup */
+        int lookup_fd;        /**< Read end of the child's output, or -1 */
+        size_t out_size;      /**< Allocated size of entry->output */
+        cache_entry_t *entry; /**< Entry the lookup fills */
+} client_t;
+
+/**
+ * Files backing a database. When one changes, entries of the database
+ * are dropped, like nscd does.
+ */
+typedef struct watched_file {
+        const char *db;
+        const char *path;
+        struct stat st;
+} watched_file_t;
+
+static watched_file_t watched_files[] = {
+        { .db = "password", .path = "/etc/passwd" },
+        { .db = "group", .path = "/etc/group" },
+        { .db = "hosts", .path = "/etc/hosts" },
+        { .db = "ahosts", .path = "/etc/hosts" },
+        { .db = "ahostsv4", .path = "/etc/hosts" },
+        { .db = "ahostsv6", .path = "/etc/hosts" },
+        { .db = "services", .path = "/etc/services" },
+        { .db = "protocols", .path = "/etc/protocols" },
+};
+
+static cache_entry_t **cache_table = NULL;
+static size_t cache_size = 0;
+static size_t cache_cnt = 0;
+static cache_entry_t *oldest = NULL;
+static cache_entry_t *newest = NULL;
+static size_t max_entries = 100000;
+static time_t positive_ttl = 600;
+static time_t negative_ttl = 20;
+static volatile sig_atomic_t running = 1;
+
+static uint64_t hash_key(const char *key, size_t len)
+{
+        uint64_t h = 14695981039346656037ULL;
+
+        while (len-- > 0) {
+                h ^= (unsigned char)*key++;
+                h *= 1099511628211ULL;
+        }
+        return h;
+}
+
+static void free_entry(cache_entry_t *entry)
+{
+        free(entry->key);
+        free(entry->output);
+        free(entry);
+}
+
+/**
+ * Unlink the entry @link points at from its bucket and from the insertion
+ * order, and free it
+ */
+static void cache_drop(cache_entry_t **link)
+{
+        cache_entry_t *entry = *link;
+
+        *link = entry->next;
+        if (entry->older != NULL)
+                entry->older->newer = entry->newer;
+        else
+                oldest = entry->newer;
+        if (entry->newer != NULL)
+                entry->newer->older = entry->older;
+        else
+                newest = entry->older;
+        free_entry(entry);
+        cache_cnt--;
+}
+
+/**
+ * Return the link to the entry for @key, live or stale, or NULL
+ */
+static cache_entry_t **cache_link(const char *key, size_t key_len)
+{
+        cache_entry_t **link = NULL;
+
+        if (cache_size == 0)
+                return NULL;
+        link = &cache_table[hash_key(key, key_len) & (cache_size - 1)];
+        for (; *link != NULL; link = &(*link)->next)
+                if ((*link)->key_len == key_len && memcmp((*link)->key, key, key_len) == 0)
+                        return link;
+        return NULL;
+}
+
+/**
+ * Drop stale entries, or every entry of @db when set
+ */
+static void cache_prune(const getconf_database_config_t *db, time_t now)
+{
+        for (size_t i = 0; i < cache_size; i++) {
+                cache_entry_t **link = &cache_table[i];
+
+                while (*link != NULL) {
+                        cache_entry_t *entry = *link;
+                        bool drop = db != NULL ? entry->db == db : entry->expires <= now;
+
+                        if (drop)
+                                cache_drop(link);
+                        else
+                                link = &entry->next;
+                }
+        }
+}
+
+/**
+ * Drop the entry inserted longest ago
+ */
+static void cache_evict_oldest(void)
+{
+        cache_drop(cache_link(oldest->key, oldest->key_len));
+}
+
+/**
+ * Drop every entry
+ */
+static void cache_clear(void)
+{
+        while (oldest != NULL)
+                cache_evict_oldest();
+}
+
+static void cache_grow(void)
+{
+        size_t size = cache_size == 0 ? 4096 : cache_size * 2;
+        cache_entry_t **table = calloc(size, sizeof(cache_entry_t *));
+
+        if (table == NULL)
+                return;
+        for (size_t i = 0; i < cache_size; i++) {
+                while (cache_table[i] != NULL) {
+                        cache_entry_t *entry = cache_table[i];
+                        size_t slot = (size_t)hash_key(entry->key, entry->key_len) & (size - 1);
+
+                        cache_table[i] = entry->next;
+                        entry->next = table[slot];
+                        table[slot] = entry;
+                }
+        }
+        free(cache_table);
+        cache_table = table;
+        cache_size = size;
+}
+
+/**
+ * Return the live entry for @key. Stale entries are dropped on the way.
+ */
+static cache_entry_t *cache_find(const char *key, size_t key_len, time_t now)
+{
+        cache_entry_t **link = cache_link(key, key_len);
+
+        if (link == NULL)
+                return NULL;
+        if ((*link)->expires > now)
+                return *link;
+        cache_drop(link);
+        return NULL;
+}
+
+/**
+ * Add @entry, making room by dropping stale entries first and then the
+ * oldest ones. The entry is freed if the table cannot be allocated.
+ */
+static void cache_insert(cache_entry_t *entry, time_t now)
+{
+        cache_entry_t **link = cache_link(entry->key, entry->key_len);
+        size_t slot = 0;
+
+        /* Another client's lookup of the same key may have finished first */
+        if (link != NULL)
+                cache_drop(link);
+        if (cache_cnt >= max_entries)
+                cache_prune(NULL, now);
+        while (cache_cnt >= max_entries)
+                cache_evict_oldest();
+        if (cache_cnt >= cache_size)
+                cache_grow();
+        if (cache_size == 0) {
+                free_entry(entry);
+                return;
+        }
+
+        slot = (size_t)hash_key(entry->key, entry->key_len) & (cache_size - 1);
+        entry->next = cache_table[slot];
+        cache_table[slot] = entry;
+        entry->older = newest;
+        entry->newer = NULL;
+        if (newest != NULL)
+                newest->newer = entry;
+        else
+                oldest = entry;
+        newest = entry;
+        cache_cnt++;
+}
+
+/**
+ * Drop entries of @db when the file behind it changed since last time
+ */
+static void check_watched(const getconf_database_config_t *db)
+{
+        for (size_t i = 0; i < sizeof(watched_files) / sizeof(watched_files[0]); i++) {
+                watched_file_t *w = &watched_files[i];
+                struct stat st;
+
+                if (strcmp(w->db, db->name) != 0)
+                        continue;
+                if (stat(w->path, &st) != 0)
+                        memset(&st, 0, sizeof(st));
+                if (st.st_ino != w->st.st_ino || st.st_size != w->st.st_size ||
+                    st.st_mtim.tv_sec != w->st.st_mtim.tv_sec ||
+                    st.st_mtim.tv_nsec != w->st.st_mtim.tv_nsec)
+                        cache_prune(db, 0);
+                w->st = st;
+        }
+}
+
+/**
+ * Start looking @key up for @c in a child with stdout going to a pipe, so
+ * the regular database code and formatters can be used as they are. Only
+ * misses pay for this. The output is collected by the poll loop, so a slow
+ * lookup holds up no one but the client waiting for it.
+ */
+static bool start_lookup(client_t *c, cache_entry_t *entry, const char *key)
+{
+        const getent_backend_t *backends[DATABASE_BACKENDS_MAX];
+        getent_chain_t chain;
+        int pipefd[2];
+        pid_t pid;
+
+        /* The defaults never include ourselves */
+        chain_build(entry->db, entry->db->defaults, backends, DATABASE_BACKENDS_MAX, &chain);
+        if (pipe2(pipefd, O_CLOEXEC) != 0)
+                return false;
+
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0) {
+                close(pipefd[0]);
+                close(pipefd[1]);
+                return false;
+        }
+        if (pid == 0) {
+                int res = RES_OK;
+
+                if (dup2(pipefd[1], STDOUT_FILENO) < 0)
+                        _exit(RES_KEY_NOT_FOUND);
+                res = chain_get(&chain, &key, 1);
+                out_flush();
+                _exit(res);
+        }
+
+        close(pipefd[1]);
+        (void)fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+        c->pid = pid;
+        c->lookup_fd = pipefd[0];
+        c->out_size = 0;
+        c->entry = entry;
+        return true;
+}
+
+/**
+ * Stop the lookup of @c, returning its entry. The child is killed first
+ * unless it finished, as it might be blocked on a full pipe.
+ */
+static cache_entry_t *end_lookup(client_t *c, bool finished, int *wstatus)
+{
+        cache_entry_t *entry = c->entry;
+
+        if (!finished)
+                (void)kill(c->pid, SIGKILL);
+        close(c->lookup_fd);
+        /* The child closes its end by exiting, so this does not wait long */
+        while (waitpid(c->pid, wstatus, 0) < 0 && errno == EINTR)
+                ;
+        c->lookup_fd = -1;
+        c->entry = NULL;
+        return entry;
+}
+
+static const getconf_database_config_t *find_cached_database(const char *name, size_t len)
+{
+        for (size_t i = 0; i < databases_size; i++) {
+                const char *db = databases[i].name;
+
+                if (db != NULL && strlen(db) == len && strncmp(db, name, len) == 0)
+                        return database_backend(&databases[i], "cache") != NULL ? &databases[i]
+                                                                                : NULL;
+        }
+        return NULL;
+}
+
+static bool send_response(int fd, int32_t status, const char *output, size_t len)
+{
+        getentd_response_t resp = { .status = status, .len = (uint32_t)len };
+
+        return cache_write_full(fd, &resp, sizeof(resp)) && cache_write_full(fd, output, len);
+}
+
+/**
+ * Answer the request at the start of the buffer of @c, from the cache or
+ * by starting a lookup. Returns false once the client is gone.
+ */
+static bool handle_request(client_t *c, const getentd_request_t *req)
+{
+        const char *buf = c->buf;
+        const getconf_database_config_t *db = find_cached_database(buf, req->db_len);
+        size_t key_len = (size_t)req->db_len + 1 + req->key_len;
+        cache_entry_t *entry = NULL;
+
+        if (db == NULL)
+                return send_response(c->fd, GETENTD_UNCACHED, NULL, 0);
+
+        check_watched(db);
+
+        entry = cache_find(buf, key_len, time(NULL));
+        if (entry != NULL)
+                return send_response(c->fd, entry->status, entry->output, entry->len);
+
+        entry = calloc(1, sizeof(cache_entry_t));
+        if (entry == NULL)
+                return send_response(c->fd, GETENTD_UNCACHED, NULL, 0);
+        entry->db = db;
+        entry->key_len = key_len;
+        entry->key = malloc(key_len + 1);
+        if (entry->key == NULL) {
+                free_entry(entry);
+                return send_response(c->fd, GETENTD_UNCACHED, NULL, 0);
+        }
+        memcpy(entry->key, buf, key_len);
+        entry->key[key_len] = '\0';
+        if (!start_lookup(c, entry, entry->key + req->db_len + 1)) {
+                free_entry(entry);
+                return send_response(c->fd, GETENTD_UNCACHED, NULL, 0);
+        }
+        return true;
+}
+
+/**
+ * Answer the complete requests buffered for @c, up to one that has to be
+ * looked up. Returns false once the client is gone or misbehaving.
+ */
+static bool process_requests(client_t *c)
+{
+        while (c->lookup_fd < 0) {
+                getentd_request_t req;
+                size_t len = 0;
+
+                if (c->used < sizeof(req))
+                        return true;
+                memcpy(&req, c->buf, sizeof(req));
+                if (req.magic != GETENTD_MAGIC)
+                        return false;
+                len = sizeof(req) + req.db_len + req.key_len;
+                if (c->used < len)
+                        return true;
+
+                /* Split database and key with a NUL to form the cache key */
+                memmove(c->buf, c->buf + sizeof(req), req.db_len);
+                c->buf[req.db_len] = '\0';
+                memmove(c->buf + req.db_len + 1,
+                        c->buf + sizeof(req) + req.db_len,
+                        req.key_len);
+                c->buf[req.db_len + 1 + req.key_len] = '\0';
+                c->req_len = len;
+                if (!handle_request(c, &req))
+                        return false;
+                if (c->lookup_fd >= 0)
+                        return true;
+
+                memmove(c->buf, c->buf + len, c->used - len);
+                c->used -= len;
+        }
+        return true;
+}
+
+/**
+ * Consume whatever the client sent. Returns false once the client is gone
+ * or misbehaving.
+ */
+static bool serve_client(client_t *c)
+{
+        ssize_t r = recv(c->fd, c->buf + c->used, REQUEST_MAX - c->used, MSG_DONTWAIT);
+
+        if (r < 0 && (errno == EAGAIN || errno == EINTR))
+                return true;
+        if (r <= 0)
+                return false;
+        c->used += (size_t)r;
+        return process_requests(c);
+}
+
+/**
+ * Collect what the lookup of @c wrote. Once it is done, answer the client,
+ * cache the result and go on with the requests that queued up behind it.
+ * Returns false once the client is gone.
+ */
+static bool collect_lookup(client_t *c)
+{
+        cache_entry_t *entry = c->entry;
+        bool finished = true;
+        int wstatus = 0;
+        bool ok = true;
+
+        for (;;) {
+                ssize_t r = 0;
+
+                if (entry->len == c->out_size) {
+                        size_t size = c->out_size == 0 ? 512 : c->out_size * 2;
+                        char *grown = realloc(entry->output, size);
+
+                        if (grown == NULL) {
+                                finished = false;
+                                break;
+                        }
+                        entry->output = grown;
+                        c->out_size = size;
+                }
+                r = read(c->lookup_fd, entry->output + entry->len, c->out_size - entry->len);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r < 0 && errno == EAGAIN)
+                        return true;
+                if (r <= 0)
+                        break;
+                entry->len += (size_t)r;
+        }
+
+        entry = end_lookup(c, finished, &wstatus);
+        if (!finished || !WIFEXITED(wstatus)) {
+                free_entry(entry);
+                ok = send_response(c->fd, GETENTD_UNCACHED, NULL, 0);
+        } else {
+                time_t now = time(NULL);
+
+                entry->status = WEXITSTATUS(wstatus);
+                entry->expires = now + (entry->len > 0 ? positive_ttl : negative_ttl);
+                ok = send_response(c->fd, entry->status, entry->output, entry->len);
+                cache_insert(entry, now);
+        }
+
+        memmove(c->buf, c->buf + c->req_len, c->used - c->req_len);
+        c->used -= c->req_len;
+        return ok && process_requests(c);
+}
+
+static int open_socket(const char *path)
+{
+        struct sockaddr_un addr;
+        int fd = -1;
+
+        if (strlen(path) >= sizeof(addr.sun_path))
+                err("Socket path too long: %s\n", path);
+
+        /* Refuse to steal the socket of a running daemon */
+        fd = cache_connect(path);
+        if (fd >= 0)
+                err("getentd is already listening on %s\n", path);
+        (void)unlink(path);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                err("Unable to create socket: %m\n");
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+                err("Unable to bind %s: %m\n", path);
+        /*
+         * getent -c runs as whoever calls it, so every user may connect.
+         * This gives away nothing: only databases listing the cache
+         * backend are answered, and the files behind those are world
+         * readable anyway. shadow and gshadow never are.
+         */
+        (void)chmod(path, 0666);
+        if (listen(fd, SOMAXCONN) != 0)
+                err("Unable to listen on %s: %m\n", path);
+        return fd;
+}
+
+static void close_client(client_t *c)
+{
+        if (c->lookup_fd >= 0) {
+                int wstatus = 0;
+
+                free_entry(end_lookup(c, false, &wstatus));
+        }
+        close(c->fd);
+        free(c->buf);
+        c->fd = -1;
+        c->buf = NULL;
+        c->used = 0;
+}
+
+static void accept_client(int listen_fd, client_t *clients)
+{
+        struct timeval timeout = { .tv_sec = 5, .tv_usec = 0 };
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+        if (fd < 0)
+                return;
+
+        /* Never let a client that stopped reading stall everybody else */
+        (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        for (size_t i = 0; i < CLIENTS_MAX; i++) {
+                if (clients[i].fd >= 0)
+                        continue;
+                clients[i].buf = malloc(REQUEST_MAX);
+                if (clients[i].buf == NULL)
+                        break;
+                clients[i].fd = fd;
+                return;
+        }
+        close(fd);
+}
+
+static void serve(int listen_fd)
+{
+        client_t clients[CLIENTS_MAX];
+        struct pollfd fds[CLIENTS_MAX + 1];
+        size_t owner[CLIENTS_MAX + 1];
+
+        for (size_t i = 0; i < CLIENTS_MAX; i++)
+                clients[i] = (client_t){ .fd = -1, .lookup_fd = -1 };
+
+        while (running) {
+                nfds_t nfds = 1;
+
+                fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+                for (size_t i = 0; i < CLIENTS_MAX; i++) {
+                        if (clients[i].fd < 0)
+                                continue;
+                        /* Clients waiting on a lookup are not read from until answered */
+                        owner[nfds] = i;
+                        fds[nfds++] = (struct pollfd){
+                                .fd = clients[i].lookup_fd >= 0 ? clients[i].lookup_fd
+                                                                : clients[i].fd,
+                                .events = POLLIN,
+                        };
+                }
+
+                if (poll(fds, nfds, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        err("poll failed: %m\n");
+                }
+
+                for (nfds_t j = 1; j < nfds; j++) {
+                        client_t *c = &clients[owner[j]];
+                        bool ok = true;
+
+                        if (fds[j].revents == 0)
+                                continue;
+                        if (fds[j].fd == c->lookup_fd)
+                                ok = collect_lookup(c);
+                        else
+                                ok = serve_client(c);
+                        if (!ok)
+                                close_client(c);
+                }
+                if (fds[0].revents & POLLIN)
+                        accept_client(listen_fd, clients);
+        }
+
+        for (size_t i = 0; i < CLIENTS_MAX; i++)
+                if (clients[i].fd >= 0)
+                        close_client(&clients[i]);
+}
+
+static void handle_signal(__attribute__((unused)) int sig)
+{
+        running = 0;
+}
+
+static long parse_number(const char *arg)
+{
+        char *end = NULL;
+        long v = strtol(arg, &end, 10);
+
+        if (*arg == '\0' || *end != '\0' || v < 0)
+                err("Invalid number: %s\n", arg);
+        return v;
+}
+
+/**
+ * Program arguments.
+ */
+static struct option prog_opts[] = {
+        { "socket", required_argument, NULL, 'S' },
+        { "positive-ttl", required_argument, NULL, 'p' },
+        { "negative-ttl", required_argument, NULL, 'n' },
+        { "max-entries", required_argument, NULL, 'm' },
+        { "version", no_argument, NULL, 'V' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+};
+
+/**
+ * Print correct CLI usage of the tool
+ */
+static void printUsage(const char *progname)
+{
+        fprintf(stdout, "Usage: %s [-S socket] [-p seconds] [-n seconds] [-m entries]\n", progname);
+}
+
+/**
+ * Pretty-print a help message
+ */
+static void printHelp(const char *progname)
+{
+        printUsage(progname);
+
+        fputs("    -S, --socket=PATH                    Listen on PATH (default " GETENTD_SOCKET
+              ")\n",
+              stdout);
+        fputs("    -p, --positive-ttl=SECONDS           Keep found entries for SECONDS\n", stdout);
+        fputs("    -n, --negative-ttl=SECONDS           Keep missing entries for SECONDS\n",
+              stdout);
+        fputs("    -m, --max-entries=COUNT              Cache at most COUNT entries\n", stdout);
+        fputs("    -h, --help                           Display this help message\n", stdout);
+        fputs("    -V, --version                        Display program version and quit\n",
+              stdout);
+}
+
+/**
+ * Print our version information
+ */
+static void printVersion(void)
+{
+        fputs("getentd version " PACKAGE_VERSION " \n\n", stdout);
+        fputs("Copyright © 2020 Serpent OS Developers\n", stdout);
+        fputs("Part of the libc-support project\n", stdout);
+        fputs("Available under the terms of the MIT license\n", stdout);
+}
+
+int main(int argc, char **argv)
+{
+        const char *socket_path = GETENTD_SOCKET;
+        const char *progname = argv[0];
+        struct sigaction sa;
+        int listen_fd = -1;
+        int opt = 0;
+
+        while ((opt = getopt_long(argc, argv, "S:p:n:m:hV", prog_opts, NULL)) != -1) {
+                switch (opt) {
+                case 'S':
+                        socket_path = optarg;
+                        break;
+                case 'p':
+                        positive_ttl = (time_t)parse_number(optarg);
+                        break;
+                case 'n':
+                        negative_ttl = (time_t)parse_number(optarg);
+                        break;
+                case 'm':
+                        max_entries = (size_t)parse_number(optarg);
+                        if (max_entries == 0)
+                                err("Invalid number: %s\n", optarg);
+                        break;
+                case 'h':
+                        printHelp(progname);
+                        return EXIT_SUCCESS;
+                case 'V':
+                        printVersion();
+                        return EXIT_SUCCESS;
+                default:
+                        printUsage(progname);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (optind != argc) {
+                printUsage(progname);
+                return EXIT_FAILURE;
+        }
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = handle_signal;
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGINT, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        listen_fd = open_socket(socket_path);
+        serve(listen_fd);
+
+        close(listen_fd);
+        (void)unlink(socket_path);
+        cache_clear();
+        free(cache_table);
+
+        return EXIT_SUCCESS;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
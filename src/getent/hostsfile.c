@@ -0,0 +1,584 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dbfile.h"
+#include "getent.h"
+#include "hostsfile.h"
+#include "stats.h"
+
+#define HOSTS_INDEX_MAGIC 0x49484547U /* GEHI */
+#define HOSTS_INDEX_VERSION 1
+#define HOSTS_EMPTY_SLOT UINT32_MAX
+
+/**
+ * Layout of hosts.idx: this header, the name slots, then the address
+ * slots. Each table is probed linearly from the slot picked by the key
+ * hash, lines sharing a name being found in file order. Integers are in
+ * host byte order.
+ */
+typedef struct hosts_index_header {
+        uint32_t magic;   /**< HOSTS_INDEX_MAGIC */
+        uint32_t version; /**< HOSTS_INDEX_VERSION */
+        uint64_t dev;     /**< Identity of the file indexed */
+        uint64_t ino;
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint32_t name_slot_cnt;
+        uint32_t addr_slot_cnt;
+} hosts_index_header_t;
+
+static uint32_t hash_bytes(const void *data, size_t len, bool fold_case)
+{
+        const unsigned char *p = data;
+        uint64_t h = 14695981039346656037ULL;
+
+        while (len-- > 0) {
+                unsigned char c = *p++;
+
+                if (fold_case && c >= 'A' && c <= 'Z')
+                        c += 'a' - 'A';
+                h ^= c;
+                h *= 1099511628211ULL;
+        }
+        return (uint32_t)(h ^ (h >> 32));
+}
+
+static uint32_t hash_addr(const dns_addr_t *addr)
+{
+        return hash_bytes(addr->addr, addr->family == AF_INET ? 4 : 16, false);
+}
+
+/**
+ * Slot a key is looked for first: the high bits of its hash, so that
+ * keys sorted by hash are sorted by slot
+ */
+static size_t home_slot(uint32_t hash, uint32_t slot_cnt)
+{
+        return (size_t)(((uint64_t)hash * slot_cnt) >> 32);
+}
+
+static bool same_addr(const dns_addr_t *a, const dns_addr_t *b)
+{
+        return a->family == b->family && memcmp(a->addr, b->addr, sizeof(a->addr)) == 0;
+}
+
+static bool is_blank(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char *next_token(const char *p, const char *end, strview_t *tok)
+{
+        while (p < end && is_blank(*p))
+                p++;
+        tok->data = p;
+        while (p < end && !is_blank(*p))
+                p++;
+        tok->len = (int)(p - tok->data);
+        return p;
+}
+
+static bool parse_address(const strview_t *tok, dns_addr_t *addr)
+{
+        char buf[INET6_ADDRSTRLEN];
+
+        if (tok->len == 0 || (size_t)tok->len >= sizeof(buf))
+                return false;
+        memcpy(buf, tok->data, (size_t)tok->len);
+        buf[tok->len] = '\0';
+
+        memset(addr, 0, sizeof(dns_addr_t));
+        if (inet_pton(AF_INET, buf, addr->addr) == 1) {
+                addr->family = AF_INET;
+                return true;
+        }
+        if (inet_pton(AF_INET6, buf, addr->addr) == 1) {
+                addr->family = AF_INET6;
+                return true;
+        }
+        return false;
+}
+
+/**
+ * Split a line, comment already cut off, into its address and names
+ */
+static bool parse_line(const char *line, size_t len, hosts_entry_t *ent)
+{
+        const char *end = line + len;
+        const char *p = NULL;
+        strview_t tok;
+
+        p = next_token(line, end, &tok);
+        if (!parse_address(&tok, &ent->addr))
+                return false;
+
+        ent->name_cnt = 0;
+        while (ent->name_cnt < HOSTS_NAMES_MAX) {
+                p = next_token(p, end, &tok);
+                if (tok.len == 0)
+                        break;
+                ent->names[ent->name_cnt++] = tok;
+        }
+        return ent->name_cnt > 0;
+}
+
+bool hosts_file_next(const hosts_file_t *hf, size_t *pos, hosts_entry_t *ent)
+{
+        const char *data = hf->map.data;
+        size_t size = hf->map.size;
+
+        while (*pos < size) {
+                const char *line = data + *pos;
+                const char *end = memchr(line, '\n', size - *pos);
+                size_t len = end != NULL ? (size_t)(end - line) : size - *pos;
+                const char *comment = memchr(line, '#', len);
+
+                ent->offset = *pos;
+                *pos += len + 1;
+                stats_read(0, len + 1);
+                if (comment != NULL)
+                        len = (size_t)(comment - line);
+                if (parse_line(line, len, ent)) {
+                        stats_read(1, 0);
+                        return true;
+                }
+        }
+        return false;
+}
+
+static bool name_equal(const strview_t *view, const char *name, size_t len)
+{
+        return (size_t)view->len == len && strncasecmp(view->data, name, len) == 0;
+}
+
+/**
+ * Parse the line at @offset, as recorded in the index
+ */
+static bool entry_at(const hosts_file_t *hf, uint32_t offset, hosts_entry_t *ent)
+{
+        size_t pos = offset;
+
+        return offset < hf->map.size && hosts_file_next(hf, &pos, ent) && ent->offset == offset;
+}
+
+bool hosts_file_find_name(const hosts_file_t *hf, const char *name, size_t *probe,
+                          hosts_entry_t *ent)
+{
+        size_t len = strlen(name);
+        uint32_t hash = hash_bytes(name, len, true);
+        size_t home = home_slot(hash, hf->name_slot_cnt);
+        size_t mask = hf->name_slot_cnt - 1;
+
+        while (*probe < hf->name_slot_cnt) {
+                const hosts_slot_t *slot = &hf->names[(home + *probe) & mask];
+
+                (*probe)++;
+                if (slot->offset == HOSTS_EMPTY_SLOT) {
+                        *probe = hf->name_slot_cnt;
+                        break;
+                }
+                if (slot->hash != hash || !entry_at(hf, slot->offset, ent))
+                        continue;
+                for (int i = 0; i < ent->name_cnt; i++)
+                        if (name_equal(&ent->names[i], name, len))
+                                return true;
+        }
+        return false;
+}
+
+bool hosts_file_find_addr(const hosts_file_t *hf, const dns_addr_t *addr, hosts_entry_t *ent)
+{
+        uint32_t hash = hash_addr(addr);
+        size_t home = home_slot(hash, hf->addr_slot_cnt);
+        size_t mask = hf->addr_slot_cnt - 1;
+
+        for (size_t probe = 0; probe < hf->addr_slot_cnt; probe++) {
+                const hosts_slot_t *slot = &hf->addrs[(home + probe) & mask];
+
+                if (slot->offset == HOSTS_EMPTY_SLOT)
+                        break;
+                if (slot->hash != hash || !entry_at(hf, slot->offset, ent))
+                        continue;
+                if (same_addr(&ent->addr, addr))
+                        return true;
+        }
+        return false;
+}
+
+static bool same_file(const hosts_index_header_t *hdr, const struct stat *st)
+{
+        return hdr->dev == (uint64_t)st->st_dev && hdr->ino == (uint64_t)st->st_ino &&
+               hdr->size == (uint64_t)st->st_size &&
+               hdr->mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+               hdr->mtime_nsec == (int64_t)st->st_mtim.tv_nsec;
+}
+
+static size_t index_size(uint32_t name_slot_cnt, uint32_t addr_slot_cnt)
+{
+        return sizeof(hosts_index_header_t) +
+               ((size_t)name_slot_cnt + addr_slot_cnt) * sizeof(hosts_slot_t);
+}
+
+static bool power_of_two(uint32_t n)
+{
+        return n != 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * Map the saved index, if it was built from the file we have mapped
+ */
+static bool load_index(hosts_file_t *hf, const char *path)
+{
+        const hosts_index_header_t *hdr = NULL;
+        struct stat st;
+        void *data = NULL;
+        int fd = -1;
+
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(hosts_index_header_t)) {
+                close(fd);
+                return false;
+        }
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+                return false;
+
+        hdr = data;
+        if (hdr->magic != HOSTS_INDEX_MAGIC || hdr->version != HOSTS_INDEX_VERSION ||
+            !same_file(hdr, &hf->map.st) || !power_of_two(hdr->name_slot_cnt) ||
+            !power_of_two(hdr->addr_slot_cnt) ||
+            index_size(hdr->name_slot_cnt, hdr->addr_slot_cnt) != (size_t)st.st_size) {
+                munmap(data, (size_t)st.st_size);
+                return false;
+        }
+        hf->index = data;
+        hf->index_size = (size_t)st.st_size;
+        hf->name_slot_cnt = hdr->name_slot_cnt;
+        hf->addr_slot_cnt = hdr->addr_slot_cnt;
+        hf->names = (const hosts_slot_t *)(hdr + 1);
+        hf->addrs = hf->names + hdr->name_slot_cnt;
+        return true;
+}
+
+/**
+ * Keys gathered while reading the file, in file order
+ */
+typedef struct hosts_keys {
+        hosts_slot_t *keys;
+        size_t cnt;
+        size_t size;
+} hosts_keys_t;
+
+static void keys_add(hosts_keys_t *keys, uint32_t hash, size_t offset)
+{
+        if (keys->cnt == keys->size) {
+                size_t size = keys->size == 0 ? 1024 : keys->size * 2;
+                hosts_slot_t *grown = realloc(keys->keys, size * sizeof(hosts_slot_t));
+
+                if (grown == NULL)
+                        err("Out of memory\n");
+                keys->keys = grown;
+                keys->size = size;
+        }
+        keys->keys[keys->cnt++] = (hosts_slot_t){ .hash = hash, .offset = (uint32_t)offset };
+}
+
+/**
+ * Stable radix sort by hash, which orders keys by home slot and keeps
+ * lines sharing a key in file order
+ */
+static void keys_sort(hosts_keys_t *keys)
+{
+        hosts_slot_t *tmp = malloc((keys->cnt + 1) * sizeof(hosts_slot_t));
+
+        if (tmp == NULL)
+                err("Out of memory\n");
+        for (int shift = 0; shift < 32; shift += 11) {
+                size_t counts[2049] = { 0 };
+                hosts_slot_t *swap = NULL;
+
+                for (size_t i = 0; i < keys->cnt; i++)
+                        counts[((keys->keys[i].hash >> shift) & 0x7ff) + 1]++;
+                for (size_t b = 1; b < 2049; b++)
+                        counts[b] += counts[b - 1];
+                for (size_t i = 0; i < keys->cnt; i++)
+                        tmp[counts[(keys->keys[i].hash >> shift) & 0x7ff]++] = keys->keys[i];
+                swap = keys->keys;
+                keys->keys = tmp;
+                tmp = swap;
+        }
+        free(tmp);
+}
+
+/**
+ * Keep the first line about each address, sorting having brought lines
+ * with the same hash together
+ */
+static void keys_dedupe_addrs(const hosts_file_t *hf, hosts_keys_t *keys)
+{
+        size_t kept = 0;
+        size_t run = 0; /**< First kept key with the current hash */
+
+        for (size_t i = 0; i < keys->cnt; i++) {
+                hosts_entry_t ent;
+                hosts_entry_t other;
+                bool dup = false;
+
+                if (kept == 0 || keys->keys[kept - 1].hash != keys->keys[i].hash)
+                        run = kept;
+                else if (entry_at(hf, keys->keys[i].offset, &ent))
+                        for (size_t j = run; j < kept && !dup; j++)
+                                dup = entry_at(hf, keys->keys[j].offset, &other) &&
+                                      same_addr(&ent.addr, &other.addr);
+                if (!dup)
+                        keys->keys[kept++] = keys->keys[i];
+        }
+        keys->cnt = kept;
+}
+
+static uint32_t slot_count(size_t keys)
+{
+        size_t cnt = 64;
+
+        while (cnt < keys * 2)
+                cnt <<= 1;
+        return cnt <= (size_t)1 << 31 ? (uint32_t)cnt : 0;
+}
+
+/**
+ * Lay sorted keys out for linear probing, in a single sweep: each key
+ * lands on its home slot, or right after the key before it. Keys pushed
+ * past the end wrap around to the first free slots.
+ */
+static hosts_slot_t *keys_table(const hosts_keys_t *keys, uint32_t slot_cnt)
+{
+        hosts_slot_t *slots = malloc(slot_cnt * sizeof(hosts_slot_t));
+        size_t next = 0;
+        size_t i = 0;
+
+        if (slots == NULL)
+                err("Out of memory\n");
+        memset(slots, 0xff, slot_cnt * sizeof(hosts_slot_t));
+
+        for (; i < keys->cnt; i++) {
+                size_t home = home_slot(keys->keys[i].hash, slot_cnt);
+                size_t pos = home > next ? home : next;
+
+                if (pos >= slot_cnt)
+                        break;
+                slots[pos] = keys->keys[i];
+                next = pos + 1;
+        }
+        for (next = 0; i < keys->cnt; i++) {
+                while (slots[next].offset != HOSTS_EMPTY_SLOT)
+                        next++;
+                slots[next] = keys->keys[i];
+        }
+        return slots;
+}
+
+/**
+ * Index the mapped file in memory. Keys are gathered in a single pass
+ * over the file and sorted before being laid out, rather than inserted
+ * one by one: scattered writes across tables of tens of megabytes cost
+ * far more than parsing the file.
+ */
+static bool build_index(hosts_file_t *hf)
+{
+        hosts_keys_t names = { 0 };
+        hosts_keys_t addrs = { 0 };
+        dns_addr_t last = { 0 };
+        hosts_entry_t ent;
+        size_t pos = 0;
+
+        while (hosts_file_next(hf, &pos, &ent)) {
+                /* Blocklists point millions of names in a row at the same
+                 * address, of which only the first line is ever looked up */
+                if (!same_addr(&ent.addr, &last))
+                        keys_add(&addrs, hash_addr(&ent.addr), ent.offset);
+                last = ent.addr;
+
+                for (int i = 0; i < ent.name_cnt; i++) {
+                        const strview_t *name = &ent.names[i];
+                        bool seen = false;
+
+                        /* A line naming a host twice is still found once */
+                        for (int j = 0; j < i && !seen; j++)
+                                seen = name_equal(&ent.names[j], name->data, (size_t)name->len);
+                        if (!seen)
+                                keys_add(&names,
+                                         hash_bytes(name->data, (size_t)name->len, true),
+                                         ent.offset);
+                }
+        }
+
+        hf->name_slot_cnt = slot_count(names.cnt);
+        hf->addr_slot_cnt = slot_count(addrs.cnt);
+        if (hf->name_slot_cnt != 0 && hf->addr_slot_cnt != 0) {
+                keys_sort(&names);
+                keys_sort(&addrs);
+                keys_dedupe_addrs(hf, &addrs);
+                hf->names = keys_table(&names, hf->name_slot_cnt);
+                hf->addrs = keys_table(&addrs, hf->addr_slot_cnt);
+        }
+        free(names.keys);
+        free(addrs.keys);
+        return hf->names != NULL;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+        const char *p = data;
+
+        while (len > 0) {
+                ssize_t r = write(fd, p, len);
+
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return false;
+                p += r;
+                len -= (size_t)r;
+        }
+        return true;
+}
+
+bool hosts_file_save_index(const hosts_file_t *hf, const char *path)
+{
+        hosts_index_header_t hdr = {
+                .magic = HOSTS_INDEX_MAGIC,
+                .version = HOSTS_INDEX_VERSION,
+                .dev = (uint64_t)hf->map.st.st_dev,
+                .ino = (uint64_t)hf->map.st.st_ino,
+                .size = (uint64_t)hf->map.st.st_size,
+                .mtime_sec = (int64_t)hf->map.st.st_mtim.tv_sec,
+                .mtime_nsec = (int64_t)hf->map.st.st_mtim.tv_nsec,
+                .name_slot_cnt = hf->name_slot_cnt,
+                .addr_slot_cnt = hf->addr_slot_cnt,
+        };
+        char tmp[PATH_MAX];
+        bool ok = false;
+        int fd = -1;
+
+        if ((size_t)snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp)) {
+                errno = ENAMETOOLONG;
+                return false;
+        }
+        fd = mkstemp(tmp);
+        if (fd < 0)
+                return false;
+        (void)fchmod(fd, 0644);
+        ok = write_all(fd, &hdr, sizeof(hdr)) &&
+             write_all(fd, hf->names, hf->name_slot_cnt * sizeof(hosts_slot_t)) &&
+             write_all(fd, hf->addrs, hf->addr_slot_cnt * sizeof(hosts_slot_t)) &&
+             fsync(fd) == 0;
+        if (close(fd) != 0)
+                ok = false;
+        if (!ok || rename(tmp, path) != 0) {
+                int saved = errno;
+
+                unlink(tmp);
+                errno = saved;
+                return false;
+        }
+        return true;
+}
+
+bool hosts_file_open(hosts_file_t *hf, const char *path, bool indexed)
+{
+        char index_path[PATH_MAX];
+        char db_dir[PATH_MAX];
+
+        memset(hf, 0, sizeof(hosts_file_t));
+        if (!files_map(path, &hf->map))
+                return false;
+        if (!indexed)
+                return true;
+
+        /* Offsets are kept in 32 bits, with UINT32_MAX marking empty slots */
+        if (hf->map.size >= UINT32_MAX) {
+                files_unmap(&hf->map);
+                errno = EFBIG;
+                return false;
+        }
+
+        if ((size_t)snprintf(index_path, sizeof(index_path), "%s/" HOSTS_INDEX_NAME,
+                             root_path(GETENT_DB_DIR, db_dir, sizeof(db_dir))) <
+                    sizeof(index_path) &&
+            load_index(hf, index_path)) {
+                if (hf->map.data != NULL)
+                        madvise((void *)hf->map.data, hf->map.size, MADV_RANDOM);
+                return true;
+        }
+        if (!build_index(hf)) {
+                files_unmap(&hf->map);
+                errno = EFBIG;
+                return false;
+        }
+        return true;
+}
+
+void hosts_file_close(hosts_file_t *hf)
+{
+        if (hf->index != NULL) {
+                munmap(hf->index, hf->index_size);
+        } else {
+                free((void *)hf->names);
+                free((void *)hf->addrs);
+        }
+        files_unmap(&hf->map);
+        memset(hf, 0, sizeof(hosts_file_t));
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
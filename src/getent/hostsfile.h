@@ -0,0 +1,91 @@
+#ifndef GETENT_HOSTSFILE_H
+#define GETENT_HOSTSFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns.h"
+#include "files.h"
+
+/**
+ * Native reader for hosts(5).
+ *
+ * The file is mapped and indexed by name (canonical names and aliases,
+ * ignoring case) and by address, so that a lookup costs a hash probe and
+ * the parse of the lines it lands on, however long the file is. Lookups
+ * only read the index getent-mkdb saves as GETENT_DB_DIR/hosts.idx: it is
+ * tied to the device, inode, size and mtime of the file it was built from,
+ * and when it is missing or stale each run builds its own in memory, a
+ * cost that grows with the file (0.3s for two million lines).
+ */
+#define HOSTS_NAMES_MAX 64
+
+#define HOSTS_INDEX_NAME "hosts.idx"
+
+/**
+ * A line of the hosts file, pointing into the mapping
+ */
+typedef struct hosts_entry {
+        size_t offset;                      /**< Offset of the line in the file */
+        dns_addr_t addr;                    /**< Address the line is about */
+        strview_t names[HOSTS_NAMES_MAX];   /**< Canonical name, then aliases */
+        int name_cnt;
+} hosts_entry_t;
+
+/**
+ * A slot of the index, UINT32_MAX offsets marking empty ones
+ */
+typedef struct hosts_slot {
+        uint32_t hash;   /**< Hash of the key, picking its first slot */
+        uint32_t offset; /**< Offset of the line holding the key */
+} hosts_slot_t;
+
+/**
+ * A mapped hosts file, and its index when opened with one
+ */
+typedef struct hosts_file {
+        files_map_t map;
+        const hosts_slot_t *names;
+        const hosts_slot_t *addrs;
+        uint32_t name_slot_cnt; /**< Power of two */
+        uint32_t addr_slot_cnt; /**< Power of two */
+        void *index;            /**< Mapping of the saved index, NULL if built here */
+        size_t index_size;
+} hosts_file_t;
+
+/**
+ * Map the hosts file at @path, loading or building its index when
+ * @indexed is set. Returns false with errno set if the file cannot be
+ * read, to EFBIG if it is too large for the index.
+ */
+extern bool hosts_file_open(hosts_file_t *hf, const char *path, bool indexed);
+
+/**
+ * Save the index of @hf, opened with one, as @path for later runs to load.
+ * Returns false with errno set if it cannot be written.
+ */
+extern bool hosts_file_save_index(const hosts_file_t *hf, const char *path);
+
+extern void hosts_file_close(hosts_file_t *hf);
+
+/**
+ * Parse the next valid line at or after @pos into @ent, skipping blank
+ * lines, comments and lines with a malformed address
+ */
+extern bool hosts_file_next(const hosts_file_t *hf, size_t *pos, hosts_entry_t *ent);
+
+/**
+ * Find the lines naming @name, in file order. @probe must start at 0 and
+ * is advanced by each call; returns false once there are no more.
+ */
+extern bool hosts_file_find_name(const hosts_file_t *hf, const char *name, size_t *probe,
+                                 hosts_entry_t *ent);
+
+/**
+ * Find the first line about @addr
+ */
+extern bool hosts_file_find_addr(const hosts_file_t *hf, const dns_addr_t *addr,
+                                 hosts_entry_t *ent);
+
+#endif
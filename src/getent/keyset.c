@@ -0,0 +1,153 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "getent.h"
+#include "keyset.h"
+
+static inline uint64_t hash_name(const char *name, size_t len)
+{
+        uint64_t h = 14695981039346656037ULL;
+
+        while (len-- > 0) {
+                h ^= (unsigned char)*name++;
+                h *= 1099511628211ULL;
+        }
+        return h;
+}
+
+static inline uint64_t hash_id(unsigned long id)
+{
+        uint64_t h = (uint64_t)id * 0x9E3779B97F4A7C15ULL;
+
+        return h ^ (h >> 29);
+}
+
+int keyset_find_name(const keyset_t *set, const char *name, size_t len)
+{
+        size_t slot = (size_t)hash_name(name, len) & set->mask;
+
+        for (; set->slots[slot] != 0; slot = (slot + 1) & set->mask) {
+                int pos = set->slots[slot] - 1;
+
+                if (set->numeric[pos])
+                        continue;
+                if (strncmp(set->keys[pos], name, len) == 0 && set->keys[pos][len] == '\0')
+                        return pos;
+        }
+        return -1;
+}
+
+int keyset_find_id(const keyset_t *set, unsigned long id)
+{
+        size_t slot = (size_t)hash_id(id) & set->mask;
+
+        for (; set->slots[slot] != 0; slot = (slot + 1) & set->mask) {
+                int pos = set->slots[slot] - 1;
+
+                if (set->numeric[pos] && set->ids[pos] == id)
+                        return pos;
+        }
+        return -1;
+}
+
+bool keyset_init(keyset_t *set, const char **keys, int key_cnt, bool numeric)
+{
+        size_t size = 16;
+
+        memset(set, 0, sizeof(keyset_t));
+        while (size < (size_t)key_cnt * 2)
+                size <<= 1;
+
+        set->keys = keys;
+        set->key_cnt = key_cnt;
+        set->mask = size - 1;
+        set->first = calloc((size_t)key_cnt, sizeof(int));
+        set->ids = calloc((size_t)key_cnt, sizeof(unsigned long));
+        set->numeric = calloc((size_t)key_cnt, sizeof(bool));
+        set->slots = calloc(size, sizeof(int));
+        if (set->first == NULL || set->ids == NULL || set->numeric == NULL || set->slots == NULL) {
+                keyset_free(set);
+                return false;
+        }
+
+        for (int i = 0; i < key_cnt; i++) {
+                const char *key = keys[i];
+                uint64_t h = 0;
+                int pos = -1;
+
+                if (numeric && is_numeric(key) == 1) {
+                        set->numeric[i] = true;
+                        set->ids[i] = strtoul(key, NULL, 10);
+                        h = hash_id(set->ids[i]);
+                        pos = keyset_find_id(set, set->ids[i]);
+                } else {
+                        h = hash_name(key, strlen(key));
+                        pos = keyset_find_name(set, key, strlen(key));
+                }
+
+                if (pos >= 0) {
+                        set->first[i] = pos;
+                        continue;
+                }
+
+                set->first[i] = i;
+                set->unique++;
+                for (size_t slot = (size_t)h & set->mask;; slot = (slot + 1) & set->mask) {
+                        if (set->slots[slot] == 0) {
+                                set->slots[slot] = i + 1;
+                                break;
+                        }
+                }
+        }
+
+        return true;
+}
+
+void keyset_free(keyset_t *set)
+{
+        free(set->first);
+        free(set->ids);
+        free(set->numeric);
+        free(set->slots);
+        memset(set, 0, sizeof(keyset_t));
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,48 @@
+#ifndef GETENT_KEYSET_H
+#define GETENT_KEYSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A keyset indexes the keys of a batch lookup so that a single pass over
+ * a database can tell, for every record, which of the keys it answers.
+ *
+ * Keys are stored by position: repeated keys resolve to the position of
+ * their first occurrence, so callers only have to store one result per
+ * unique key and can still print in the order the keys were given.
+ */
+typedef struct keyset {
+        const char **keys;  /**< Keys as handed to get_* */
+        int key_cnt;        /**< Number of keys */
+        int *first;         /**< Position of the first occurrence of each key */
+        unsigned long *ids; /**< Numeric value of each key, when numeric */
+        bool *numeric;      /**< Whether a key is looked up by id */
+        int *slots;         /**< Open addressing table of key positions + 1 */
+        size_t mask;        /**< Table size - 1 */
+        int unique;         /**< Number of unique keys */
+} keyset_t;
+
+/**
+ * Build the set for @keys. When @numeric is set, keys made only of digits
+ * are matched against record ids instead of record names.
+ * Returns false if we ran out of memory.
+ */
+extern bool keyset_init(keyset_t *set, const char **keys, int key_cnt, bool numeric);
+
+/**
+ * Return the position of the key named @name (not NUL terminated), or -1
+ */
+extern int keyset_find_name(const keyset_t *set, const char *name, size_t len);
+
+/**
+ * Return the position of the numeric key @id, or -1
+ */
+extern int keyset_find_id(const keyset_t *set, unsigned long id);
+
+/**
+ * Release storage held by the set
+ */
+extern void keyset_free(keyset_t *set);
+
+#endif
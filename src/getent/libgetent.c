@@ -0,0 +1,512 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <grp.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbfile.h"
+#include "files.h"
+#include "libgetent.h"
+
+#define PASSWD_FILE "/etc/passwd"
+#define GROUP_FILE "/etc/group"
+
+/**
+ * What a lookup is for: a name, or an id when @name is NULL
+ */
+typedef struct lookup_key {
+        const char *name;
+        unsigned long id;
+} lookup_key_t;
+
+void getent_arena_init(getent_arena_t *arena, void *buf, size_t size)
+{
+        arena->buf = buf;
+        arena->size = buf != NULL ? size : 0;
+        arena->used = 0;
+}
+
+void getent_arena_reset(getent_arena_t *arena)
+{
+        arena->used = 0;
+}
+
+static void *arena_alloc(getent_arena_t *arena, size_t size, size_t align)
+{
+        uintptr_t at = (uintptr_t)(arena->buf + arena->used);
+        size_t pad = (size_t)(-at & (align - 1));
+
+        if (arena->size - arena->used < pad || arena->size - arena->used - pad < size)
+                return NULL;
+        arena->used += pad + size;
+        return (char *)(at + pad);
+}
+
+static char *arena_strndup(getent_arena_t *arena, const char *s, size_t len)
+{
+        char *copy = arena_alloc(arena, len + 1, 1);
+
+        if (copy == NULL)
+                return NULL;
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+        return copy;
+}
+
+static char *arena_view(getent_arena_t *arena, const strview_t *view)
+{
+        return arena_strndup(arena, view->data, (size_t)view->len);
+}
+
+static bool view_equal(const strview_t *view, const char *s)
+{
+        return strncmp(view->data, s, (size_t)view->len) == 0 && s[view->len] == '\0';
+}
+
+/**
+ * Copy @pwd into @arena, restoring the arena if it does not fit
+ */
+static int build_passwd(const passwd_view_t *view, getent_arena_t *arena, struct passwd **result)
+{
+        size_t used = arena->used;
+        struct passwd *pwd = arena_alloc(arena, sizeof(struct passwd), alignof(struct passwd));
+
+        if (pwd == NULL)
+                return ERANGE;
+        pwd->pw_name = arena_view(arena, &view->name);
+        pwd->pw_passwd = arena_view(arena, &view->passwd);
+        pwd->pw_uid = view->uid;
+        pwd->pw_gid = view->gid;
+        pwd->pw_gecos = arena_view(arena, &view->gecos);
+        pwd->pw_dir = arena_view(arena, &view->dir);
+        pwd->pw_shell = arena_view(arena, &view->shell);
+        if (pwd->pw_name == NULL || pwd->pw_passwd == NULL || pwd->pw_gecos == NULL ||
+            pwd->pw_dir == NULL || pwd->pw_shell == NULL) {
+                arena->used = used;
+                return ERANGE;
+        }
+        *result = pwd;
+        return 0;
+}
+
+/**
+ * Copy @view into @arena, splitting the member list. Empty members are
+ * left out, as getent prints them.
+ */
+static int build_group(const group_view_t *view, getent_arena_t *arena, struct group **result)
+{
+        size_t used = arena->used;
+        const char *memb = view->members.data;
+        const char *end = memb + view->members.len;
+        size_t memb_cnt = 0;
+        struct group *grp = arena_alloc(arena, sizeof(struct group), alignof(struct group));
+        char **members = NULL;
+
+        for (const char *p = memb; p < end; p++)
+                if (*p == view->member_sep)
+                        memb_cnt++;
+        members = arena_alloc(arena, (memb_cnt + 2) * sizeof(char *), alignof(char *));
+        if (grp == NULL || members == NULL) {
+                arena->used = used;
+                return ERANGE;
+        }
+
+        memb_cnt = 0;
+        while (memb < end) {
+                const char *sep = memchr(memb, view->member_sep, (size_t)(end - memb));
+                size_t len = (size_t)((sep != NULL ? sep : end) - memb);
+
+                if (len > 0 && (members[memb_cnt++] = arena_strndup(arena, memb, len)) == NULL) {
+                        arena->used = used;
+                        return ERANGE;
+                }
+                memb += len + 1;
+        }
+        members[memb_cnt] = NULL;
+
+        grp->gr_name = arena_view(arena, &view->name);
+        grp->gr_passwd = arena_view(arena, &view->passwd);
+        grp->gr_gid = view->gid;
+        grp->gr_mem = members;
+        if (grp->gr_name == NULL || grp->gr_passwd == NULL) {
+                arena->used = used;
+                return ERANGE;
+        }
+        *result = grp;
+        return 0;
+}
+
+/**
+ * Find @key in the getent-mkdb index of @database
+ */
+static int find_db(const char *database, const lookup_key_t *key, dbfile_t *db, dbrecord_t *rec)
+{
+        char path[PATH_MAX];
+
+        if (!dbfile_open(db, dbfile_path(NULL, database, path, sizeof(path))))
+                return ENOENT;
+        if (key->name != NULL ? dbfile_find_name(db, key->name, rec)
+                              : dbfile_find_id(db, key->id, rec))
+                return 0;
+        dbfile_close(db);
+        return ENOENT;
+}
+
+static int passwd_db(const lookup_key_t *key, getent_arena_t *arena, struct passwd **result)
+{
+        dbfile_t db;
+        dbrecord_t rec;
+        passwd_view_t view;
+        int res = find_db("password", key, &db, &rec);
+
+        if (res != 0)
+                return res;
+        dbfile_passwd_view(&rec, &view);
+        res = build_passwd(&view, arena, result);
+        dbfile_close(&db);
+        return res;
+}
+
+static int group_db(const lookup_key_t *key, getent_arena_t *arena, struct group **result)
+{
+        dbfile_t db;
+        dbrecord_t rec;
+        group_view_t view;
+        int res = find_db("group", key, &db, &rec);
+
+        if (res != 0)
+                return res;
+        dbfile_group_view(&rec, &view);
+        res = build_group(&view, arena, result);
+        dbfile_close(&db);
+        return res;
+}
+
+static int passwd_files(const lookup_key_t *key, getent_arena_t *arena, struct passwd **result)
+{
+        files_map_t map;
+        passwd_view_t view;
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+        int res = ENOENT;
+
+        if (!files_map(PASSWD_FILE, &map))
+                return ENOENT;
+        while (res == ENOENT && files_next(&map, &pos, &record, &len)) {
+                if (!files_parse_passwd(record, len, &view))
+                        continue;
+                if (key->name != NULL ? view_equal(&view.name, key->name) : view.uid == key->id)
+                        res = build_passwd(&view, arena, result);
+        }
+        files_unmap(&map);
+        return res;
+}
+
+static int group_files(const lookup_key_t *key, getent_arena_t *arena, struct group **result)
+{
+        files_map_t map;
+        group_view_t view;
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = 0;
+        int res = ENOENT;
+
+        if (!files_map(GROUP_FILE, &map))
+                return ENOENT;
+        while (res == ENOENT && files_next(&map, &pos, &record, &len)) {
+                if (!files_parse_group(record, len, &view))
+                        continue;
+                if (key->name != NULL ? view_equal(&view.name, key->name) : view.gid == key->id)
+                        res = build_group(&view, arena, result);
+        }
+        files_unmap(&map);
+        return res;
+}
+
+/**
+ * Extend @end past the string @s when libc put it in @buf
+ */
+static void claim(const char *buf, size_t len, const char *s, const char **end)
+{
+        const char *s_end = NULL;
+
+        if (s == NULL || s < buf || s >= buf + len)
+                return;
+        s_end = s + strlen(s) + 1;
+        if (s_end > *end)
+                *end = s_end;
+}
+
+/**
+ * Settle the outcome of a getpw*_r() or getgr*_r() call made with the
+ * free space of @arena, keeping what libc used of it
+ */
+static int libc_result(int err, bool found, getent_arena_t *arena, size_t used, const char *end)
+{
+        if (err == ERANGE) {
+                arena->used = used;
+                return ERANGE;
+        }
+        /* POSIX lets these stand for "no such entry" */
+        if (err == 0 && !found)
+                err = ENOENT;
+        if (err == ESRCH || err == EBADF || err == EPERM)
+                err = ENOENT;
+        if (err != 0) {
+                arena->used = used;
+                return err;
+        }
+        arena->used = (size_t)(end - arena->buf);
+        return 0;
+}
+
+static int passwd_libc(const lookup_key_t *key, getent_arena_t *arena, struct passwd **result)
+{
+        size_t used = arena->used;
+        struct passwd *pwd = arena_alloc(arena, sizeof(struct passwd), alignof(struct passwd));
+        char *buf = arena->buf + arena->used;
+        size_t len = arena->size - arena->used;
+        const char *end = buf;
+        struct passwd *found = NULL;
+        int err = 0;
+
+        if (pwd == NULL)
+                return ERANGE;
+        if (key->name != NULL)
+                err = getpwnam_r(key->name, pwd, buf, len, &found);
+        else
+                err = getpwuid_r((uid_t)key->id, pwd, buf, len, &found);
+        if (err == 0 && found != NULL) {
+                claim(buf, len, pwd->pw_name, &end);
+                claim(buf, len, pwd->pw_passwd, &end);
+                claim(buf, len, pwd->pw_gecos, &end);
+                claim(buf, len, pwd->pw_dir, &end);
+                claim(buf, len, pwd->pw_shell, &end);
+                *result = pwd;
+        }
+        return libc_result(err, found != NULL, arena, used, end);
+}
+
+static int group_libc(const lookup_key_t *key, getent_arena_t *arena, struct group **result)
+{
+        size_t used = arena->used;
+        struct group *grp = arena_alloc(arena, sizeof(struct group), alignof(struct group));
+        char *buf = arena->buf + arena->used;
+        size_t len = arena->size - arena->used;
+        const char *end = buf;
+        struct group *found = NULL;
+        int err = 0;
+
+        if (grp == NULL)
+                return ERANGE;
+        if (key->name != NULL)
+                err = getgrnam_r(key->name, grp, buf, len, &found);
+        else
+                err = getgrgid_r((gid_t)key->id, grp, buf, len, &found);
+        if (err == 0 && found != NULL) {
+                char **memb = grp->gr_mem;
+
+                claim(buf, len, grp->gr_name, &end);
+                claim(buf, len, grp->gr_passwd, &end);
+                for (; memb != NULL && *memb != NULL; memb++)
+                        claim(buf, len, *memb, &end);
+                if (memb != NULL && (const char *)(memb + 1) > end &&
+                    (const char *)memb >= buf && (const char *)memb < buf + len)
+                        end = (const char *)(memb + 1);
+                *result = grp;
+        }
+        return libc_result(err, found != NULL, arena, used, end);
+}
+
+static int lookup_passwd(const lookup_key_t *key, unsigned int sources, getent_arena_t *arena,
+                         struct passwd **result)
+{
+        int res = ENOENT;
+
+        *result = NULL;
+        if (sources == 0)
+                sources = GETENT_SOURCE_DEFAULT;
+        if (res == ENOENT && (sources & GETENT_SOURCE_DB))
+                res = passwd_db(key, arena, result);
+        if (res == ENOENT && (sources & GETENT_SOURCE_FILES))
+                res = passwd_files(key, arena, result);
+        if (res == ENOENT && (sources & GETENT_SOURCE_LIBC))
+                res = passwd_libc(key, arena, result);
+        return res;
+}
+
+static int lookup_group(const lookup_key_t *key, unsigned int sources, getent_arena_t *arena,
+                        struct group **result)
+{
+        int res = ENOENT;
+
+        *result = NULL;
+        if (sources == 0)
+                sources = GETENT_SOURCE_DEFAULT;
+        if (res == ENOENT && (sources & GETENT_SOURCE_DB))
+                res = group_db(key, arena, result);
+        if (res == ENOENT && (sources & GETENT_SOURCE_FILES))
+                res = group_files(key, arena, result);
+        if (res == ENOENT && (sources & GETENT_SOURCE_LIBC))
+                res = group_libc(key, arena, result);
+        return res;
+}
+
+int getent_getpwnam(const char *name, unsigned int sources, getent_arena_t *arena,
+                    struct passwd **result)
+{
+        lookup_key_t key = { .name = name, .id = 0 };
+
+        return lookup_passwd(&key, sources, arena, result);
+}
+
+int getent_getpwuid(uid_t uid, unsigned int sources, getent_arena_t *arena,
+                    struct passwd **result)
+{
+        lookup_key_t key = { .name = NULL, .id = uid };
+
+        return lookup_passwd(&key, sources, arena, result);
+}
+
+int getent_getgrnam(const char *name, unsigned int sources, getent_arena_t *arena,
+                    struct group **result)
+{
+        lookup_key_t key = { .name = name, .id = 0 };
+
+        return lookup_group(&key, sources, arena, result);
+}
+
+int getent_getgrgid(gid_t gid, unsigned int sources, getent_arena_t *arena,
+                    struct group **result)
+{
+        lookup_key_t key = { .name = NULL, .id = gid };
+
+        return lookup_group(&key, sources, arena, result);
+}
+
+static int iter_open(const char *path, getent_iter_t *iter)
+{
+        files_map_t map;
+
+        memset(iter, 0, sizeof(getent_iter_t));
+        if (!files_map(path, &map))
+                return ENOENT;
+        iter->data = map.data;
+        iter->size = map.size;
+        return 0;
+}
+
+/**
+ * Find the next record of @iter, as files_next() does
+ */
+static bool iter_next(getent_iter_t *iter, const char **record, size_t *len)
+{
+        files_map_t map = { .data = iter->data, .size = iter->size };
+
+        return files_next(&map, &iter->pos, record, len);
+}
+
+int getent_passwd_iter_open(getent_iter_t *iter)
+{
+        return iter_open(PASSWD_FILE, iter);
+}
+
+int getent_group_iter_open(getent_iter_t *iter)
+{
+        return iter_open(GROUP_FILE, iter);
+}
+
+int getent_passwd_iter_next(getent_iter_t *iter, getent_arena_t *arena, struct passwd **result)
+{
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = iter->pos;
+        passwd_view_t view;
+
+        *result = NULL;
+        while (iter_next(iter, &record, &len)) {
+                if (!files_parse_passwd(record, len, &view)) {
+                        pos = iter->pos;
+                        continue;
+                }
+                if (build_passwd(&view, arena, result) == 0)
+                        return 0;
+                /* Hand the same record out again once there is room */
+                iter->pos = pos;
+                return ERANGE;
+        }
+        return ENOENT;
+}
+
+int getent_group_iter_next(getent_iter_t *iter, getent_arena_t *arena, struct group **result)
+{
+        const char *record = NULL;
+        size_t len = 0;
+        size_t pos = iter->pos;
+        group_view_t view;
+
+        *result = NULL;
+        while (iter_next(iter, &record, &len)) {
+                if (!files_parse_group(record, len, &view)) {
+                        pos = iter->pos;
+                        continue;
+                }
+                if (build_group(&view, arena, result) == 0)
+                        return 0;
+                iter->pos = pos;
+                return ERANGE;
+        }
+        return ENOENT;
+}
+
+void getent_iter_close(getent_iter_t *iter)
+{
+        files_map_t map = { .data = iter->data, .size = iter->size };
+
+        files_unmap(&map);
+        memset(iter, 0, sizeof(getent_iter_t));
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
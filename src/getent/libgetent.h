@@ -0,0 +1,101 @@
+#ifndef LIBGETENT_H
+#define LIBGETENT_H
+
+#include <grp.h>
+#include <pwd.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * libgetent: thread safe passwd and group lookups.
+ *
+ * This is the database layer behind getent, for programs that would
+ * rather look entries up in-process than run getent. Nothing is kept
+ * between calls: every result is built in an arena the caller provides,
+ * so any number of threads may look up at once, each with an arena of
+ * its own.
+ *
+ * Lookups return 0 when an entry was found, ENOENT when none matches and
+ * ERANGE when the arena is too small for it (the arena is left as it was,
+ * retry with a larger one). Other errno values come from libc.
+ */
+
+/**
+ * Memory results are carved from. Results stay valid until the arena is
+ * reset or its buffer is released.
+ */
+typedef struct getent_arena {
+        char *buf;   /**< Caller's buffer */
+        size_t size; /**< Size of @buf */
+        size_t used; /**< Bytes handed out */
+} getent_arena_t;
+
+/**
+ * Where lookups look, in this order: the getent-mkdb index, the files in
+ * /etc, then libc and whatever nsswitch.conf configures for it. 0 means
+ * GETENT_SOURCE_DEFAULT, files then libc, as getent does without -s.
+ */
+enum {
+        GETENT_SOURCE_DB = 1 << 0,
+        GETENT_SOURCE_FILES = 1 << 1,
+        GETENT_SOURCE_LIBC = 1 << 2,
+        GETENT_SOURCE_DEFAULT = GETENT_SOURCE_FILES | GETENT_SOURCE_LIBC,
+};
+
+/**
+ * Walks the records of a file in /etc. Enumeration covers the files only,
+ * since libc cannot enumerate without shared state.
+ */
+typedef struct getent_iter {
+        const char *data;
+        size_t size;
+        size_t pos;
+} getent_iter_t;
+
+extern void getent_arena_init(getent_arena_t *arena, void *buf, size_t size);
+
+/**
+ * Forget every result carved from @arena
+ */
+extern void getent_arena_reset(getent_arena_t *arena);
+
+extern int getent_getpwnam(const char *name, unsigned int sources, getent_arena_t *arena,
+                           struct passwd **result);
+
+extern int getent_getpwuid(uid_t uid, unsigned int sources, getent_arena_t *arena,
+                           struct passwd **result);
+
+extern int getent_getgrnam(const char *name, unsigned int sources, getent_arena_t *arena,
+                           struct group **result);
+
+extern int getent_getgrgid(gid_t gid, unsigned int sources, getent_arena_t *arena,
+                           struct group **result);
+
+/**
+ * Start walking /etc/passwd or /etc/group. Returns ENOENT when the file
+ * is missing; release the iterator with getent_iter_close() otherwise.
+ */
+extern int getent_passwd_iter_open(getent_iter_t *iter);
+
+extern int getent_group_iter_open(getent_iter_t *iter);
+
+/**
+ * Build the next record in @arena. Returns ENOENT after the last one.
+ */
+extern int getent_passwd_iter_next(getent_iter_t *iter, getent_arena_t *arena,
+                                   struct passwd **result);
+
+extern int getent_group_iter_next(getent_iter_t *iter, getent_arena_t *arena,
+                                  struct group **result);
+
+extern void getent_iter_close(getent_iter_t *iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,625 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "dbfile.h"
+#include "getent.h"
+#include "hostsfile.h"
+
+/**
+ * Give up on a seed search after this many attempts, and grow the table
+ */
+#define SEED_ATTEMPTS_MAX (1U << 20)
+
+/**
+ * Source layout of a database we know how to index
+ */
+typedef struct mkdb_source {
+        const char *name;   /**< Database name, as used by getent */
+        const char *file;   /**< File name in the source directory */
+        int fields;         /**< Number of colon separated fields */
+        int id_field;       /**< Field holding the numeric id, or -1 */
+        bool members;       /**< Last field is a comma separated list */
+} mkdb_source_t;
+
+static const mkdb_source_t sources[] = {
+        { .name = "password", .file = "passwd", .fields = 7, .id_field = 2, .members = false },
+        { .name = "group", .file = "group", .fields = 4, .id_field = 2, .members = true },
+        { .name = "shadow", .file = "shadow", .fields = 9, .id_field = -1, .members = false },
+};
+
+/**
+ * A key to place in a perfect hash table
+ */
+typedef struct mkdb_key {
+        const void *data;
+        size_t len;
+        uint32_t id;     /**< Storage for numeric keys */
+        uint32_t offset; /**< Offset of the record */
+        uint32_t bucket;
+} mkdb_key_t;
+
+typedef struct mkdb_buffer {
+        unsigned char *data;
+        size_t len;
+        size_t size;
+} mkdb_buffer_t;
+
+static void buffer_append(mkdb_buffer_t *buf, const void *data, size_t len)
+{
+        if (buf->len + len > buf->size) {
+                size_t size = buf->size == 0 ? 65536 : buf->size;
+                unsigned char *grown = NULL;
+
+                while (size < buf->len + len)
+                        size *= 2;
+                grown = realloc(buf->data, size);
+                if (grown == NULL)
+                        err("Out of memory\n");
+                buf->data = grown;
+                buf->size = size;
+        }
+        memcpy(buf->data + buf->len, data, len);
+        buf->len += len;
+}
+
+static void buffer_align(mkdb_buffer_t *buf, size_t align)
+{
+        static const unsigned char zero[8] = { 0 };
+
+        if (buf->len % align != 0)
+                buffer_append(buf, zero, align - buf->len % align);
+}
+
+static int compare_bucket_size(const void *a, const void *b, void *sizes)
+{
+        uint32_t sa = ((const uint32_t *)sizes)[*(const uint32_t *)a];
+        uint32_t sb = ((const uint32_t *)sizes)[*(const uint32_t *)b];
+
+        return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/**
+ * Place @keys into a table of @idx->slot_cnt slots, searching a seed per
+ * bucket so that no two keys share a slot. Buckets are handled largest
+ * first, while the table is still mostly empty.
+ */
+static bool build_table(mkdb_key_t *keys, size_t key_cnt, dbfile_index_t *idx, uint32_t *seeds,
+                        uint32_t *slots)
+{
+        uint32_t *sizes = calloc(idx->bucket_cnt, sizeof(uint32_t));
+        uint32_t *starts = calloc(idx->bucket_cnt + 1, sizeof(uint32_t));
+        uint32_t *order = calloc(idx->bucket_cnt, sizeof(uint32_t));
+        uint32_t *members = calloc(key_cnt + 1, sizeof(uint32_t));
+        uint32_t *placed = calloc(key_cnt + 1, sizeof(uint32_t));
+        bool ok = true;
+
+        if (sizes == NULL || starts == NULL || order == NULL || members == NULL || placed == NULL)
+                err("Out of memory\n");
+
+        for (size_t i = 0; i < key_cnt; i++) {
+                keys[i].bucket = (uint32_t)(dbfile_hash(keys[i].data, keys[i].len, 0) %
+                                            idx->bucket_cnt);
+                sizes[keys[i].bucket]++;
+        }
+        for (uint32_t b = 0; b < idx->bucket_cnt; b++) {
+                starts[b + 1] = starts[b] + sizes[b];
+                order[b] = b;
+        }
+        for (size_t i = 0; i < key_cnt; i++)
+                members[starts[keys[i].bucket] + placed[keys[i].bucket]++] = (uint32_t)i;
+        qsort_r(order, idx->bucket_cnt, sizeof(uint32_t), compare_bucket_size, sizes);
+
+        for (uint32_t s = 0; s < idx->slot_cnt; s++)
+                slots[s] = DBFILE_EMPTY_SLOT;
+        memset(seeds, 0, idx->bucket_cnt * sizeof(uint32_t));
+
+        for (uint32_t o = 0; o < idx->bucket_cnt && ok; o++) {
+                uint32_t b = order[o];
+                uint32_t seed = 1;
+
+                if (sizes[b] == 0)
+                        break;
+                for (; seed < SEED_ATTEMPTS_MAX; seed++) {
+                        uint32_t i = 0;
+
+                        for (i = 0; i < sizes[b]; i++) {
+                                mkdb_key_t *k = &keys[members[starts[b] + i]];
+                                uint32_t slot = (uint32_t)(dbfile_hash(k->data, k->len, seed) %
+                                                           idx->slot_cnt);
+
+                                placed[i] = slot;
+                                if (slots[slot] != DBFILE_EMPTY_SLOT)
+                                        break;
+                                /* Keys of one bucket must not collide either */
+                                slots[slot] = k->offset;
+                        }
+                        if (i == sizes[b])
+                                break;
+                        while (i-- > 0)
+                                slots[placed[i]] = DBFILE_EMPTY_SLOT;
+                }
+                if (seed == SEED_ATTEMPTS_MAX)
+                        ok = false;
+                seeds[b] = seed;
+        }
+
+        free(sizes);
+        free(starts);
+        free(order);
+        free(members);
+        free(placed);
+        return ok;
+}
+
+/**
+ * Append the index over @keys to @out and describe it in @idx
+ */
+static void write_index(mkdb_buffer_t *out, mkdb_key_t *keys, size_t key_cnt, dbfile_index_t *idx)
+{
+        uint32_t *seeds = NULL;
+        uint32_t *slots = NULL;
+
+        memset(idx, 0, sizeof(dbfile_index_t));
+        if (key_cnt == 0)
+                return;
+
+        idx->bucket_cnt = (uint32_t)((key_cnt + 3) / 4);
+        idx->slot_cnt = (uint32_t)(key_cnt + key_cnt / 4 + 1);
+        for (;;) {
+                seeds = calloc(idx->bucket_cnt, sizeof(uint32_t));
+                slots = calloc(idx->slot_cnt, sizeof(uint32_t));
+                if (seeds == NULL || slots == NULL)
+                        err("Out of memory\n");
+                if (build_table(keys, key_cnt, idx, seeds, slots))
+                        break;
+                free(seeds);
+                free(slots);
+                idx->slot_cnt += idx->slot_cnt / 8 + 1;
+        }
+
+        buffer_align(out, sizeof(uint32_t));
+        idx->seeds_off = out->len;
+        buffer_append(out, seeds, idx->bucket_cnt * sizeof(uint32_t));
+        idx->slots_off = out->len;
+        buffer_append(out, slots, idx->slot_cnt * sizeof(uint32_t));
+        free(seeds);
+        free(slots);
+}
+
+static char *read_file(const char *path, size_t *len, struct stat *owner)
+{
+        struct stat st;
+        char *data = NULL;
+        size_t done = 0;
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+                return NULL;
+        if (fstat(fd, &st) != 0 || (data = malloc((size_t)st.st_size + 1)) == NULL) {
+                close(fd);
+                return NULL;
+        }
+        while (done < (size_t)st.st_size) {
+                ssize_t r = read(fd, data + done, (size_t)st.st_size - done);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        break;
+                done += (size_t)r;
+        }
+        close(fd);
+        data[done] = '\0';
+        *len = done;
+        *owner = st;
+        return data;
+}
+
+/**
+ * Whether @key was seen before, remembering it otherwise. Duplicate
+ * keys can never be separated by a perfect hash, and libc answers with
+ * the first record anyway.
+ */
+static bool seen_key(mkdb_key_t *table, size_t table_size, const mkdb_key_t *key)
+{
+        size_t slot = (size_t)dbfile_hash(key->data, key->len, UINT32_MAX) % table_size;
+
+        for (; table[slot].data != NULL; slot = (slot + 1) % table_size)
+                if (table[slot].len == key->len &&
+                    memcmp(table[slot].data, key->data, key->len) == 0)
+                        return true;
+        table[slot] = *key;
+        return false;
+}
+
+/**
+ * Replace @path with @out, owned and accessible like the source file
+ * described by @owner, so that shadow.db stays as private as shadow
+ */
+static bool write_file(const char *path, const mkdb_buffer_t *out, const struct stat *owner)
+{
+        char tmp[PATH_MAX];
+        size_t done = 0;
+        int fd = -1;
+
+        if ((size_t)snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp)) {
+                errno = ENAMETOOLONG;
+                return false;
+        }
+        fd = mkstemp(tmp);
+        if (fd < 0)
+                return false;
+        /* Only root may give files away, anyone else keeps them */
+        (void)fchown(fd, owner->st_uid, owner->st_gid);
+        (void)fchmod(fd, owner->st_mode & 0777);
+        while (done < out->len) {
+                ssize_t r = write(fd, out->data + done, out->len - done);
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        break;
+                done += (size_t)r;
+        }
+        if (done != out->len || fsync(fd) != 0 || close(fd) != 0 || rename(tmp, path) != 0) {
+                unlink(tmp);
+                return false;
+        }
+        return true;
+}
+
+/**
+ * Build the index for @src from the file in @source_dir
+ */
+static bool build_database(const mkdb_source_t *src, const char *source_dir, const char *output_dir)
+{
+        char in_path[PATH_MAX];
+        char out_path[PATH_MAX];
+        mkdb_buffer_t records = { 0 };
+        mkdb_buffer_t out = { 0 };
+        dbfile_header_t hdr;
+        mkdb_key_t *names = NULL;
+        mkdb_key_t *ids = NULL;
+        mkdb_key_t *seen_names = NULL;
+        mkdb_key_t *seen_ids = NULL;
+        size_t name_cnt = 0;
+        size_t id_cnt = 0;
+        size_t line_cnt = 1;
+        size_t seen_size = 0;
+        char *data = NULL;
+        char *line = NULL;
+        size_t len = 0;
+        struct stat owner;
+
+        snprintf(in_path, sizeof(in_path), "%s/%s", source_dir, src->file);
+        data = read_file(in_path, &len, &owner);
+        if (data == NULL) {
+                fprintf(stderr, "Unable to read %s: %s\n", in_path, strerror(errno));
+                return false;
+        }
+
+        for (size_t i = 0; i < len; i++)
+                if (data[i] == '\n')
+                        line_cnt++;
+        seen_size = line_cnt * 4 + 1;
+        names = calloc(line_cnt, sizeof(mkdb_key_t));
+        ids = calloc(line_cnt, sizeof(mkdb_key_t));
+        seen_names = calloc(seen_size, sizeof(mkdb_key_t));
+        seen_ids = calloc(seen_size, sizeof(mkdb_key_t));
+        if (names == NULL || ids == NULL || seen_names == NULL || seen_ids == NULL)
+                err("Out of memory\n");
+
+        memset(&hdr, 0, sizeof(hdr));
+        for (line = data; line < data + len;) {
+                char *next = strchr(line, '\n');
+                char *fields[DBFILE_FIELDS_MAX];
+                int field_cnt = 0;
+                uint32_t record_len = 0;
+                uint32_t offset = (uint32_t)records.len;
+
+                if (next != NULL)
+                        *next++ = '\0';
+                else
+                        next = data + len;
+
+                if (*line == '\0' || *line == '#' || *line == '+' || *line == '-') {
+                        line = next;
+                        continue;
+                }
+
+                for (char *p = line; field_cnt < src->fields; field_cnt++) {
+                        fields[field_cnt] = p;
+                        p = strchr(p, ':');
+                        if (p == NULL) {
+                                field_cnt++;
+                                break;
+                        }
+                        *p++ = '\0';
+                }
+                line = next;
+                if (field_cnt != src->fields || *fields[0] == '\0')
+                        continue;
+                /* An empty id would be indexed as 0, next to root */
+                if (src->id_field >= 0 && (*fields[src->id_field] == '\0' ||
+                                           is_numeric(fields[src->id_field]) != 1))
+                        continue;
+
+                /* Fixed fields, then the member list split into trailing fields */
+                record_len = sizeof(uint32_t);
+                buffer_append(&records, &record_len, sizeof(record_len));
+                for (int f = 0; f < src->fields; f++) {
+                        char *memb = fields[f];
+
+                        if (!src->members || f != src->fields - 1) {
+                                buffer_append(&records, fields[f], strlen(fields[f]) + 1);
+                                continue;
+                        }
+                        while (*memb != '\0') {
+                                size_t memb_len = strcspn(memb, ",");
+
+                                if (memb_len > 0) {
+                                        buffer_append(&records, memb, memb_len);
+                                        buffer_append(&records, "", 1);
+                                }
+                                memb += memb_len;
+                                if (*memb == ',')
+                                        memb++;
+                        }
+                }
+                record_len = (uint32_t)(records.len - offset);
+                memcpy(records.data + offset, &record_len, sizeof(record_len));
+
+                hdr.record_cnt++;
+                names[name_cnt] = (mkdb_key_t){
+                        .data = fields[0],
+                        .len = strlen(fields[0]),
+                        .offset = offset,
+                };
+                if (!seen_key(seen_names, seen_size, &names[name_cnt]))
+                        name_cnt++;
+
+                if (src->id_field < 0)
+                        continue;
+                ids[id_cnt] = (mkdb_key_t){
+                        .id = (uint32_t)strtoul(fields[src->id_field], NULL, 10),
+                        .len = sizeof(uint32_t),
+                        .offset = offset,
+                };
+                ids[id_cnt].data = &ids[id_cnt].id;
+                if (!seen_key(seen_ids, seen_size, &ids[id_cnt]))
+                        id_cnt++;
+        }
+
+        hdr.magic = DBFILE_MAGIC;
+        hdr.version = DBFILE_VERSION;
+        hdr.fields = (uint32_t)(src->members ? src->fields - 1 : src->fields);
+        hdr.id_field = src->id_field;
+
+        buffer_append(&out, &hdr, sizeof(hdr));
+        buffer_align(&out, 8);
+        hdr.records_off = out.len;
+        hdr.records_size = records.len;
+        buffer_append(&out, records.data, records.len);
+        write_index(&out, names, name_cnt, &hdr.index[DBFILE_INDEX_NAME]);
+        write_index(&out, ids, id_cnt, &hdr.index[DBFILE_INDEX_ID]);
+        memcpy(out.data, &hdr, sizeof(hdr));
+
+        dbfile_path(output_dir, src->name, out_path, sizeof(out_path));
+        if (!write_file(out_path, &out, &owner)) {
+                fprintf(stderr, "Unable to write %s: %s\n", out_path, strerror(errno));
+                return false;
+        }
+
+        free(records.data);
+        free(out.data);
+        free(names);
+        free(ids);
+        free(seen_names);
+        free(seen_ids);
+        free(data);
+        return true;
+}
+
+/**
+ * Save the index the hosts databases load, which hostsfile.c lays out
+ * itself, as one line of the hosts file can name many hosts
+ */
+static bool build_hosts(const char *source_dir, const char *output_dir)
+{
+        char in_path[PATH_MAX];
+        char out_path[PATH_MAX];
+        hosts_file_t hf;
+        bool ok = false;
+
+        snprintf(in_path, sizeof(in_path), "%s/hosts", source_dir);
+        if ((size_t)snprintf(out_path, sizeof(out_path), "%s/" HOSTS_INDEX_NAME, output_dir) >=
+            sizeof(out_path)) {
+                fprintf(stderr, "Unable to write %s/" HOSTS_INDEX_NAME ": %s\n", output_dir,
+                        strerror(ENAMETOOLONG));
+                return false;
+        }
+        if (!hosts_file_open(&hf, in_path, true)) {
+                fprintf(stderr, "Unable to index %s: %s\n", in_path, strerror(errno));
+                return false;
+        }
+        ok = hosts_file_save_index(&hf, out_path);
+        if (!ok)
+                fprintf(stderr, "Unable to write %s: %s\n", out_path, strerror(errno));
+        hosts_file_close(&hf);
+        return ok;
+}
+
+/**
+ * Program arguments.
+ */
+static struct option prog_opts[] = {
+        { "source", required_argument, NULL, 's' },
+        { "output", required_argument, NULL, 'o' },
+        { "version", no_argument, NULL, 'V' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+};
+
+/**
+ * Print correct CLI usage of the tool
+ */
+static void printUsage(const char *progname)
+{
+        fprintf(stdout, "Usage: %s [-s directory] [-o directory] [database ...]\n", progname);
+}
+
+/**
+ * Pretty-print a help message
+ */
+static void printHelp(const char *progname)
+{
+        printUsage(progname);
+
+        fputs("\nBuild indexed passwd, group and shadow databases for getent -s db,\n", stdout);
+        fputs("and the index of the hosts file the hosts databases load.\n\n", stdout);
+        fputs("    -s, --source=DIR                     Read source files from DIR\n", stdout);
+        fputs("                                         (default /etc)\n", stdout);
+        fputs("    -o, --output=DIR                     Write databases to DIR\n", stdout);
+        fputs("                                         (default " GETENT_DB_DIR ")\n", stdout);
+        fputs("    -h, --help                           Display this help message\n", stdout);
+        fputs("    -V, --version                        Display program version and quit\n",
+              stdout);
+}
+
+/**
+ * Print our version information
+ */
+static void printVersion(void)
+{
+        fputs("getent-mkdb version " PACKAGE_VERSION " \n\n", stdout);
+        fputs("Copyright © 2020 Serpent OS Developers\n", stdout);
+        fputs("Part of the libc-support project\n", stdout);
+        fputs("Available under the terms of the MIT license\n", stdout);
+}
+
+static const mkdb_source_t *find_source(const char *name)
+{
+        for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+                if (strcmp(sources[i].name, name) == 0 || strcmp(sources[i].file, name) == 0)
+                        return &sources[i];
+        err("Unknown database: %s\n", name);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        char rooted_source[PATH_MAX];
+        char rooted_output[PATH_MAX];
+        const char *source_dir = NULL;
+        const char *output_dir = NULL;
+        const char *progname = argv[0];
+        int res = EXIT_SUCCESS;
+        int opt = 0;
+
+        while ((opt = getopt_long(argc, argv, "s:o:hV", prog_opts, NULL)) != -1) {
+                switch (opt) {
+                case 's':
+                        source_dir = optarg;
+                        break;
+                case 'o':
+                        output_dir = optarg;
+                        break;
+                case 'h':
+                        printHelp(progname);
+                        return EXIT_SUCCESS;
+                case 'V':
+                        printVersion();
+                        return EXIT_SUCCESS;
+                default:
+                        printUsage(progname);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        argc -= optind;
+        argv += optind;
+
+        /* Defaults follow the same root getent reads from */
+        root_dir_set(getenv(LIBC_SUPPORT_ROOT_ENV));
+        if (source_dir == NULL)
+                source_dir = root_path("/etc", rooted_source, sizeof(rooted_source));
+        if (output_dir == NULL)
+                output_dir = root_path(GETENT_DB_DIR, rooted_output, sizeof(rooted_output));
+
+        /* Paths are final from here on, hostsfile.c must not root them again */
+        root_dir_set(NULL);
+
+        /* Without arguments, index whatever is there */
+        if (argc == 0) {
+                char path[PATH_MAX];
+
+                for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+                        snprintf(path, sizeof(path), "%s/%s", source_dir, sources[i].file);
+                        if (access(path, R_OK) != 0)
+                                continue;
+                        if (!build_database(&sources[i], source_dir, output_dir))
+                                res = EXIT_FAILURE;
+                }
+                snprintf(path, sizeof(path), "%s/hosts", source_dir);
+                if (access(path, R_OK) == 0 && !build_hosts(source_dir, output_dir))
+                        res = EXIT_FAILURE;
+                return res;
+        }
+
+        for (; argc-- > 0; argv++) {
+                if (strcmp(*argv, "hosts") == 0) {
+                        if (!build_hosts(source_dir, output_dir))
+                                res = EXIT_FAILURE;
+                } else if (!build_database(find_source(*argv), source_dir, output_dir)) {
+                        res = EXIT_FAILURE;
+                }
+        }
+        return res;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,116 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "output.h"
+
+output_t output = { .len = 0, .failed = false, .written = 0 };
+
+/**
+ * Write @iov out completely, coping with short writes
+ */
+static void write_iov(struct iovec *iov, int iov_cnt)
+{
+        while (iov_cnt > 0 && !output.failed) {
+                ssize_t r = writev(STDOUT_FILENO, iov, iov_cnt);
+
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r < 0) {
+                        output.failed = true;
+                        break;
+                }
+                output.written += (unsigned long)r;
+                while (iov_cnt > 0 && (size_t)r >= iov->iov_len) {
+                        r -= (ssize_t)iov->iov_len;
+                        iov++;
+                        iov_cnt--;
+                }
+                if (iov_cnt > 0) {
+                        iov->iov_base = (char *)iov->iov_base + r;
+                        iov->iov_len -= (size_t)r;
+                }
+        }
+}
+
+void out_flush(void)
+{
+        struct iovec iov = { .iov_base = output.buf, .iov_len = output.len };
+
+        if (output.len > 0)
+                write_iov(&iov, 1);
+        output.len = 0;
+}
+
+void out_write_through(const void *data, size_t len)
+{
+        struct iovec iov[2] = {
+                { .iov_base = output.buf, .iov_len = output.len },
+                { .iov_base = (void *)data, .iov_len = len },
+        };
+
+        if (output.len > 0)
+                write_iov(iov, 2);
+        else
+                write_iov(&iov[1], 1);
+        output.len = 0;
+}
+
+int out_uint(unsigned long value)
+{
+        char digits[20];
+        size_t pos = sizeof(digits);
+
+        do {
+                digits[--pos] = (char)('0' + value % 10);
+                value /= 10;
+        } while (value != 0);
+        return out_write(digits + pos, sizeof(digits) - pos);
+}
+
+int out_int(long value)
+{
+        if (value >= 0)
+                return out_uint((unsigned long)value);
+        out_char('-');
+        return 1 + out_uint(-(unsigned long)value);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
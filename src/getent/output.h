@@ -0,0 +1,86 @@
+#ifndef GETENT_OUTPUT_H
+#define GETENT_OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Buffered standard output shared by every formatter.
+ *
+ * Records are appended to one large buffer that is handed to write(2)
+ * once it fills up, so formatting never goes through stdio's format
+ * parsing and locking. The appends return the number of characters
+ * written, like printf, so formatters can keep aligning columns.
+ *
+ * Nothing is written until out_flush() is called or the buffer fills up.
+ * Anything that must reach the reader right away (interactive streams,
+ * children about to _exit) flushes explicitly.
+ */
+#define OUTPUT_BUFFER_SIZE (128 * 1024)
+
+typedef struct output {
+        char buf[OUTPUT_BUFFER_SIZE];
+        size_t len;            /**< Bytes pending in @buf */
+        bool failed;           /**< Set once a write failed, further output is dropped */
+        unsigned long written; /**< Bytes written out so far */
+} output_t;
+
+extern output_t output;
+
+/**
+ * Write out everything pending
+ */
+extern void out_flush(void);
+
+/**
+ * Write out everything pending followed by @data, in a single writev
+ */
+extern void out_write_through(const void *data, size_t len);
+
+extern int out_uint(unsigned long value);
+
+extern int out_int(long value);
+
+static inline int out_write(const void *data, size_t len)
+{
+        if (len > OUTPUT_BUFFER_SIZE - output.len) {
+                out_write_through(data, len);
+                return (int)len;
+        }
+        memcpy(output.buf + output.len, data, len);
+        output.len += len;
+        return (int)len;
+}
+
+static inline int out_str(const char *str)
+{
+        return out_write(str, strlen(str));
+}
+
+static inline int out_char(char c)
+{
+        if (output.len == OUTPUT_BUFFER_SIZE)
+                out_flush();
+        output.buf[output.len++] = c;
+        return 1;
+}
+
+/**
+ * Pad with spaces so that a column of @cnt characters lines up with
+ * @align_to, as the formatters have always done.
+ */
+static inline void out_pad(int cnt, int align_to)
+{
+        size_t pad = 0;
+
+        if (cnt + 1 >= align_to)
+                return;
+        pad = (size_t)(align_to - cnt - 1);
+        if (pad > OUTPUT_BUFFER_SIZE - output.len)
+                out_flush();
+        memset(output.buf + output.len, ' ', pad);
+        output.len += pad;
+}
+
+#endif
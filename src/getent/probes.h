@@ -0,0 +1,63 @@
+#ifndef GETENT_PROBES_H
+#define GETENT_PROBES_H
+
+#include <string.h>
+
+#include "config.h"
+
+/**
+ * USDT probes for perf, bpftrace and SystemTap, built in with
+ * -Dusdt=enabled. Without it every probe expands to nothing.
+ *
+ * Provider "getent":
+ *
+ *      database__start(database)
+ *      database__done(database, status)
+ *              around the lookups or enumeration of one getent run
+ *      lookup__start(database, backend, key)
+ *      lookup__done(database, backend, key, status)
+ *              around a backend answering a key; keys handed over as a
+ *              batch all start before the first one is done
+ *      record__emit(database, name, name_len)
+ *              as a formatter prints a record. Names from mapped files are
+ *              not NUL terminated, so read name_len bytes.
+ *
+ * Keys and names are strings, status is the RES_* code returned.
+ */
+#ifndef HAVE_USDT
+#define HAVE_USDT 0
+#endif
+
+#if HAVE_USDT
+#include <sys/sdt.h>
+
+/**
+ * Database of the chain last dispatched, for record__emit
+ */
+extern const char *probe_database;
+
+#define GETENT_PROBE_DATABASE_START(db) STAP_PROBE1(getent, database__start, db)
+#define GETENT_PROBE_DATABASE_DONE(db, status) STAP_PROBE2(getent, database__done, db, status)
+#define GETENT_PROBE_DISPATCH(chain) (probe_database = (chain)->database)
+#define GETENT_PROBE_LOOKUP_START(chain, keys, cnt)                                                \
+        for (int probe_i = 0; (keys) != NULL && probe_i < (cnt); probe_i++)                        \
+        STAP_PROBE3(getent, lookup__start, (chain)->database, (chain)->backends[0]->name,          \
+                    (keys)[probe_i])
+#define GETENT_PROBE_LOOKUP_DONE(chain, keys, cnt, status)                                         \
+        for (int probe_i = 0; (keys) != NULL && probe_i < (cnt); probe_i++)                        \
+        STAP_PROBE4(getent, lookup__done, (chain)->database, (chain)->backends[0]->name,           \
+                    (keys)[probe_i], status)
+#define GETENT_PROBE_RECORD(name, len) STAP_PROBE3(getent, record__emit, probe_database, name, len)
+#define GETENT_PROBE_RECORD_STR(name)                                                              \
+        GETENT_PROBE_RECORD(name, (name) != NULL ? strlen(name) : 0)
+#else
+#define GETENT_PROBE_DATABASE_START(db)
+#define GETENT_PROBE_DATABASE_DONE(db, status)
+#define GETENT_PROBE_DISPATCH(chain)
+#define GETENT_PROBE_LOOKUP_START(chain, keys, cnt)
+#define GETENT_PROBE_LOOKUP_DONE(chain, keys, cnt, status)
+#define GETENT_PROBE_RECORD(name, len)
+#define GETENT_PROBE_RECORD_STR(name)
+#endif
+
+#endif
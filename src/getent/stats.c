@@ -0,0 +1,294 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "getent.h"
+#include "output.h"
+#include "stats.h"
+
+/**
+ * Latencies are counted in power of two buckets of microseconds, bucket
+ * i holding [2^i, 2^(i+1)) and bucket 0 everything under 2us
+ */
+#define STATS_BUCKETS 32
+#define STATS_BAR_WIDTH 40
+
+_Thread_local getent_stats_t stats = { .records = 0, .bytes_read = 0, .backend = NULL };
+
+/**
+ * What one lookup, or a whole run, cost
+ */
+typedef struct stats_sample {
+        uint64_t ns;
+        unsigned long records;
+        unsigned long bytes_read;
+        unsigned long bytes_written;
+} stats_sample_t;
+
+static stats_format_t format = STATS_OFF;
+static const char *database = NULL;
+static stats_sample_t total;
+static unsigned long lookups = 0;
+static unsigned long found = 0;
+static unsigned long histogram[STATS_BUCKETS];
+
+bool stats_parse(const char *arg, stats_format_t *fmt)
+{
+        if (arg == NULL || strcmp(arg, "text") == 0 || strcmp(arg, "1") == 0)
+                *fmt = STATS_TEXT;
+        else if (strcmp(arg, "json") == 0)
+                *fmt = STATS_JSON;
+        else if (strcmp(arg, "0") == 0 || *arg == '\0')
+                *fmt = STATS_OFF;
+        else
+                return false;
+        return true;
+}
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned long bytes_written(void)
+{
+        return output.written + output.len;
+}
+
+static void sample_start(stats_sample_t *sample)
+{
+        stats.backend = NULL;
+        sample->records = stats.records;
+        sample->bytes_read = stats.bytes_read;
+        sample->bytes_written = bytes_written();
+        sample->ns = now_ns();
+}
+
+static void sample_stop(stats_sample_t *sample)
+{
+        sample->ns = now_ns() - sample->ns;
+        sample->records = stats.records - sample->records;
+        sample->bytes_read = stats.bytes_read - sample->bytes_read;
+        sample->bytes_written = bytes_written() - sample->bytes_written;
+}
+
+static size_t bucket(uint64_t ns)
+{
+        uint64_t us = ns / 1000;
+        size_t b = 0;
+
+        while (us > 1 && b < STATS_BUCKETS - 1) {
+                us >>= 1;
+                b++;
+        }
+        return b;
+}
+
+static void json_string(const char *s)
+{
+        if (s == NULL) {
+                fputs("null", stderr);
+                return;
+        }
+        fputc('"', stderr);
+        for (; *s != '\0'; s++) {
+                unsigned char c = (unsigned char)*s;
+
+                if (c == '"' || c == '\\')
+                        fprintf(stderr, "\\%c", c);
+                else if (c < 0x20)
+                        fprintf(stderr, "\\u%04x", c);
+                else
+                        fputc(c, stderr);
+        }
+        fputc('"', stderr);
+}
+
+static void json_sample(const stats_sample_t *sample)
+{
+        fprintf(stderr,
+                "\"latency_us\": %.3f, \"records\": %lu, \"bytes_read\": %lu, "
+                "\"bytes_written\": %lu",
+                (double)sample->ns / 1000, sample->records, sample->bytes_read,
+                sample->bytes_written);
+}
+
+static void text_sample(const stats_sample_t *sample)
+{
+        fprintf(stderr, "%.3f ms, %lu records, %lu bytes read, %lu bytes written\n",
+                (double)sample->ns / 1000000, sample->records, sample->bytes_read,
+                sample->bytes_written);
+}
+
+/**
+ * Account for and report one lookup of @key, NULL for an enumeration
+ */
+static void report(const char *key, const stats_sample_t *sample)
+{
+        const char *backend = sample->bytes_written > 0 ? stats.backend : NULL;
+
+        lookups++;
+        if (backend != NULL)
+                found++;
+        total.ns += sample->ns;
+        total.records += sample->records;
+        total.bytes_read += sample->bytes_read;
+        total.bytes_written += sample->bytes_written;
+        histogram[bucket(sample->ns)]++;
+
+        if (format == STATS_JSON) {
+                fputs(lookups > 1 ? ",\n    { \"key\": " : "\n    { \"key\": ", stderr);
+                json_string(key);
+                fputs(", \"backend\": ", stderr);
+                json_string(backend);
+                fputs(", ", stderr);
+                json_sample(sample);
+                fputs(" }", stderr);
+                return;
+        }
+        fprintf(stderr, "getent: %s %s: %s, ", database, key != NULL ? key : "(enumeration)",
+                backend != NULL ? backend : "not found");
+        text_sample(sample);
+}
+
+void stats_begin(stats_format_t fmt, const char *db)
+{
+        format = fmt;
+        database = db;
+        memset(&total, 0, sizeof(total));
+        lookups = 0;
+        found = 0;
+        memset(histogram, 0, sizeof(histogram));
+        if (format == STATS_JSON) {
+                fputs("{\n  \"database\": ", stderr);
+                json_string(database);
+                fputs(",\n  \"lookups\": [", stderr);
+        }
+}
+
+int stats_get(const getent_chain_t *chain, const char *key)
+{
+        stats_sample_t sample;
+        int res = RES_OK;
+
+        sample_start(&sample);
+        res = chain_get(chain, &key, 1);
+        sample_stop(&sample);
+        report(key, &sample);
+        return res;
+}
+
+int stats_enum(const getent_chain_t *chain)
+{
+        stats_sample_t sample;
+        int res = RES_OK;
+
+        sample_start(&sample);
+        res = chain_enum(chain);
+        sample_stop(&sample);
+        report(NULL, &sample);
+        return res;
+}
+
+static void text_histogram(void)
+{
+        size_t first = STATS_BUCKETS;
+        size_t last = 0;
+        unsigned long peak = 0;
+
+        for (size_t b = 0; b < STATS_BUCKETS; b++) {
+                if (histogram[b] == 0)
+                        continue;
+                if (first == STATS_BUCKETS)
+                        first = b;
+                last = b;
+                if (histogram[b] > peak)
+                        peak = histogram[b];
+        }
+        fputs("getent: latency\n", stderr);
+        for (size_t b = first; b <= last && peak > 0; b++) {
+                int bar = (int)((histogram[b] * STATS_BAR_WIDTH + peak - 1) / peak);
+
+                fprintf(stderr, "  %10lu - %10lu us %10lu", b == 0 ? 0UL : 1UL << b, 2UL << b,
+                        histogram[b]);
+                if (bar > 0)
+                        fprintf(stderr, " %.*s", bar, "########################################");
+                fputc('\n', stderr);
+        }
+}
+
+static void json_histogram(void)
+{
+        bool first = true;
+
+        fputs(",\n  \"histogram\": [", stderr);
+        for (size_t b = 0; b < STATS_BUCKETS; b++) {
+                if (histogram[b] == 0)
+                        continue;
+                fprintf(stderr, "%s\n    { \"min_us\": %lu, \"max_us\": %lu, \"count\": %lu }",
+                        first ? "" : ",", b == 0 ? 0UL : 1UL << b, 2UL << b, histogram[b]);
+                first = false;
+        }
+        fputs("\n  ]", stderr);
+}
+
+void stats_end(void)
+{
+        if (format == STATS_JSON) {
+                fputs(lookups > 0 ? "\n  ],\n  \"total\": { " : "],\n  \"total\": { ", stderr);
+                fprintf(stderr, "\"lookups\": %lu, \"found\": %lu, ", lookups, found);
+                json_sample(&total);
+                fputs(" }", stderr);
+                if (lookups > 1)
+                        json_histogram();
+                fputs("\n}\n", stderr);
+        } else if (format == STATS_TEXT && lookups > 1) {
+                fprintf(stderr, "getent: %s: %lu lookups, %lu found, ", database, lookups, found);
+                text_sample(&total);
+                text_histogram();
+        }
+        format = STATS_OFF;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
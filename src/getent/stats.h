@@ -0,0 +1,72 @@
+#ifndef GETENT_STATS_H
+#define GETENT_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Where the time of a lookup went (--stats).
+ *
+ * Backends count the records they examine and the bytes they read, from
+ * files, indexes, getentd or nameservers, as they go: bumping a counter
+ * costs less than checking whether anyone asked. chain_get() notes the
+ * backend it hands keys to, so the last one noted is the one that found
+ * the key. The counters are per thread, as the database layer is shared
+ * with libgetent.
+ *
+ * With --stats every key is looked up on its own, to be timed and
+ * reported on standard error together with the backend that answered it,
+ * the records and bytes read and the bytes printed. Batches of keys end
+ * with a summary and a latency histogram.
+ */
+#define GETENT_STATS_ENV "GETENT_STATS"
+
+typedef enum {
+        STATS_OFF = 0,
+        STATS_TEXT = 1, /**< Human readable lines */
+        STATS_JSON = 2, /**< A single JSON object */
+} stats_format_t;
+
+typedef struct getent_chain getent_chain_t;
+
+typedef struct getent_stats {
+        unsigned long records;    /**< Records examined */
+        unsigned long bytes_read; /**< Bytes read from files, indexes and sockets */
+        const char *backend;      /**< Backend last handed keys */
+} getent_stats_t;
+
+extern _Thread_local getent_stats_t stats;
+
+static inline void stats_read(unsigned long records, size_t bytes)
+{
+        stats.records += records;
+        stats.bytes_read += bytes;
+}
+
+/**
+ * Parse a --stats or GETENT_STATS argument: "text" (or "1"), "json" or
+ * "0". Returns false for anything else.
+ */
+extern bool stats_parse(const char *arg, stats_format_t *format);
+
+/**
+ * Start reporting on lookups in @database, in @format
+ */
+extern void stats_begin(stats_format_t format, const char *database);
+
+/**
+ * Look @key up with @chain, timing it
+ */
+extern int stats_get(const getent_chain_t *chain, const char *key);
+
+/**
+ * Enumerate with @chain, timing it
+ */
+extern int stats_enum(const getent_chain_t *chain);
+
+/**
+ * Print the summary, and the histogram when more than one key was seen
+ */
+extern void stats_end(void);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <locale.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "getent.h"
+
+const char *root_dir = NULL;
+
+bool locale_loaded = false;
+
+_Thread_local jmp_buf *err_return = NULL;
+
+void locale_init(void)
+{
+        if (!locale_loaded) {
+                setlocale(LC_ALL, "");
+                locale_loaded = true;
+        }
+}
+
+void err(const char *msg, ...)
+{
+        va_list args;
+
+        locale_init();
+        va_start(args, msg);
+        (void)vfprintf(stderr, msg, args);
+        va_end(args);
+
+        if (err_return != NULL)
+                longjmp(*err_return, 1);
+        exit(EXIT_FAILURE);
+}
+
+int is_numeric(const char *v)
+{
+        if (v == NULL)
+                return 1;
+
+        for (; v != NULL && *v != (char)0; v++)
+                if (*v < '0' || *v > '9')
+                        return 0;
+
+        return 1;
+}
+
+void root_dir_set(const char *dir)
+{
+        static char *copy = NULL;
+        size_t len = dir != NULL ? strlen(dir) : 0;
+
+        while (len > 0 && dir[len - 1] == '/')
+                len--;
+        free(copy);
+        copy = NULL;
+        root_dir = NULL;
+        if (len == 0)
+                return;
+        copy = strndup(dir, len);
+        if (copy == NULL)
+                err("Out of memory\n");
+        root_dir = copy;
+}
+
+const char *root_path(const char *path, char *buf, size_t len)
+{
+        if (root_dir == NULL)
+                return path;
+        snprintf(buf, len, "%s%s", root_dir, path);
+        return buf;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
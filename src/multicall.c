@@ -0,0 +1,94 @@
+/*
+ * This file is part of libc-support.
+ *
+ * Copyright © 2020 Serpent OS Developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+/**
+ * getconf and getent in one static binary (-Dmulticall=true), sparing
+ * scripts that call them over and over the dynamic loader on every call.
+ *
+ * The tool is picked by the name the binary was run as, so getconf and
+ * getent are installed as links to it. Run under any other name, the tool
+ * is named by the first argument instead.
+ */
+extern int getconf_main(int argc, char **argv);
+extern int getent_main(int argc, char **argv);
+
+typedef struct multicall_tool {
+        const char *name;
+        int (*run)(int argc, char **argv);
+} multicall_tool_t;
+
+static const multicall_tool_t tools[] = {
+        { "getconf", getconf_main },
+        { "getent", getent_main },
+};
+
+static const multicall_tool_t *find_tool(const char *name)
+{
+        const char *base = strrchr(name, '/');
+
+        base = base ? base + 1 : name;
+        for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++) {
+                if (strcmp(base, tools[i].name) == 0) {
+                        return &tools[i];
+                }
+        }
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        const multicall_tool_t *tool = NULL;
+
+        if (argc > 0 && (tool = find_tool(argv[0])) != NULL) {
+                return tool->run(argc, argv);
+        }
+        if (argc > 1 && (tool = find_tool(argv[1])) != NULL) {
+                return tool->run(argc - 1, argv + 1);
+        }
+
+        fprintf(stderr, "Usage: %s getconf|getent [ARGS]...\n", argc > 0 ? argv[0] : PACKAGE_NAME);
+        return EXIT_FAILURE;
+}
+
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 softtabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
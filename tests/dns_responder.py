@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+A small DNS server for tests, answering over UDP and TCP on port 53 from
+a zone kept in memory.
+
+    dns_responder.py [--address ADDR] [--delay MS] ZONE
+
+ZONE has one record per line, "name type value", with A, AAAA, CNAME
+and PTR records. Names that are not in it get NXDOMAIN. Run on its own,
+it serves until interrupted, which is handy as a slow nameserver to time
+getent against. Tests import Responder instead, which can also truncate
+UDP replies and delay either transport.
+"""
+
+import argparse
+import collections
+import ipaddress
+import socket
+import struct
+import threading
+import time
+
+TYPES = {"A": 1, "CNAME": 5, "PTR": 12, "AAAA": 28}
+HEADER = struct.Struct("!HHHHHH")
+FLAG_QR = 0x8000
+FLAG_TC = 0x0200
+FLAG_RD = 0x0100
+FLAG_RA = 0x0080
+RCODE_NXDOMAIN = 3
+
+
+def encode_name(name):
+    out = b""
+    for label in name.rstrip(".").split("."):
+        if label:
+            out += bytes([len(label)]) + label.encode()
+    return out + b"\0"
+
+
+def encode_rdata(rtype, value):
+    if rtype == TYPES["A"]:
+        return ipaddress.IPv4Address(value).packed
+    if rtype == TYPES["AAAA"]:
+        return ipaddress.IPv6Address(value).packed
+    return encode_name(value)
+
+
+def parse_question(msg):
+    """Returns the ID, flags, name and type asked for in @msg"""
+    qid, flags, qdcount = HEADER.unpack_from(msg)[:3]
+    if qdcount != 1:
+        raise ValueError("one question expected")
+    pos, labels = HEADER.size, []
+    while msg[pos]:
+        labels.append(msg[pos + 1:pos + 1 + msg[pos]].decode().lower())
+        pos += 1 + msg[pos]
+    qtype = struct.unpack_from("!H", msg, pos + 1)[0]
+    return qid, flags, ".".join(labels), qtype, msg[HEADER.size:pos + 5]
+
+
+class Responder:
+    """
+    Serve @zone, a dict of name to a list of (type, value), on @address.
+    Names in @truncate only get truncated replies over UDP. Replies over
+    UDP or TCP wait @udp_delay or @tcp_delay seconds, without holding up
+    any other. @queries counts (transport, name, type) as they come in.
+    """
+
+    def __init__(self, zone, address="127.0.0.1", truncate=(), udp_delay=0, tcp_delay=0):
+        self.zone = {name.lower(): records for name, records in zone.items()}
+        self.truncate = set(truncate)
+        self.udp_delay = udp_delay
+        self.tcp_delay = tcp_delay
+        self.queries = collections.Counter()
+        self.lock = threading.Lock()
+        family = socket.AF_INET6 if ":" in address else socket.AF_INET
+        self.udp = socket.socket(family, socket.SOCK_DGRAM)
+        self.tcp = socket.socket(family, socket.SOCK_STREAM)
+        self.tcp.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.udp.bind((address, 53))
+        self.tcp.bind((address, 53))
+        self.tcp.listen(64)
+        for target in (self.serve_udp, self.serve_tcp):
+            threading.Thread(target=target, daemon=True).start()
+
+    def answer(self, msg, transport):
+        qid, flags, name, qtype, question = parse_question(msg)
+        with self.lock:
+            self.queries[(transport, name, qtype)] += 1
+        flags = FLAG_QR | FLAG_RA | (flags & FLAG_RD)
+        if transport == "udp" and name in self.truncate:
+            return HEADER.pack(qid, flags | FLAG_TC, 1, 0, 0, 0) + question
+
+        answers, seen = [], set()
+        while name not in seen:
+            seen.add(name)
+            records = self.zone.get(name)
+            if records is None:
+                if not answers:
+                    return HEADER.pack(qid, flags | RCODE_NXDOMAIN, 1, 0, 0, 0) + question
+                break
+            cname = [value for rtype, value in records if rtype == "CNAME"]
+            for rtype, value in records:
+                if TYPES[rtype] == qtype or rtype == "CNAME":
+                    rdata = encode_rdata(TYPES[rtype], value)
+                    answers.append(encode_name(name) +
+                                   struct.pack("!HHIH", TYPES[rtype], 1, 60, len(rdata)) + rdata)
+            if not cname:
+                break
+            name = cname[0].lower().rstrip(".")
+        return HEADER.pack(qid, flags, 1, len(answers), 0, 0) + question + b"".join(answers)
+
+    def serve_udp(self):
+        while True:
+            msg, peer = self.udp.recvfrom(512)
+            try:
+                reply = self.answer(msg, "udp")
+            except (ValueError, IndexError, struct.error):
+                continue
+            if self.udp_delay:
+                threading.Timer(self.udp_delay, self.udp.sendto, (reply, peer)).start()
+            else:
+                self.udp.sendto(reply, peer)
+
+    def serve_tcp(self):
+        while True:
+            conn, _ = self.tcp.accept()
+            threading.Thread(target=self.serve_connection, args=(conn,), daemon=True).start()
+
+    def serve_connection(self, conn):
+        with conn:
+            data = b""
+            while len(data) < 2 or len(data) < 2 + struct.unpack_from("!H", data)[0]:
+                chunk = conn.recv(4096)
+                if not chunk:
+                    return
+                data += chunk
+            try:
+                reply = self.answer(data[2:], "tcp")
+            except (ValueError, IndexError, struct.error):
+                return
+            time.sleep(self.tcp_delay)
+            conn.sendall(struct.pack("!H", len(reply)) + reply)
+
+    def count(self, transport, name, qtype="A"):
+        with self.lock:
+            return self.queries[(transport, name, TYPES[qtype])]
+
+
+def load_zone(path):
+    zone = collections.defaultdict(list)
+    with open(path, encoding="utf-8") as fp:
+        for line in fp:
+            fields = line.split("#", 1)[0].split()
+            if len(fields) == 3:
+                zone[fields[0].rstrip(".")].append((fields[1].upper(), fields[2]))
+    return zone
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve a DNS zone for tests")
+    parser.add_argument("--address", default="127.0.0.1", help="address to listen on")
+    parser.add_argument("--delay", type=int, default=0, help="answer after MS milliseconds")
+    parser.add_argument("zone", help="file with one 'name type value' record per line")
+    args = parser.parse_args()
+
+    Responder(load_zone(args.zone), args.address,
+              udp_delay=args.delay / 1000, tcp_delay=args.delay / 1000)
+    try:
+        threading.Event().wait()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Check _NPROCESSORS_EFFECTIVE and _PHYS_PAGES_EFFECTIVE of getconf against
+fake unified (v2) cgroup trees.
+
+    test_cgroup.py --getconf BIN
+
+Each case lays out a tree under a temporary --root: sys/fs/cgroup with
+its cgroup.controllers, our cgroup nested a few directories down with
+cpu.max and memory.max files along the way, and proc/self/cgroup naming
+it. getconf has to apply the quota or limit of our cgroup, ignore "max",
+and take a tighter one from an ancestor. CPU counts cannot go past the
+CPUs this process may run on, which cap the expected values.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+CGROUP = "/system.slice/app.service/worker"
+PAGE_SIZE = os.sysconf("SC_PAGESIZE")
+PHYS_PAGES = os.sysconf("SC_PHYS_PAGES")
+CPUS = len(os.sched_getaffinity(0))
+MIB = 1024 * 1024
+
+failures = []
+
+
+def check(cond, what):
+    print(("ok     " if cond else "FAILED ") + what)
+    if not cond:
+        failures.append(what)
+
+
+def make_tree(root, files):
+    """Lay out a v2 hierarchy holding @files, a dict of path under CGROUP's
+    ancestors to content, with our process in CGROUP"""
+    base = os.path.join(root, "sys", "fs", "cgroup")
+    os.makedirs(base + CGROUP)
+    with open(os.path.join(base, "cgroup.controllers"), "w", encoding="utf-8") as fp:
+        fp.write("cpuset cpu io memory pids\n")
+    for path, content in files.items():
+        with open(base + path, "w", encoding="utf-8") as fp:
+            fp.write(content + "\n")
+    os.makedirs(os.path.join(root, "proc", "self"))
+    with open(os.path.join(root, "proc", "self", "cgroup"), "w", encoding="utf-8") as fp:
+        fp.write(f"0::{CGROUP}\n")
+
+
+def getconf(args, files, name):
+    with tempfile.TemporaryDirectory(prefix="cgroup-test-") as root:
+        make_tree(root, files)
+        proc = subprocess.run([args.getconf, f"--root={root}", name],
+                              capture_output=True, text=True, check=False)
+    if proc.returncode != 0:
+        return None
+    return int(proc.stdout)
+
+
+def check_cpus(args, files, limit, what):
+    value = getconf(args, files, "_NPROCESSORS_EFFECTIVE")
+    expected = min(CPUS, limit)
+    check(value == expected, f"{what}: {value} CPUs, {expected} expected")
+
+
+def check_pages(args, files, pages, what):
+    value = getconf(args, files, "_PHYS_PAGES_EFFECTIVE")
+    expected = min(PHYS_PAGES, pages)
+    check(value == expected, f"{what}: {value} pages, {expected} expected")
+
+
+def test_cpus(args):
+    check_cpus(args, {CGROUP + "/cpu.max": "150000 100000"}, 2,
+               "a quota of 1.5 CPUs is rounded up")
+    check_cpus(args, {CGROUP + "/cpu.max": "max 100000"}, CPUS, "no quota leaves every CPU")
+    check_cpus(args, {"/system.slice/cpu.max": "100000 100000",
+                      CGROUP + "/cpu.max": "400000 100000"}, 1,
+               "a tighter quota of an ancestor wins")
+    check_cpus(args, {"/system.slice/cpu.max": "max 100000",
+                      CGROUP + "/cpu.max": "max 100000"}, CPUS,
+               "no quota anywhere leaves every CPU")
+    check_cpus(args, {CGROUP + "/cpuset.cpus.effective": "0"}, 1,
+               "the cpuset narrows the CPUs down")
+
+
+def test_pages(args):
+    check_pages(args, {CGROUP + "/memory.max": str(100 * MIB)}, 100 * MIB // PAGE_SIZE,
+                "memory.max limits the pages")
+    check_pages(args, {CGROUP + "/memory.max": "max"}, PHYS_PAGES, "max leaves every page")
+    check_pages(args, {"/system.slice/memory.max": str(50 * MIB),
+                       "/system.slice/app.service/memory.max": "max",
+                       CGROUP + "/memory.max": str(100 * MIB)}, 50 * MIB // PAGE_SIZE,
+                "a tighter limit of an ancestor wins")
+    check_pages(args, {}, PHYS_PAGES, "no memory.max anywhere leaves every page")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the cgroup limits of getconf")
+    parser.add_argument("--getconf", required=True, help="getconf binary")
+    args = parser.parse_args()
+
+    test_cpus(args)
+    test_pages(args)
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Check getent -s dns, and -j with the libc backend, against
+dns_responder.py, serving a small zone on 127.0.0.1:53 in a network
+namespace of its own.
+
+    test_dns.py --getent BIN
+
+The test re-runs itself under unshare(1), so it needs neither root nor a
+free port 53, and skips when user namespaces are not available. It looks
+up plain names, CNAMEs, the search list, addresses, missing names and
+names whose replies are truncated over UDP, several of those answering
+slowly over TCP to show the fallback does not hold up other queries.
+Then /etc/resolv.conf is swapped for one naming the responder, which now
+answers late, to check that getent -j resolves keys side by side and
+prints the same as without it, both with libc alone and behind the hosts
+file of the default services.
+"""
+
+import argparse
+import fcntl
+import os
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+from dns_responder import Responder
+
+EXIT_SKIP = 77
+NAMESPACE_ENV = "GETENT_DNS_TEST_NAMESPACE"
+SIOCSIFFLAGS = 0x8914
+IFF_UP = 0x1
+
+ZONE = {
+    "www.example.test": [("A", "192.0.2.1")],
+    "dual.example.test": [("A", "192.0.2.2"), ("AAAA", "2001:db8::2")],
+    "alias.example.test": [("CNAME", "www.example.test")],
+    "1.2.0.192.in-addr.arpa": [("PTR", "www.example.test")],
+    "big0.example.test": [("A", "192.0.2.10")],
+    "big1.example.test": [("A", "192.0.2.11")],
+    "big2.example.test": [("A", "192.0.2.12")],
+}
+TRUNCATED = ["big0.example.test", "big1.example.test", "big2.example.test"]
+TCP_DELAY = 1.0
+JOB_KEYS = [f"host{i}.example.test" for i in range(10)]
+JOB_ADDRS = [f"192.0.2.{100 + i}" for i in range(10)]
+JOB_DELAY = 0.2
+JOB_LOCAL = ("192.0.2.99", "local.example.test")
+for addr, key in zip(JOB_ADDRS, JOB_KEYS):
+    ZONE[key] = [("A", addr)]
+    ZONE[".".join(reversed(addr.split("."))) + ".in-addr.arpa"] = [("PTR", key)]
+
+failures = []
+
+
+def check(cond, what):
+    print(("ok     " if cond else "FAILED ") + what)
+    if not cond:
+        failures.append(what)
+
+
+def enter_namespace():
+    """Re-run this script as root of private user, mount and network namespaces"""
+    unshare = shutil.which("unshare")
+    if unshare is None or subprocess.run([unshare, "-rmn", "true"], capture_output=True,
+                                         check=False).returncode != 0:
+        print("user namespaces are not available, skipping", file=sys.stderr)
+        sys.exit(EXIT_SKIP)
+    env = dict(os.environ, **{NAMESPACE_ENV: "1"})
+    os.execve(unshare, [unshare, "-rmn", sys.executable, os.path.abspath(__file__)] + sys.argv[1:],
+              env)
+
+
+def loopback_up():
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        fcntl.ioctl(sock, SIOCSIFFLAGS, struct.pack("16sH", b"lo", IFF_UP))
+
+
+def dns(args, root, *argv):
+    proc = subprocess.run([args.getent, "--root", root, "-s", "dns", *argv],
+                          capture_output=True, text=True, check=False)
+    return proc.returncode, proc.stdout.split("\n")[:-1]
+
+
+def test_lookups(args, root):
+    check(dns(args, root, "hosts", "www.example.test") ==
+          (0, ["192.0.2.1       www.example.test"]), "hosts finds an A record")
+    rc, lines = dns(args, root, "ahosts", "dual.example.test")
+    check(rc == 0 and lines[0].startswith("2001:db8::2 ") and
+          any(line.startswith("192.0.2.2 ") for line in lines),
+          "ahosts finds the AAAA and A records")
+    check(dns(args, root, "hosts", "alias.example.test") ==
+          (0, ["192.0.2.1       www.example.test"]), "hosts follows a CNAME")
+    check(dns(args, root, "--names=canon", "hosts", "alias.example.test") ==
+          (0, ["192.0.2.1       www.example.test"]), "the CNAME target is the canonical name")
+    check(dns(args, root, "hosts", "www") == (0, ["192.0.2.1       www.example.test"]),
+          "hosts goes through the search list")
+    check(dns(args, root, "hosts", "192.0.2.1") == (0, ["192.0.2.1       www.example.test"]),
+          "hosts names an address by its PTR record")
+    check(dns(args, root, "hosts", "missing.example.test")[1] == [],
+          "hosts does not find a missing name")
+    check(dns(args, root, "--names=canon", "hosts", "www.example.test", "missing.example.test",
+              "dual.example.test")[1] ==
+          ["192.0.2.1       www.example.test", "2001:db8::2     dual.example.test"],
+          "hosts prints what it finds of several keys in order")
+
+
+def test_truncated(args, root, responder):
+    start = time.monotonic()
+    rc, lines = dns(args, root, "ahostsv4", *TRUNCATED, "www.example.test")
+    elapsed = time.monotonic() - start
+
+    check(rc == 0 and [line.split()[0] for line in lines[::3]] ==
+          ["192.0.2.10", "192.0.2.11", "192.0.2.12", "192.0.2.1"],
+          "truncated replies are asked again over TCP")
+    check(all(responder.count("tcp", name) == 1 for name in TRUNCATED),
+          "each truncated query goes over TCP once")
+    check(elapsed < len(TRUNCATED) * TCP_DELAY,
+          f"slow TCP answers overlap ({elapsed:.1f}s for {len(TRUNCATED)} of {TCP_DELAY}s)")
+
+
+def bind_file(path, content, tmp):
+    """Put a file with @content in place of @path, or return False"""
+    new = os.path.join(tmp, os.path.basename(path))
+    with open(new, "w", encoding="utf-8") as fp:
+        fp.write(content)
+    return os.path.exists(path) and subprocess.run(["mount", "--bind", new, path],
+                                                   capture_output=True, check=False).returncode == 0
+
+
+def getent_jobs(args, jobs, keys, *argv):
+    start = time.monotonic()
+    proc = subprocess.run([args.getent, *argv, "-j", str(jobs), "hosts", *keys],
+                          capture_output=True, text=True, check=False)
+    return proc.stdout, time.monotonic() - start
+
+
+def check_jobs(args, keys, expected, *argv):
+    what = " ".join(["getent", *argv])
+    serial, serial_time = getent_jobs(args, 1, keys, *argv)
+    parallel, parallel_time = getent_jobs(args, 8, keys, *argv)
+    check(serial.split("\n")[:-1] == expected, f"{what} -j 1 resolves every key")
+    check(parallel == serial, f"{what} -j 8 prints the same in the same order")
+    check(parallel_time * 2 < serial_time,
+          f"{what} -j 8 resolves side by side ({parallel_time:.1f}s, {serial_time:.1f}s with -j 1)")
+
+
+def test_jobs(args, tmp, responder):
+    if not bind_file("/etc/resolv.conf", "nameserver 127.0.0.1\n", tmp):
+        print("cannot replace /etc/resolv.conf, skipping getent -j", file=sys.stderr)
+        return
+    bind_file("/etc/nsswitch.conf", "hosts: dns\n", tmp)
+    responder.udp_delay = JOB_DELAY
+    expected = [f"{addr:<15} {key}" for addr, key in zip(JOB_ADDRS, JOB_KEYS)]
+    check_jobs(args, JOB_KEYS, expected, "-s", "libc")
+
+    # The hosts file answers one key in the middle, libc the others
+    if not bind_file("/etc/hosts", "{} {}\n".format(*JOB_LOCAL), tmp):
+        print("cannot replace /etc/hosts, skipping getent -j with files", file=sys.stderr)
+        return
+    half = len(JOB_KEYS) // 2
+    check_jobs(args, JOB_KEYS[:half] + [JOB_LOCAL[1]] + JOB_KEYS[half:],
+               expected[:half] + ["{:<15} {}".format(*JOB_LOCAL)] + expected[half:])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the DNS stub resolver of getent")
+    parser.add_argument("--getent", required=True, help="getent binary")
+    args = parser.parse_args()
+
+    if os.environ.get(NAMESPACE_ENV) != "1":
+        enter_namespace()
+    loopback_up()
+    responder = Responder(ZONE, truncate=TRUNCATED, tcp_delay=TCP_DELAY)
+
+    with tempfile.TemporaryDirectory(prefix="dns-test-") as root:
+        os.mkdir(os.path.join(root, "etc"))
+        with open(os.path.join(root, "etc", "resolv.conf"), "w", encoding="utf-8") as fp:
+            fp.write("nameserver 127.0.0.1\nsearch example.test\noptions timeout:5\n")
+        test_lookups(args, root)
+        test_truncated(args, root, responder)
+        test_jobs(args, root, responder)
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
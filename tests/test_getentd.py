@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Start getentd on a socket in a temporary directory and check what it
+answers against what getent prints on its own.
+
+    test_getentd.py --getentd BIN --getent BIN
+
+Requests are sent over the getentd protocol directly, to see hits,
+misses, databases that are not cached, requests sent back to back and
+clients that misbehave, and through getent -c. A second daemon, allowed
+only two entries, checks that lookups stay right while it evicts.
+"""
+
+import argparse
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+GETENTD_MAGIC = 0x47454431
+GETENTD_UNCACHED = -1
+REQUEST = struct.Struct("=IHH")
+RESPONSE = struct.Struct("=iI")
+
+failures = []
+
+
+def check(cond, what):
+    print(("ok     " if cond else "FAILED ") + what)
+    if not cond:
+        failures.append(what)
+
+
+def request(db, key):
+    db, key = db.encode(), key.encode()
+    return REQUEST.pack(GETENTD_MAGIC, len(db), len(key)) + db + key
+
+
+def recv_exact(sock, size):
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("getentd closed the connection")
+        data += chunk
+    return data
+
+
+def read_response(sock):
+    status, size = RESPONSE.unpack(recv_exact(sock, RESPONSE.size))
+    return status, recv_exact(sock, size)
+
+
+def ask(path, db, key):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(path)
+        sock.sendall(request(db, key))
+        return read_response(sock)
+
+
+def getent(args, *argv, env=None):
+    proc = subprocess.run([args.getent, *argv], capture_output=True, env=env, check=False)
+    return proc.returncode, proc.stdout
+
+
+def start_daemon(args, path, *extra):
+    daemon = subprocess.Popen([args.getentd, "-S", path, *extra])
+    for _ in range(500):
+        if os.path.exists(path):
+            return daemon
+        if daemon.poll() is not None:
+            break
+        time.sleep(0.01)
+    daemon.kill()
+    sys.exit(f"getentd did not start on {path}")
+
+
+def stop_daemon(daemon, path):
+    daemon.send_signal(signal.SIGTERM)
+    check(daemon.wait(timeout=10) == 0, "getentd exits cleanly on SIGTERM")
+    check(not os.path.exists(path), "getentd removes its socket")
+
+
+def lookups():
+    """Keys to look up: some that exist here, some that cannot"""
+    cases = [("password", "root"), ("password", "0"), ("group", "root"),
+             ("password", "no-such-user-getentd-test"), ("group", "4294967294")]
+    if os.path.exists("/etc/hosts"):
+        cases.append(("hosts", "localhost"))
+    return cases
+
+
+def test_protocol(args, path):
+    for db, key in lookups():
+        expect = getent(args, db, key)
+        for attempt in ("miss", "hit"):
+            status, output = ask(path, db, key)
+            check((status, output) == expect, f"{db} {key} ({attempt}) matches getent")
+
+    status, output = ask(path, "shadow", "root")
+    check(status == GETENTD_UNCACHED and output == b"", "shadow is not cached")
+
+    # Requests sent back to back are answered in order, misses included
+    cases = lookups()
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(path)
+        sock.sendall(b"".join(request(db, key + "-x") for db, key in cases) +
+                     b"".join(request(db, key) for db, key in cases))
+        answers = [read_response(sock) for _ in range(2 * len(cases))]
+    expected = [getent(args, db, key + "-x") for db, key in cases] + \
+               [getent(args, db, key) for db, key in cases]
+    check(answers == expected, "pipelined requests are answered in order")
+
+    # A client that sends garbage, or leaves halfway, costs no one else
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(path)
+        sock.sendall(b"garbage!")
+        check(sock.recv(1) == b"", "a bad request closes the connection")
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(path)
+        sock.sendall(request("password", "gone-before-answer"))
+    check(ask(path, "password", "root") == getent(args, "password", "root"),
+          "getentd serves on after clients misbehave")
+
+
+def test_client(args, path):
+    env = dict(os.environ, GETENTD_SOCKET=path)
+    for db, key in lookups():
+        check(getent(args, "-c", db, key, env=env) == getent(args, db, key),
+              f"getent -c {db} {key} matches getent")
+    keys = [key for db, key in lookups() if db == "password"]
+    check(getent(args, "-c", "password", *keys, env=env) == getent(args, "password", *keys),
+          "getent -c with several keys matches getent")
+
+
+def test_eviction(args, path):
+    cases = lookups()
+    for _ in range(3):
+        for db, key in cases:
+            status, output = ask(path, db, key)
+            check((status, output) == getent(args, db, key),
+                  f"{db} {key} matches getent with two entries")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test getentd")
+    parser.add_argument("--getentd", required=True, help="getentd binary")
+    parser.add_argument("--getent", required=True, help="getent binary")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="getentd-test-") as tmp:
+        path = os.path.join(tmp, "getentd.socket")
+        daemon = start_daemon(args, path)
+        try:
+            test_protocol(args, path)
+            test_client(args, path)
+        finally:
+            stop_daemon(daemon, path)
+
+        path = os.path.join(tmp, "small.socket")
+        daemon = start_daemon(args, path, "--max-entries=2")
+        try:
+            test_eviction(args, path)
+        finally:
+            stop_daemon(daemon, path)
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
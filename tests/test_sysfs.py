@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Check the cache, NUMA and huge page variables of getconf against fake
+sysfs trees.
+
+    test_sysfs.py --getconf BIN
+
+The tree is laid out under a temporary --root: the caches of cpu0 in
+devices/system/cpu/cpu0/cache/index*, with sizes in K and M, split level 1
+instruction and data caches and a unified level 2 one, NUMA nodes in
+devices/system/node, huge page sizes in kernel/mm/hugepages and the
+transparent hugepage mode. An empty tree checks what getconf makes of a
+machine sysfs says nothing about.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+CACHE_DIR = "devices/system/cpu/cpu0/cache"
+KIB = 1024
+MIB = 1024 * KIB
+GIB = 1024 * MIB
+
+CACHES = [
+    {"level": "1", "type": "Data", "size": "48K", "ways_of_associativity": "12",
+     "coherency_line_size": "64"},
+    {"level": "1", "type": "Instruction", "size": "32K", "ways_of_associativity": "8",
+     "coherency_line_size": "64"},
+    {"level": "2", "type": "Unified", "size": "2M", "ways_of_associativity": "16",
+     "coherency_line_size": "128"},
+]
+
+TREE = {
+    "devices/system/node/node0/cpulist": "0-3",
+    "devices/system/node/node1/cpulist": "4-7",
+    "devices/system/node/possible": "0-1",
+    "kernel/mm/hugepages/hugepages-2048kB/nr_hugepages": "0",
+    "kernel/mm/hugepages/hugepages-1048576kB/nr_hugepages": "0",
+    "kernel/mm/transparent_hugepage/enabled": "always [madvise] never",
+}
+for i, cache in enumerate(CACHES):
+    for name, value in cache.items():
+        TREE[f"{CACHE_DIR}/index{i}/{name}"] = value
+
+EXPECTED = {
+    "LEVEL1_ICACHE_SIZE": 32 * KIB,
+    "LEVEL1_ICACHE_ASSOC": 8,
+    "LEVEL1_ICACHE_LINESIZE": 64,
+    "LEVEL1_DCACHE_SIZE": 48 * KIB,
+    "LEVEL1_DCACHE_ASSOC": 12,
+    "LEVEL1_DCACHE_LINESIZE": 64,
+    "LEVEL2_CACHE_SIZE": 2 * MIB,
+    "LEVEL2_CACHE_ASSOC": 16,
+    "LEVEL2_CACHE_LINESIZE": 128,
+    "LEVEL3_CACHE_SIZE": 0,
+    "LEVEL3_CACHE_ASSOC": 0,
+    "LEVEL4_CACHE_SIZE": 0,
+    "NUMA_NODES": 2,
+    "HUGEPAGE_SIZES": f"{2 * MIB} {1 * GIB}",
+    "TRANSPARENT_HUGEPAGE": "madvise",
+}
+
+EXPECTED_EMPTY = {
+    "LEVEL1_ICACHE_SIZE": 0,
+    "LEVEL1_DCACHE_SIZE": 0,
+    "LEVEL2_CACHE_SIZE": 0,
+    "NUMA_NODES": 1,
+    "HUGEPAGE_SIZES": None,
+    "TRANSPARENT_HUGEPAGE": None,
+}
+
+failures = []
+
+
+def check(cond, what):
+    print(("ok     " if cond else "FAILED ") + what)
+    if not cond:
+        failures.append(what)
+
+
+def getconf(args, tree, names):
+    """Export @names from getconf with @tree, a dict of path to content, as
+    its sysfs"""
+    with tempfile.TemporaryDirectory(prefix="sysfs-test-") as root:
+        os.mkdir(os.path.join(root, "sys"))
+        for path, content in tree.items():
+            path = os.path.join(root, "sys", path)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, "w", encoding="utf-8") as fp:
+                fp.write(content + "\n")
+        proc = subprocess.run([args.getconf, f"--root={root}", "--export=json", *names],
+                              capture_output=True, text=True, check=False)
+    if proc.returncode != 0:
+        return {}
+    return json.loads(proc.stdout)
+
+
+def check_values(values, expected, what):
+    for name, value in expected.items():
+        check(values.get(name) == value,
+              f"{what}: {name} is {values.get(name)!r}, {value!r} expected")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the sysfs variables of getconf")
+    parser.add_argument("--getconf", required=True, help="getconf binary")
+    args = parser.parse_args()
+
+    check_values(getconf(args, TREE, EXPECTED), EXPECTED, "sysfs tree")
+    check_values(getconf(args, {}, EXPECTED_EMPTY), EXPECTED_EMPTY, "empty sysfs")
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()